@@ -0,0 +1,184 @@
+#include <atomic>
+#include <new>
+#include "alloc_tracker.h"
+#include "perf_counters.h"
+
+namespace alloc
+{
+	static std::atomic<bool> s_enabled = false;
+	static std::atomic<int64_t> s_live_bytes = 0;
+	static std::atomic<int64_t> s_peak_bytes = 0;
+	static thread_local int64_t t_pending_bytes = 0;
+
+	void FlushThread()
+	{
+		int64_t pending = t_pending_bytes;
+		t_pending_bytes = 0;
+		int64_t live = s_live_bytes.fetch_add(pending, std::memory_order_relaxed) + pending;
+		int64_t peak = s_peak_bytes.load(std::memory_order_relaxed);
+		while (live > peak && !s_peak_bytes.compare_exchange_weak(peak, live, std::memory_order_relaxed))
+			;
+	}
+
+#ifdef ALLOC_TRACKING
+	static void OnAlloc(size_t bytes)
+	{
+		perf::CountAlloc(bytes);
+		t_pending_bytes += int64_t(bytes);
+		if (t_pending_bytes >= FLUSH_BYTES)
+			FlushThread();
+	}
+
+	static void OnFree(size_t bytes)
+	{
+		t_pending_bytes -= int64_t(bytes);
+		if (t_pending_bytes <= -FLUSH_BYTES)
+			FlushThread();
+	}
+
+	// Wraps the default allocator of cv::Mat, whose buffers come from cv::fastMalloc and not from operator new
+	class CountingMatAllocator : public cv::MatAllocator
+	{
+	public:
+		cv::UMatData* allocate(int dims, const int* sizes, int type, void* data, size_t* step, cv::AccessFlag flags, cv::UMatUsageFlags usage) const override
+		{
+			cv::UMatData* u = cv::Mat::getStdAllocator()->allocate(dims, sizes, type, data, step, flags, usage);
+			if (!u)
+				return nullptr;
+			// route unmap() / deallocate() of this buffer back through us
+			u->currAllocator = this;
+			if (!(u->flags & cv::UMatData::USER_ALLOCATED))
+				OnAlloc(u->size);
+			return u;
+		}
+
+		bool allocate(cv::UMatData* u, cv::AccessFlag flags, cv::UMatUsageFlags usage) const override
+		{
+			return cv::Mat::getStdAllocator()->allocate(u, flags, usage);
+		}
+
+		void deallocate(cv::UMatData* u) const override
+		{
+			if (!u)
+				return;
+			if (!(u->flags & cv::UMatData::USER_ALLOCATED))
+				OnFree(u->size);
+			cv::Mat::getStdAllocator()->deallocate(u);
+		}
+
+		void unmap(cv::UMatData* u) const override
+		{
+			if (u->urefcount == 0 && u->refcount == 0)
+				deallocate(u);
+		}
+	};
+
+	static void* Allocate(size_t size)
+	{
+		void* ptr = std::malloc(size ? size : 1);
+		if (ptr && s_enabled.load(std::memory_order_relaxed))
+			OnAlloc(::_msize(ptr));
+		return ptr;
+	}
+
+	static void Free(void* ptr)
+	{
+		if (!ptr)
+			return;
+		// blocks allocated before Enable() are subtracted too, live bytes are relative to Enable()
+		if (s_enabled.load(std::memory_order_relaxed))
+			OnFree(::_msize(ptr));
+		std::free(ptr);
+	}
+#endif
+
+	bool Enable()
+	{
+#ifdef ALLOC_TRACKING
+		// never destroyed, Mats freed during static destruction still go through it
+		static CountingMatAllocator* mat_allocator = new CountingMatAllocator();
+		cv::Mat::setDefaultAllocator(mat_allocator);
+		s_enabled = true;
+		return true;
+#else
+		return false;
+#endif
+	}
+
+	bool IsEnabled()
+	{
+		return s_enabled;
+	}
+
+	int64_t GetLiveBytes()
+	{
+		return s_live_bytes.load(std::memory_order_relaxed);
+	}
+
+	int64_t GetPeakBytes()
+	{
+		return s_peak_bytes.load(std::memory_order_relaxed);
+	}
+
+	void ResetPeak()
+	{
+		s_peak_bytes = s_live_bytes.load(std::memory_order_relaxed);
+	}
+}
+
+#ifdef ALLOC_TRACKING
+// The aligned overloads are left to the runtime, they allocate and free through their own functions.
+void* operator new(size_t size)
+{
+	if (void* ptr = alloc::Allocate(size))
+		return ptr;
+	throw std::bad_alloc();
+}
+
+void* operator new[](size_t size)
+{
+	if (void* ptr = alloc::Allocate(size))
+		return ptr;
+	throw std::bad_alloc();
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+	return alloc::Allocate(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+	return alloc::Allocate(size);
+}
+
+void operator delete(void* ptr) noexcept
+{
+	alloc::Free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept
+{
+	alloc::Free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept
+{
+	alloc::Free(ptr);
+}
+
+void operator delete[](void* ptr, size_t) noexcept
+{
+	alloc::Free(ptr);
+}
+
+void operator delete(void* ptr, const std::nothrow_t&) noexcept
+{
+	alloc::Free(ptr);
+}
+
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept
+{
+	alloc::Free(ptr);
+}
+#endif
@@ -0,0 +1,30 @@
+#pragma once
+#include "common.h"
+
+
+/**
+ * Opt-in allocation tracking. Once enabled, the global operator new and the cv::Mat allocator report every allocation
+ * to the perf counters of the calling thread (see perf::ScopedFrame), and the process wide live / peak heap bytes are
+ * followed. Leptonica and other C allocations through malloc aren't seen.
+ * The global operator new / delete are only replaced in builds with ALLOC_TRACKING defined (the Profile configuration),
+ * other builds keep the runtime's, Enable() fails and the counts stay 0. Until Enable() is called the replaced ones only
+ * cost a relaxed atomic load.
+ */
+namespace alloc
+{
+	// live bytes are accumulated per thread and published once they moved by this much, bounding the peak error to
+	// this times the number of threads while keeping the work threads off a shared cache line
+	constexpr int64_t FLUSH_BYTES = 64 * 1024;
+
+	// false if the build has no ALLOC_TRACKING
+	bool Enable();
+	bool IsEnabled();
+
+	// Heap bytes allocated and not yet freed since Enable(), and the highest value since the last ResetPeak()
+	int64_t GetLiveBytes();
+	int64_t GetPeakBytes();
+	void ResetPeak();
+
+	// publish the pending live bytes of the calling thread, call before reading the peak after the threads are joined
+	void FlushThread();
+}
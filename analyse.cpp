@@ -0,0 +1,213 @@
+#include "analyse.h"
+#include "location_detector.h"
+#include "tess_api.h"
+#include "context_tracker.h"
+#include "trace.h"
+#include "audit.h"
+#include "alloc_tracker.h"
+#include "corpus.h"
+#include "fingerprint.h"
+
+// Unbinds what AnalyseVideo() bound to the work thread on every way out, hw counters included
+struct ThreadTeardown
+{
+	ThreadTeardown() = default;
+	ThreadTeardown(const ThreadTeardown&) = delete;
+	ThreadTeardown& operator=(const ThreadTeardown&) = delete;
+	~ThreadTeardown()
+	{
+		alloc::FlushThread();
+		corpus::EndThread();
+		fingerprint::EndThread();
+		perf::BindThread(nullptr);
+		trace::EndThread();
+	}
+};
+
+void AnalyseVideo(const std::string &video_file, cv::Rect game_rect, double color_scale, double color_shift, std::vector<SingleFrameEvent> &outEvents, uint32_t &num_frame_parsed, VideoParserScheduler &scheduler, uint32_t thread_index, const AnalyseOptions &options, FrameDetectors::OrderReport &out_order_report, perf::Counters &out_perf_counters)
+{
+	::SetThreadGroupAffinity(::GetCurrentThread(), scheduler.GetThreadAffinity(thread_index), nullptr);
+	perf::BindThread(&out_perf_counters);
+	perf::HWCounterGroup hw_counters;
+	if (options.hw_counters && hw_counters.Open())
+		perf::BindHWCounters(&hw_counters);
+	trace::BeginThread(thread_index + 1, "worker " + std::to_string(thread_index));
+	corpus::BeginThread();
+	fingerprint::BeginThread();
+	// declared after hw_counters so they're unbound before they go away
+	ThreadTeardown teardown;
+
+	std::string lang = "eng";
+
+	TesseractAPI shared_tess_api;
+	if (!shared_tess_api.Init(lang.c_str()))
+		return;
+
+	LocationDetector location_detector(shared_tess_api.API());
+	if (!location_detector.Init(lang.c_str()))
+		return;
+
+	FrameDetectors detectors(shared_tess_api.API(), options.enabled_detectors);
+	ContextTracker context;
+	if (!detectors.Init(lang.c_str()))
+		return;
+
+	cv::VideoCapture cap(video_file);
+	if (cap.isOpened())
+	{
+		double width = cap.get(cv::CAP_PROP_FRAME_WIDTH);
+		double height = cap.get(cv::CAP_PROP_FRAME_HEIGHT);
+		//std::cout << "File: " << video_file << std::endl;
+		//std::cout << "Frame size: " << width << "x" << height << std::endl;
+		double num_frames = uint32_t(cap.get(cv::CAP_PROP_FRAME_COUNT));
+		//std::cout << "Number of frames: " << (int)num_frames << std::endl;
+
+		// Get the frame rate of the video
+		double fps = cap.get(cv::CAP_PROP_FPS);
+		if (fps != 30)
+		{
+			std::cout << video_file << ": fps != 30" << std::endl;
+			exit(-1);
+		}
+		//std::cout << "Frame rate: " << fps << std::endl;
+		double duration_sec = num_frames / fps;
+		//std::cout << "Duration: " << duration_sec << " seconds" << std::endl;
+
+		double format = cap.get(cv::CAP_PROP_FORMAT);
+		//std::cout << "Format: " << format << std::endl;
+
+		int work_item = -1;
+		uint32_t frame_start = 0, frame_end = 0;
+		std::vector<uint8_t> event_detectors;		// detector of each event of the work item, for the cache
+		std::vector<SingleFrameEvent> cached_events;		// of the current work item, by frame
+		std::vector<SingleFrameEvent> context_events;
+
+		while (true)
+		{
+			uint32_t last_frame_end = frame_end;
+			work_item = scheduler.GetNextWorkItem(thread_index, work_item, frame_start, frame_end);
+			if (work_item < 0)
+				break;
+
+			if (frame_start >= num_frames || frame_end >= num_frames || frame_start > frame_end)
+			{
+				std::cout << "segment [" << frame_start << ", " << frame_end << "] has range issues" << std::endl;
+				exit(-1);
+			}
+
+			trace::ScopedSpan trace_work_item("work_item", "item", uint32_t(work_item));
+			auto work_item_tbegin = std::chrono::steady_clock::now();
+			uint64_t seek_ns = 0;
+
+			if (frame_start != uint32_t(cap.get(cv::CAP_PROP_POS_FRAMES)))
+			{
+				trace::ScopedSpan trace_span("seek", "frame", frame_start);
+				cap.set(cv::CAP_PROP_POS_FRAMES, frame_start);
+				out_perf_counters.CountSeek();
+				seek_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - work_item_tbegin).count();
+			}
+
+			// the context carries over to the next work item only if it directly follows the last one
+			if (frame_start != last_frame_end + 1)
+				context.Reset();
+
+			// detectors with cached results for the whole item don't run, the others append theirs to the cache
+			uint32_t cached_mask = options.cache ? options.cache->GetCachedMask(frame_start, frame_end) : 0;
+			cached_events.clear();
+			if (cached_mask != 0 && (options.context_aware || options.journal))
+				options.cache->GetEvents(cached_mask, frame_start, frame_end, cached_events);
+			std::stable_sort(cached_events.begin(), cached_events.end(), [](const SingleFrameEvent& a, const SingleFrameEvent& b) { return a.frame_number < b.frame_number; });
+			size_t next_cached_event = 0;
+			event_detectors.clear();
+
+			size_t item_first_event = outEvents.size();
+			uint32_t cur_frame = frame_start;
+			for (; cur_frame <= frame_end; cur_frame++)
+			{
+				perf::ScopedFrame perf_frame(alloc::IsEnabled() && cur_frame - frame_start >= ALLOC_WARMUP_FRAMES);
+				cv::Mat frame;
+				{
+					perf::ScopedStage perf_stage(perf::Stage::Decode);
+					trace::ScopedSpan trace_span("decode", "frame", cur_frame);
+					if (!cap.read(frame))
+						break;
+				}
+
+				if (color_scale != 1 || color_shift != 0)
+				{
+					perf::ScopedStage perf_stage(perf::Stage::ColorCorrection);
+					cv::convertScaleAbs(frame, frame, color_scale, color_shift);
+				}
+
+				if (options.context_aware)
+				{
+					if (context.ShouldCheckLocation(cur_frame))
+					{
+						perf::ScopedDetector perf_scope(LOCATION_PERF_INDEX);
+						trace::ScopedSpan trace_span("location", "frame", cur_frame);
+						audit::ScopedDetector audit_scope("location", cur_frame);
+						std::string location = location_detector.GetLocation(frame, game_rect);
+						if (!location.empty())
+						{
+							perf_scope.SetDetected();
+							audit_scope.SetDetected();
+						}
+						context.OnLocation(cur_frame, location);
+					}
+
+					size_t num_events = outEvents.size();
+					detectors.ProcessFrame(frame, game_rect, cur_frame, context.GetSkipMask(cur_frame) | cached_mask, outEvents, options.cache ? &event_detectors : nullptr);
+					std::span<const SingleFrameEvent> frame_events = std::span<const SingleFrameEvent>(outEvents).subspan(num_events);
+					if (cached_mask != 0)
+					{
+						// the context follows the events of every detector, cached or not
+						context_events.assign(frame_events.begin(), frame_events.end());
+						for (; next_cached_event < cached_events.size() && cached_events[next_cached_event].frame_number <= cur_frame; next_cached_event++)
+							context_events.push_back(cached_events[next_cached_event]);
+						frame_events = context_events;
+					}
+					context.OnFrame(cur_frame, frame_events);
+				}
+				else
+					detectors.ProcessFrame(frame, game_rect, cur_frame, cached_mask, outEvents, options.cache ? &event_detectors : nullptr);
+
+				corpus::OnFrame(cur_frame, frame, game_rect);
+				fingerprint::OnFrame(cur_frame, frame, game_rect);
+				out_perf_counters.CountFrame();
+				num_frame_parsed++;
+			}
+
+			uint64_t work_item_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - work_item_tbegin).count();
+			out_perf_counters.AddWorkTime(work_item_ns);
+			scheduler.RecordItemCost(uint32_t(work_item), { .work_ns = work_item_ns - seek_ns, .seek_ns = seek_ns });
+			// only items that were decoded to the end
+			if (options.journal && cur_frame > frame_end)
+			{
+				std::span<const SingleFrameEvent> item_events = std::span<const SingleFrameEvent>(outEvents).subspan(item_first_event);
+				if (cached_mask != 0)
+				{
+					// a resumed item brings all its events, including the cached ones
+					context_events.assign(item_events.begin(), item_events.end());
+					context_events.insert(context_events.end(), cached_events.begin(), cached_events.end());
+					item_events = context_events;
+				}
+				options.journal->Append(frame_start, frame_end, item_events);
+			}
+			if (options.cache && cur_frame > frame_end)
+				options.cache->Append(frame_start, frame_end, ~cached_mask, std::span<const SingleFrameEvent>(outEvents).subspan(item_first_event), event_detectors);
+			if (options.stream)
+			{
+				// also an item cut short, the watermark can't wait for it
+				options.stream->OnItemDone(frame_start, frame_end, std::span<const SingleFrameEvent>(outEvents).subspan(item_first_event));
+				outEvents.resize(item_first_event);
+			}
+		}
+
+		out_order_report = detectors.GetOrderReport();
+	}
+	else
+	{
+		std::cout << "Cannot open video file " << video_file << std::endl;
+		exit(-1);
+	}
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "common.h"
+#include "detector_registry.h"
+#include "scheduler.h"
+#include "perf_counters.h"
+#include "journal.h"
+#include "result_cache.h"
+#include "event_stream.h"
+
+
+// perf counters cover FrameDetectors plus the location detector
+constexpr uint32_t LOCATION_PERF_INDEX = FrameDetectors::NUM_DETECTORS;
+// allocations of the first frames of a work item (seek, buffers growing to their steady size) aren't counted
+constexpr uint32_t ALLOC_WARMUP_FRAMES = 30;
+
+struct AnalyseOptions
+{
+	FrameDetectors::EnableFlags enabled_detectors;
+	bool context_aware;			// follow the location and load / memory state to skip the detectors that can't fire
+	bool hw_counters;			// attribute hardware counters to the perf stages
+	EventJournal* journal = nullptr;		// completed work items are appended to it if set
+	ResultCache* cache = nullptr;			// detectors with cached results are skipped, the others' results are added to it
+	EventStream* stream = nullptr;			// if set, the events of every work item go to it instead of the output vector
+};
+
+// Work thread: analyse the work items of the scheduler on video_file until none is left
+void AnalyseVideo(const std::string &video_file, cv::Rect game_rect, double color_scale, double color_shift, std::vector<SingleFrameEvent> &outEvents, uint32_t &num_frame_parsed, VideoParserScheduler &scheduler, uint32_t thread_index, const AnalyseOptions &options, FrameDetectors::OrderReport &out_order_report, perf::Counters &out_perf_counters);
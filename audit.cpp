@@ -0,0 +1,214 @@
+#include <atomic>
+#include <iomanip>
+#include <mutex>
+#include "audit.h"
+
+namespace audit
+{
+	struct Sample
+	{
+		std::string file;
+		uint32_t frame_number;
+		std::string text;
+		std::string gates;
+	};
+
+	struct CallSite
+	{
+		std::string function;
+		std::string location;			// file:line
+		std::string_view detector;
+		uint64_t ocr_calls = 0;
+		uint64_t no_match = 0;
+		uint32_t last_sample_frame = 0;
+		std::vector<Sample> samples;
+	};
+
+	struct PendingOCR
+	{
+		std::source_location call_site;
+		cv::Mat roi;
+		std::string text;
+		std::string gates;
+	};
+
+	static std::atomic<bool> s_enabled = false;
+	static std::filesystem::path s_dir;
+	static uint32_t s_video_index = 0;
+	static std::mutex s_mutex;			// OCR calls are rare and slow, one lock per detector call with OCR is negligible
+	static std::map<std::string, CallSite> s_call_sites;
+
+	static thread_local bool t_in_detector = false;
+	static thread_local std::string_view t_detector;
+	static thread_local uint32_t t_frame_number = 0;
+	static thread_local std::string t_gates;
+	static thread_local std::vector<PendingOCR> t_pending;
+
+	bool Enable(const std::filesystem::path& dir)
+	{
+		std::error_code ec;
+		std::filesystem::create_directories(dir / "audit", ec);
+		if (ec)
+		{
+			std::cout << "Cannot create " << (dir / "audit").string() << std::endl;
+			return false;
+		}
+		s_dir = dir / "audit";
+		s_enabled = true;
+		return true;
+	}
+
+	bool IsEnabled()
+	{
+		return s_enabled;
+	}
+
+	void BeginVideo(uint32_t video_index)
+	{
+		std::lock_guard<std::mutex> lock(s_mutex);
+		s_video_index = video_index;
+		s_call_sites.clear();
+	}
+
+	void OnGatePassed(std::string&& stats)
+	{
+		if (!t_in_detector)
+			return;
+		if (!t_gates.empty())
+			t_gates += "; ";
+		t_gates += stats;
+	}
+
+	void OnOCR(const std::source_location& call_site, const cv::Mat& roi, const std::string& text)
+	{
+		if (!t_in_detector)
+			return;
+		t_pending.push_back({ .call_site = call_site, .roi = roi.clone(), .text = text, .gates = std::move(t_gates) });
+		t_gates.clear();
+	}
+
+	static std::string CallSiteKey(const std::source_location& call_site)
+	{
+		return std::string(call_site.file_name()) + ":" + std::to_string(call_site.line());
+	}
+
+	// Count the call, returns true with the file name if the crop is to be kept as a sample. The sample is listed right
+	// away so other threads see the spacing, the crop is written by the caller outside the lock
+	static bool Resolve(const PendingOCR& ocr, bool matched, std::string& out_file)
+	{
+		std::string key = CallSiteKey(ocr.call_site);
+
+		std::lock_guard<std::mutex> lock(s_mutex);
+		auto [itor, inserted] = s_call_sites.try_emplace(key);
+		CallSite& site = itor->second;
+		if (inserted)
+		{
+			site.function = ocr.call_site.function_name();
+			site.location = std::filesystem::path(ocr.call_site.file_name()).filename().string() + ":" + std::to_string(ocr.call_site.line());
+			site.detector = t_detector;
+		}
+		site.ocr_calls++;
+		if (matched)
+			return false;
+		site.no_match++;
+
+		if (site.samples.size() >= MAX_SAMPLES_PER_SITE
+			|| (!site.samples.empty() && t_frame_number < site.last_sample_frame + MIN_SAMPLE_SPACING && t_frame_number + MIN_SAMPLE_SPACING > site.last_sample_frame))
+			return false;
+
+		out_file = std::to_string(s_video_index) + "_" + std::string(t_detector) + "_L" + std::to_string(ocr.call_site.line()) + "_" + std::to_string(t_frame_number) + ".png";
+		site.last_sample_frame = t_frame_number;
+		site.samples.push_back({ .file = out_file, .frame_number = t_frame_number, .text = ocr.text, .gates = ocr.gates });
+		return true;
+	}
+
+	// the PNG encoding is the slow part, it runs without holding s_mutex. A sample that can't be written is unlisted again
+	static void WriteSample(const PendingOCR& ocr, const std::string& file)
+	{
+		if (cv::imwrite((s_dir / file).string(), ocr.roi))
+			return;
+
+		std::lock_guard<std::mutex> lock(s_mutex);
+		auto itor = s_call_sites.find(CallSiteKey(ocr.call_site));
+		if (itor == s_call_sites.end())
+			return;
+		std::erase_if(itor->second.samples, [&file](const Sample& sample) { return sample.file == file; });
+	}
+
+	ScopedDetector::ScopedDetector(std::string_view detector, uint32_t frame_number)
+		: _active(s_enabled)
+	{
+		if (!_active)
+			return;
+		t_in_detector = true;
+		t_detector = detector;
+		t_frame_number = frame_number;
+		t_gates.clear();
+		t_pending.clear();
+	}
+
+	ScopedDetector::~ScopedDetector()
+	{
+		if (!_active)
+			return;
+		for (size_t i = 0; i < t_pending.size(); i++)
+		{
+			std::string file;
+			if (Resolve(t_pending[i], _detected && i + 1 == t_pending.size(), file))
+				WriteSample(t_pending[i], file);
+		}
+		t_pending.clear();
+		t_in_detector = false;
+	}
+
+	static void WriteYAMLString(std::ostream& os, std::string_view str)
+	{
+		os << '"';
+		for (char c : str)
+		{
+			if (c == '\n')
+				os << "\\n";
+			else if (c == '\r')
+				os << "\\r";
+			else
+			{
+				if (c == '"' || c == '\\')
+					os << '\\';
+				os << c;
+			}
+		}
+		os << '"';
+	}
+
+	std::string ToYAMLString()
+	{
+		std::lock_guard<std::mutex> lock(s_mutex);
+
+		std::ostringstream os;
+		os << std::fixed << std::setprecision(3);
+		os << "---" << std::endl;
+		os << "call_sites:" << std::endl;
+		for (const auto& [key, site] : s_call_sites)
+		{
+			os << "  - location: " << site.location << std::endl;
+			os << "    function: ";
+			WriteYAMLString(os, site.function);
+			os << std::endl;
+			os << "    detector: " << site.detector << std::endl;
+			os << "    ocr_calls: " << site.ocr_calls << std::endl;
+			os << "    no_match: " << site.no_match << std::endl;
+			os << "    no_match_rate: " << (site.ocr_calls ? double(site.no_match) / site.ocr_calls : 0.0) << std::endl;
+			os << "    samples:" << (site.samples.empty() ? " []" : "") << std::endl;
+			for (const Sample& sample : site.samples)
+			{
+				os << "      - { file: " << sample.file << ", frame: " << sample.frame_number << ", text: ";
+				WriteYAMLString(os, sample.text);
+				os << ", gates: ";
+				WriteYAMLString(os, sample.gates);
+				os << " }" << std::endl;
+			}
+		}
+
+		return os.str();
+	}
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include <filesystem>
+#include <source_location>
+#include <string>
+#include "common.h"
+
+
+/**
+ * Opt-in audit of the OCR calls that didn't lead to a detection. Every OCR call is attributed to its call site in the
+ * detectors; when the detector call ends without a detection, the OCR calls it made are counted as "no match" (when it
+ * ends with a detection, only its last OCR call is the match, the earlier ones still count as no match).
+ * A rate-limited sample of the no-match ROI crops is written as png, together with the statistics of the gates that let
+ * them through, so the gate thresholds can be tightened with real data.
+ * Everything is a no-op until Enable() is called.
+ */
+namespace audit
+{
+	constexpr uint32_t MAX_SAMPLES_PER_SITE = 100;
+	constexpr uint32_t MIN_SAMPLE_SPACING = 30;		// frames between two samples of the same call site
+
+	// crops go to <dir>/audit/
+	bool Enable(const std::filesystem::path& dir);
+	bool IsEnabled();
+
+	// Reset the counters, the crops of the video are prefixed with its index
+	void BeginVideo(uint32_t video_index);
+	std::string ToYAMLString();
+
+	// Statistics of a gate that passed, attached to the next OCR call of the detector
+	void OnGatePassed(std::string&& stats);
+	void OnOCR(const std::source_location& call_site, const cv::Mat& roi, const std::string& text);
+
+	// One call of a detector on a frame
+	class ScopedDetector
+	{
+	private:
+		bool _active;
+		bool _detected = false;
+
+	public:
+		ScopedDetector(std::string_view detector, uint32_t frame_number);
+		~ScopedDetector();
+		ScopedDetector(const ScopedDetector&) = delete;
+		ScopedDetector& operator=(const ScopedDetector&) = delete;
+
+		void SetDetected() { _detected = true; }
+	};
+}
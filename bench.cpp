@@ -0,0 +1,456 @@
+#include <iomanip>
+#include <random>
+#include "bench.h"
+#include "detector_registry.h"
+#include "tess_api.h"
+
+namespace bench
+{
+	using RoiFunc = cv::Rect(*)(uint32_t width, uint32_t height, const cv::Rect& game_rect);
+
+	// ROI i of a detector, see DetectorTraits
+	template<class T, size_t i = 0>
+	constexpr RoiFunc detector_roi = &Detector::BBoxConversion<DetectorTraits<T>::rois[i]>;
+
+	// Parameters of the Detector::OCR() call sites, the thresholds and whitelists have to follow the detectors by hand
+	struct OCRCallSite
+	{
+		const char* name;
+		RoiFunc roi;
+		uint8_t greyscale_lower;
+		uint8_t greyscale_upper;
+		bool scale_with_width;			// location: scaled down to a 480 wide game screen
+		const char* char_whitelist;
+		const char* text;				// rendered into the ROI
+	};
+
+	static const OCRCallSite ocr_call_sites[] = {
+		{ "tower_activation", detector_roi<TowerActivationDetector>, 180, 255, false, "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz. ", "Sheikah Tower activated." },
+		{ "single_line_dialog", detector_roi<SingleLineDialogDetector>, 180, 255, false, "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz. ", "Travel Gate registered to map." },
+		{ "two_line_dialog", detector_roi<ThreeLineDialogDetector, 1>, 180, 255, false, "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz,.'-!\" ", "Thank you so much for your help!" },
+		{ "three_line_dialog", detector_roi<ThreeLineDialogDetector>, 180, 255, false, "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz,.'-!\" ", "I guess I owe you too" },
+		{ "zora_monument", detector_roi<ZoraMonumentDetector>, 180, 255, false, "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz,.-! ", "Time has taken its toll on this" },
+		{ "travel", detector_roi<TravelDetector>, 140, 255, false, "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz. ", "Travel" },
+		{ "album", detector_roi<AlbumPageDetector>, 85, 170, false, "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz. ", "Album" },
+		{ "item", detector_roi<ItemDetector>, 204, 255, false, "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz'- ", "Korok Seed" },
+		{ "location", detector_roi<LocationDetector>, 180, 255, true, "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz'- ", "Great Plateau Tower" },
+	};
+
+	struct KernelCase
+	{
+		const char* name;
+		RoiFunc roi;
+	};
+
+	// the gates GreyscaleTest() runs before an OCR call site, and the plus icon of the item popup
+	static const KernelCase greyscale_histogram_cases[] = {
+		{ "item_plus_icon", detector_roi<ItemDetector, 1> },
+		{ "travel_left_side", detector_roi<TravelDetector, 1> },
+		{ "travel_right_side", detector_roi<TravelDetector, 2> },
+		{ "single_line_dialog_above", detector_roi<SingleLineDialogDetector, 1> },
+		{ "single_line_dialog_below", detector_roi<SingleLineDialogDetector, 2> },
+		{ "three_line_dialog_above", detector_roi<ThreeLineDialogDetector, 2> },
+		{ "three_line_dialog_below", detector_roi<ThreeLineDialogDetector, 3> },
+		{ "two_line_dialog_above", detector_roi<ThreeLineDialogDetector, 4> },
+		{ "two_line_dialog_below", detector_roi<ThreeLineDialogDetector, 5> },
+		{ "album_left_side", detector_roi<AlbumPageDetector, 3> },
+		{ "album_right_side", detector_roi<AlbumPageDetector, 4> },
+		{ "zora_monument_above", detector_roi<ZoraMonumentDetector, 1> },
+		{ "zora_monument_middle", detector_roi<ZoraMonumentDetector, 2> },
+	};
+
+	static const KernelCase bgr_histogram_cases[] = {
+		{ "album_l_button", detector_roi<AlbumPageDetector, 1> },
+		{ "album_r_button", detector_roi<AlbumPageDetector, 2> },
+		{ "album_title", detector_roi<AlbumPageDetector> },
+	};
+
+	static const KernelCase uniformity_cases[] = {
+		{ "black_white_load_top", detector_roi<BlackWhiteLoadScreenDetector> },
+		{ "black_white_load_bottom", detector_roi<BlackWhiteLoadScreenDetector, 1> },
+	};
+
+	static const KernelCase clamp_cases[] = {
+		{ "two_line_dialog", detector_roi<ThreeLineDialogDetector, 1> },
+	};
+
+	static std::string SizeString(const cv::Rect& rect)
+	{
+		return std::to_string(rect.width) + "x" + std::to_string(rect.height);
+	}
+
+	// Dark noisy background with the text of every OCR call site rendered in its ROI
+	static cv::Mat MakeFrame(cv::Size size)
+	{
+		cv::Mat frame(size, CV_8UC3);
+		cv::randu(frame, cv::Scalar(0, 0, 0), cv::Scalar(60, 60, 60));
+
+		cv::Rect game_rect(0, 0, size.width, size.height);
+		for (const OCRCallSite& site : ocr_call_sites)
+		{
+			cv::Rect rect = site.roi(size.width, size.height, game_rect);
+			int baseline = 0;
+			cv::Size text_size = cv::getTextSize(site.text, cv::FONT_HERSHEY_DUPLEX, 1.0, 1, &baseline);
+			double scale = std::min(rect.height * 0.6 / text_size.height, rect.width * 0.95 / text_size.width);
+			text_size = cv::getTextSize(site.text, cv::FONT_HERSHEY_DUPLEX, scale, 1, &baseline);
+			cv::Point origin(rect.x + (rect.width - text_size.width) / 2, rect.y + (rect.height + text_size.height) / 2);
+			double grey = site.greyscale_upper - (site.greyscale_upper - site.greyscale_lower) / 8.0;
+			cv::putText(frame, site.text, origin, cv::FONT_HERSHEY_DUPLEX, scale, cv::Scalar(grey, grey, grey), 1, cv::LINE_AA);
+		}
+		return frame;
+	}
+
+	static bool LoadLocationNames(std::vector<std::string>& out_names)
+	{
+		std::string filename = "eng_locations.txt";
+		std::ifstream ifs(filename);
+		if (!ifs.is_open())
+		{
+			std::cout << "Cannot open file " << filename << std::endl;
+			return false;
+		}
+		std::string line;
+		while (std::getline(ifs, line))
+			out_names.push_back(line);
+		return !out_names.empty();
+	}
+
+	// up to str.size() / max_edits_divisor wrong, dropped or extra chars
+	static std::string Perturb(std::string str, uint32_t max_edits_divisor, std::mt19937& rng)
+	{
+		uint32_t num_edits = std::uniform_int_distribution<uint32_t>(0, uint32_t(str.size() / max_edits_divisor))(rng);
+		for (uint32_t j = 0; j < num_edits && !str.empty(); j++)
+		{
+			size_t pos = std::uniform_int_distribution<size_t>(0, str.size() - 1)(rng);
+			switch (rng() % 3)
+			{
+			case 0: str[pos] = char('a' + rng() % 26); break;
+			case 1: str.erase(pos, 1); break;
+			default: str.insert(pos, 1, char('a' + rng() % 26)); break;
+			}
+		}
+		return str;
+	}
+
+	// What tesseract typically returns for a location: a few wrong, dropped or extra chars, sometimes nothing usable
+	static std::vector<std::string> MakeLocationQueries(const std::vector<std::string>& names)
+	{
+		std::mt19937 rng(1234);
+		std::vector<std::string> queries;
+		for (uint32_t i = 0; i < uint32_t(names.size()); i += 7)
+			queries.push_back(Perturb(names[i], 8, rng));
+		queries.push_back("Ilhrwqx Vgtabn");
+		queries.push_back("Sheikah Tower activated.");
+		return queries;
+	}
+
+	void WriteJSONString(std::ostream& os, std::string_view str)
+	{
+		os << '"';
+		for (char c : str)
+		{
+			if (c == '"' || c == '\\')
+				os << '\\';
+			os << c;
+		}
+		os << '"';
+	}
+
+	bool WriteJSON(const std::string& filename, std::string_view benchmark, const std::vector<Result>& results)
+	{
+		std::ofstream ofs(filename);
+		if (!ofs.is_open())
+		{
+			std::cout << "Cannot write benchmark file " << filename << std::endl;
+			return false;
+		}
+
+		ofs << "{\"benchmark\":";
+		WriteJSONString(ofs, benchmark);
+		ofs << ",\"results\":[" << std::endl;
+		for (size_t i = 0; i < results.size(); i++)
+		{
+			const Result& r = results[i];
+			ofs << "{\"name\":";
+			WriteJSONString(ofs, r.name);
+			ofs << ",\"variant\":";
+			WriteJSONString(ofs, r.variant);
+			ofs << ",\"resolution\":";
+			WriteJSONString(ofs, r.resolution);
+			ofs << ",\"input\":";
+			WriteJSONString(ofs, r.input);
+			ofs << ",\"iterations\":" << r.iterations
+				<< ",\"mean_ns\":" << r.mean_ns
+				<< ",\"min_ns\":" << r.min_ns
+				<< ",\"p50_ns\":" << r.p50_ns
+				<< ",\"p99_ns\":" << r.p99_ns << '}' << (i + 1 < results.size() ? "," : "") << std::endl;
+		}
+		ofs << "]}" << std::endl;
+
+		return ofs.good();
+	}
+
+	static void Print(const Result& r)
+	{
+		std::cout << std::left << std::setw(28) << r.name << std::setw(24) << r.variant << std::setw(7) << r.resolution << std::setw(10) << r.input
+			<< std::right << std::fixed << std::setprecision(3) << std::setw(12) << r.mean_ns / 1e3 << " us" << std::endl;
+	}
+
+	bool RunKernels(const std::string& json_path)
+	{
+		if (!TesseractAPI::MapTrainedData("eng"))
+			return false;
+		TesseractAPI tess_api;
+		if (!tess_api.Init("eng"))
+			return false;
+		LocationDetector location_detector(tess_api.API());
+		if (!location_detector.Init("eng"))
+			return false;
+		std::vector<std::string> location_names;
+		if (!LoadLocationNames(location_names))
+			return false;
+
+		std::vector<Result> results;
+		auto add = [&results](Result&& result) {
+			Print(result);
+			results.push_back(std::move(result));
+		};
+
+		// keeps the results alive so the calls can't be optimized out
+		uint64_t sink = 0;
+
+		for (const Resolution& res : resolutions)
+		{
+			cv::Mat frame = MakeFrame(res.size);
+			cv::Rect game_rect(0, 0, res.size.width, res.size.height);
+
+			// GreyscaleTest() runs GreyscaleAccHistogram() on the ROI of every OCR call site before deciding to OCR it
+			for (const OCRCallSite& site : ocr_call_sites)
+			{
+				cv::Mat roi = frame(site.roi(res.size.width, res.size.height, game_rect));
+				add(Measure("GreyscaleAccHistogram", site.name, res.name, SizeString(cv::Rect(0, 0, roi.cols, roi.rows)), [&]() {
+					std::array<uint32_t, 256> pix_count;
+					Detector::GreyscaleAccHistogram(roi, pix_count);
+					sink += pix_count[128];
+				}));
+			}
+
+			for (const KernelCase& kernel_case : greyscale_histogram_cases)
+			{
+				cv::Rect rect = kernel_case.roi(res.size.width, res.size.height, game_rect);
+				add(Measure("GreyscaleAccHistogram", kernel_case.name, res.name, SizeString(rect), [&]() {
+					std::array<uint32_t, 256> pix_count;
+					Detector::GreyscaleAccHistogram(frame(rect), pix_count);
+					sink += pix_count[128];
+				}));
+			}
+
+			for (const KernelCase& kernel_case : bgr_histogram_cases)
+			{
+				cv::Rect rect = kernel_case.roi(res.size.width, res.size.height, game_rect);
+				add(Measure("BGRAccHistogram", kernel_case.name, res.name, SizeString(rect), [&]() {
+					std::array<std::array<uint32_t, 256>, 3> pix_count;
+					Detector::BGRAccHistogram(frame(rect), pix_count);
+					sink += pix_count[0][128];
+				}));
+			}
+
+			for (const KernelCase& kernel_case : clamp_cases)
+			{
+				cv::Rect rect = kernel_case.roi(res.size.width, res.size.height, game_rect);
+				add(Measure("GreyscaleHorizontalClamp", kernel_case.name, res.name, SizeString(rect), [&]() {
+					sink += Detector::GreyscaleHorizontalClamp(frame(rect), 180, 255).start;
+				}));
+			}
+
+			// the noisy frame is neither black nor white, so this is the early out every regular game frame takes
+			for (const KernelCase& kernel_case : uniformity_cases)
+			{
+				cv::Rect rect = kernel_case.roi(res.size.width, res.size.height, game_rect);
+				add(Measure("GreyscaleUniformityTest", kernel_case.name, res.name, SizeString(rect), [&]() {
+					bool all_black, all_white;
+					Detector::GreyscaleUniformityTest(frame(rect), 9, 247, 0.005, all_black, all_white);
+					sink += all_black + all_white;
+				}));
+			}
+
+			for (const OCRCallSite& site : ocr_call_sites)
+			{
+				cv::Rect rect = site.roi(res.size.width, res.size.height, game_rect);
+				double scale_factor = site.scale_with_width ? std::max(res.size.width / 480.0, 1.0) : 1.0;
+				add(Measure("Detector::OCR", site.name, res.name, SizeString(rect), [&]() {
+					sink += Detector::OCR(frame(rect), scale_factor, site.greyscale_lower, site.greyscale_upper, true, tess_api.API(), site.char_whitelist).size();
+				}));
+			}
+		}
+
+		// string matching doesn't depend on the resolution
+		std::vector<std::string> queries = MakeLocationQueries(location_names);
+		std::string num_queries = std::to_string(queries.size()) + " queries";
+		add(Measure("util::GetStringEditDistance", "location_names", "", num_queries, [&]() {
+			for (const std::string& query : queries)
+			{
+				for (uint32_t i = 0; i < uint32_t(location_names.size()); i += 16)
+					sink += util::GetStringEditDistance(query, location_names[i], uint32_t(query.size() / 5));
+			}
+		}));
+		add(Measure("util::GetStringEditDistanceDP", "location_names", "", num_queries, [&]() {
+			for (const std::string& query : queries)
+			{
+				for (uint32_t i = 0; i < uint32_t(location_names.size()); i += 16)
+					sink += util::GetStringEditDistanceDP(query, location_names[i], uint32_t(query.size() / 5));
+			}
+		}));
+		add(Measure("FindBestLocationMatch", "noisy_location_names", "", num_queries, [&]() {
+			for (const std::string& query : queries)
+				sink += location_detector.FindBestLocationMatch(query).size();
+		}));
+
+		std::cout << "(checksum " << sink << ")" << std::endl;
+		if (!WriteJSON(json_path, "kernels", results))
+			return false;
+		std::cout << "Results written to " << json_path << std::endl;
+		return true;
+	}
+
+	// Checks one matcher against its reference on every query, prints the first few differences
+	template<class Matcher, class Reference>
+	static bool CheckEquivalence(std::string_view name, const std::vector<std::string>& queries, Matcher&& matcher, Reference&& reference)
+	{
+		uint32_t num_mismatches = 0;
+		for (const std::string& query : queries)
+		{
+			std::string result = matcher(query);
+			std::string expected = reference(query);
+			if (result == expected)
+				continue;
+			if (++num_mismatches <= 10)
+				std::cout << "!!! " << name << " '" << query << "': '" << result << "', expected '" << expected << "'" << std::endl;
+		}
+		std::cout << name << ": " << queries.size() << " queries, " << num_mismatches << " mismatches" << std::endl;
+		return num_mismatches == 0;
+	}
+
+	bool CheckMatchers()
+	{
+		// the matchers don't OCR, the API is never initialized
+		tesseract::TessBaseAPI tess_api;
+		LocationDetector location_detector(tess_api);
+		if (!location_detector.Init("eng"))
+			return false;
+		std::vector<std::string> location_names;
+		if (!LoadLocationNames(location_names))
+			return false;
+
+		// every name a few times with up to twice the allowed edits, so near misses and ties get covered too
+		std::mt19937 rng(5678);
+		std::vector<std::string> location_queries;
+		for (const std::string& name : location_names)
+		{
+			location_queries.push_back(name);
+			for (uint32_t i = 0; i < 8; i++)
+				location_queries.push_back(Perturb(name, 3, rng));
+		}
+		for (uint32_t i = 0; i < 1000; i++)
+			location_queries.push_back(Perturb(location_names[rng() % location_names.size()] + location_names[rng() % location_names.size()], 2, rng));
+
+		// The batched edit distance: one EditDistancePattern per query scores the whole location table, like the BK-tree
+		// walk and the table scans do, against the DP table. The doubled queries are past the 64 chars of the bit vectors
+		uint64_t num_distances = 0;
+		uint32_t num_distance_mismatches = 0;
+		for (size_t q = 0; q < location_queries.size(); q += 9)
+		{
+			std::string query = q % 2 ? location_queries[q] : location_queries[q] + location_queries[q];
+			util::EditDistancePattern pattern(query);
+			for (const std::string& name : location_names)
+			{
+				std::string_view name_prefix = std::string_view(name).substr(0, std::min(name.size(), query.size()));
+				for (uint32_t max_allowed_edits : { 1u, 4u, 100u })
+				{
+					uint32_t distance = pattern.Distance(name, max_allowed_edits);
+					uint32_t prefix_distance = pattern.PrefixDistance(name_prefix, max_allowed_edits);
+					uint32_t pair_distance = util::GetStringEditDistance(query, name, max_allowed_edits);
+					uint32_t expected = util::GetStringEditDistanceDP(query, name, max_allowed_edits);
+					uint32_t expected_prefix = util::GetStringEditDistanceDP(std::string_view(query).substr(0, name_prefix.size()), name_prefix, max_allowed_edits);
+					num_distances += 3;
+					if (distance == expected && pair_distance == expected && prefix_distance == expected_prefix)
+						continue;
+					if (++num_distance_mismatches <= 10)
+						std::cout << "!!! edit distance '" << query << "' '" << name << "' (max " << max_allowed_edits << "): " << distance << ", pair " << pair_distance
+							<< ", prefix " << prefix_distance << ", expected " << expected << ", prefix " << expected_prefix << std::endl;
+				}
+			}
+		}
+		std::cout << "EditDistancePattern: " << num_distances << " distances, " << num_distance_mismatches << " mismatches" << std::endl;
+		bool passed = num_distance_mismatches == 0;
+
+		passed &= CheckEquivalence("FindBestLocationMatch", location_queries,
+			[&](const std::string& query) { return location_detector.FindBestLocationMatch(query); },
+			[&](const std::string& query) { return location_detector.FindBestLocationMatchLinear(query); });
+
+		SingleLineDialogDetector single_line_detector(tess_api);
+		ThreeLineDialogDetector three_line_detector(tess_api);
+		ZoraMonumentDetector zora_monument_detector(tess_api);
+		if (!single_line_detector.Init("eng") || !three_line_detector.Init("eng") || !zora_monument_detector.Init("eng"))
+			return false;
+		const std::pair<std::string_view, const PrefixMatcher*> prefix_matchers[] = {
+			{ "single_line_dialog", &single_line_detector.GetMatcher() },
+			{ "two_line_dialog", &three_line_detector.Get2LineMatcher() },
+			{ "three_line_dialog", &three_line_detector.Get3LineMatcher() },
+			{ "zora_monument", &zora_monument_detector.GetLine1Matcher() },
+		};
+
+		// what the OCR of a first line looks like: the prefix of any table, perturbed, cut short or followed by more
+		// text, with the ambiguous chars unified like the detectors do. Two prefixes of a table spliced together are
+		// close to both, which covers the order in which several matching entries are picked
+		std::vector<std::string> prefix_queries;
+		for (const auto& [name, matcher] : prefix_matchers)
+		{
+			const std::vector<std::string>& prefixes = matcher->GetPrefixes();
+			for (const std::string& prefix : prefixes)
+			{
+				prefix_queries.push_back(prefix);
+				prefix_queries.push_back(prefix.substr(0, prefix.size() - std::min<size_t>(prefix.size(), 1 + rng() % 3)));
+				for (uint32_t i = 0; i < 8; i++)
+				{
+					const std::string& other = location_names[rng() % location_names.size()];
+					prefix_queries.push_back(Perturb(prefix + " " + other.substr(0, rng() % (other.size() + 1)), 4, rng));
+				}
+				for (uint32_t i = 0; i < 32; i++)
+				{
+					const std::string& other = prefixes[rng() % prefixes.size()];
+					size_t split = rng() % (std::min(prefix.size(), other.size()) + 1);
+					prefix_queries.push_back(Perturb(prefix.substr(0, split) + other.substr(split), 6, rng));
+				}
+			}
+		}
+		for (std::string& query : prefix_queries)
+			util::UnifyAmbiguousChars(query);
+		auto to_string = [](uint32_t value) { return value == PrefixMatcher::NO_MATCH ? std::string() : std::to_string(value); };
+		for (const auto& [name, matcher] : prefix_matchers)
+		{
+			passed &= CheckEquivalence(std::string(name) + " PrefixMatcher", prefix_queries,
+				[&](const std::string& query) { return to_string(matcher->Match(query)); },
+				[&](const std::string& query) { return to_string(matcher->MatchLinear(query)); });
+		}
+
+		// the real tables rarely have two entries matching one text, on 3 letters most texts match several
+		auto random_string = [&rng](uint32_t max_length) {
+			std::string str(rng() % (max_length + 1), ' ');
+			for (char& c : str)
+				c = char('a' + rng() % 3);
+			return str;
+		};
+		PrefixMatcher random_matcher;
+		random_matcher.Init(2);
+		for (uint32_t i = 0; i < 200; i++)
+			random_matcher.Insert(random_string(12), i);
+		std::vector<std::string> random_queries;
+		for (uint32_t i = 0; i < 5000; i++)
+			random_queries.push_back(random_string(16));
+		passed &= CheckEquivalence("random PrefixMatcher", random_queries,
+			[&](const std::string& query) { return to_string(random_matcher.Match(query)); },
+			[&](const std::string& query) { return to_string(random_matcher.MatchLinear(query)); });
+		return passed;
+	}
+}
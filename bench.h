@@ -0,0 +1,138 @@
+#pragma once
+#include <chrono>
+#include <filesystem>
+#include <string>
+#include <vector>
+#include "common.h"
+#include "perf_counters.h"
+
+
+/**
+ * Benchmark modes of the executable, selected on the command line instead of a run.yaml.
+ * Results are written as JSON so two builds can be diffed.
+ */
+namespace bench
+{
+	// every case runs until both are reached
+	constexpr uint32_t MIN_ITERATIONS = 20;
+	constexpr uint64_t MIN_TIME_NS = 200'000'000;
+
+	struct Resolution
+	{
+		const char* name;
+		cv::Size size;
+	};
+
+	inline const Resolution resolutions[] = {
+		{ "720p", cv::Size(1280, 720) },
+		{ "1080p", cv::Size(1920, 1080) },
+	};
+
+	struct Result
+	{
+		std::string name;			// function under test
+		std::string variant;		// call site / input set
+		std::string resolution;
+		std::string input;			// e.g. ROI size
+		uint64_t iterations;
+		uint64_t mean_ns;
+		uint64_t min_ns;
+		uint64_t p50_ns;
+		uint64_t p99_ns;
+	};
+
+	template<typename Func>
+	Result Measure(std::string name, std::string variant, std::string resolution, std::string input, Func&& func)
+	{
+		perf::Histogram histogram;
+		uint64_t min_ns = ~uint64_t(0);
+		while (histogram.Count() < MIN_ITERATIONS || histogram.TotalNs() < MIN_TIME_NS)
+		{
+			auto t0 = std::chrono::steady_clock::now();
+			func();
+			uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - t0).count();
+			histogram.Add(ns);
+			min_ns = std::min(min_ns, ns);
+		}
+		return {
+			.name = std::move(name),
+			.variant = std::move(variant),
+			.resolution = std::move(resolution),
+			.input = std::move(input),
+			.iterations = histogram.Count(),
+			.mean_ns = histogram.TotalNs() / histogram.Count(),
+			.min_ns = min_ns,
+			.p50_ns = histogram.PercentileNs(0.5),
+			.p99_ns = histogram.PercentileNs(0.99),
+		};
+	}
+
+	void WriteJSONString(std::ostream& os, std::string_view str);
+	bool WriteJSON(const std::string& filename, std::string_view benchmark, const std::vector<Result>& results);
+
+	// Detector pixel kernels, OCR of every call site, edit distance and location matching on synthetic 720p / 1080p frames.
+	// Needs eng.traineddata and eng_locations.txt in the working directory
+	bool RunKernels(const std::string& json_path);
+
+	// The fast matchers against the plain versions they replaced on perturbed inputs, fails on any different result:
+	// EditDistancePattern scoring whole tables against the DP table, the BK-tree location lookup against scoring every location,
+	// and the dialog and monument prefix tries against checking every entry of their tables in order.
+	// Needs eng_locations.txt in the working directory
+	bool CheckMatchers();
+
+	/**
+	 * Synthetic 30 fps video: moving "gameplay" background with a scripted block of events repeated num_blocks times,
+	 * rendered so they pass the detector gates: item popup, travel button, black / loading / white screens, tower
+	 * activation, a one line and a three line dialog. Written as MJPG avi, only if the file doesn't exist yet.
+	 * out_expected gets the events EventDeduper::Dedup() should produce, frame exact.
+	 */
+	bool MakeSyntheticVideo(const std::filesystem::path& path, cv::Size size, uint32_t num_blocks, std::vector<MultiFrameEvent>& out_expected, uint32_t& out_num_frames);
+
+	struct PipelineThreadStats
+	{
+		uint64_t frames;
+		uint64_t seeks;
+		double work_seconds;			// inside work items
+	};
+
+	struct PipelineResult
+	{
+		uint32_t num_frames = 0;
+		uint32_t num_threads = 0;
+		double analyse_seconds = 0;		// from the first thread start to the last join
+		double seconds = 0;				// from the first thread start to the end of Assemble()
+		std::vector<PipelineThreadStats> threads;
+		double allocs_per_frame = 0;	// steady state, 0 unless the alloc tracker is enabled
+		std::vector<MultiFrameEvent> deduped_events;
+		std::vector<std::shared_ptr<AssembledEvent>> assembled_events;
+	};
+
+	// AnalyseVideo() on num_threads work threads -> EventDeduper::Dedup() -> EventAssembler::Assemble() over
+	// [start_frame, end_frame]. num_threads 0 for the default of the scheduler
+	bool RunPipeline(const std::string& video_file, const cv::Rect& game_rect, uint32_t start_frame, uint32_t end_frame, uint32_t num_threads, PipelineResult& out_result);
+
+	// Synthetic 720p and 1080p videos through RunPipeline(), reports fps and checks the deduped events frame by frame.
+	// The videos are generated in the directory of json_path. num_threads 0 for the default
+	bool RunEndToEnd(const std::string& json_path, uint32_t num_threads);
+
+	// The synthetic 720p video of RunEndToEnd() through RunPipeline() with the alloc tracker, fails if its steady state
+	// frames allocate more than budget times per frame on average. Needs the Profile build (ALLOC_TRACKING)
+	bool CheckAllocBudget(double budget, const std::string& dir);
+
+	// [start_frame, start_frame + num_frames) of video_file with 1, 2, 4 ... N work threads through RunPipeline(), reports
+	// fps, parallel efficiency, seeks and idle time per thread. The game is assumed to fill the whole frame
+	bool RunScaling(const std::string& video_file, uint32_t start_frame, uint32_t num_frames, const std::string& json_path);
+
+	// Every detector and the location detector on the records of a corpus file (see corpus.h) instead of decoded frames,
+	// reports fps and the calls, OCR calls, detections and time of each detector
+	bool RunReplay(const std::string& corpus_file, const std::string& json_path);
+
+	// Synthetic raw event streams of 1, 10 and 50 hour runs (or only the given number of hours) through patching,
+	// EventDeduper, EventAssembler and the YAML output, reports the time and peak heap of each stage and checks the
+	// assembled events
+	bool RunPostProcess(const std::string& json_path, uint32_t hours);
+
+	// Replay the work item costs of a schedule trace (schedule_trace in run.yaml) on 1, 2, 4 ... max_workers virtual
+	// workers with every scheduling policy, reports makespan and seeks. max_workers 0 for the workers of the trace
+	bool RunScheduleSimulation(const std::string& trace_file, uint32_t max_workers, const std::string& json_path);
+}
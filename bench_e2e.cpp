@@ -0,0 +1,399 @@
+#include <iomanip>
+#include <numeric>
+#include <random>
+#include <thread>
+#include "bench.h"
+#include "alloc_tracker.h"
+#include "analyse.h"
+#include "deduper.h"
+#include "tess_api.h"
+#include "source_hashes.h"
+
+namespace bench
+{
+	enum class Screen : uint8_t
+	{
+		Gameplay,
+		Black,
+		White,
+		Loading,
+		Item,
+		Travel,
+		Tower,
+		GateRegistered,
+		Dialog,
+		Max,
+	};
+
+	struct ScriptedEvent
+	{
+		Screen screen;
+		uint32_t num_frames;
+		SingleFrameEventData data;		// None for gameplay
+	};
+
+	// One block, about 50 seconds. The gameplay stretches are longer than the largest dedup spacing (90 frames)
+	static const ScriptedEvent script[] = {
+		{ Screen::Gameplay, 150, { .type = EventType::None } },
+		{ Screen::Item, 60, { .type = EventType::Korok } },
+		{ Screen::Gameplay, 150, { .type = EventType::None } },
+		{ Screen::Travel, 45, { .type = EventType::TravelButton } },
+		{ Screen::Black, 15, { .type = EventType::BlackScreen } },
+		{ Screen::Loading, 90, { .type = EventType::LoadingScreen } },
+		{ Screen::Black, 15, { .type = EventType::BlackScreen } },
+		{ Screen::Gameplay, 150, { .type = EventType::None } },
+		{ Screen::Tower, 90, { .type = EventType::TowerActivation } },
+		{ Screen::Gameplay, 150, { .type = EventType::None } },
+		{ Screen::GateRegistered, 60, { .type = EventType::GateRegistered } },
+		{ Screen::Gameplay, 150, { .type = EventType::None } },
+		{ Screen::Dialog, 60, { .type = EventType::Dialog, .dialog_data = { .dialog_id = DialogId::Perda } } },
+		{ Screen::Gameplay, 150, { .type = EventType::None } },
+		{ Screen::White, 20, { .type = EventType::WhiteScreen } },
+		{ Screen::Gameplay, 150, { .type = EventType::None } },
+	};
+
+	constexpr uint32_t NUM_BLOCKS = 5;
+	constexpr uint32_t NUM_BACKGROUNDS = 8;		// the background changes every second
+
+	// rect in 1280x720 coordinates, scaled to the frame like Detector::BBoxConversion() does for a full frame game_rect
+	static cv::Rect ScaleRect(cv::Size size, int left, int right, int top, int bottom)
+	{
+		double scale = size.width / 1280.0;
+		int x0 = int(left * scale + 0.5);
+		int x1 = int(right * scale + 0.5);
+		int y0 = int(top * scale + 0.5);
+		int y1 = int(bottom * scale + 0.5);
+		return cv::Rect(x0, y0, x1 - x0, y1 - y0);
+	}
+
+	// Text filling height_ratio of the rect height (or width_ratio of its width if that's smaller), centered or left aligned.
+	// The ratios were chosen so the bright pixel ratios land inside the detector gates at 720p and 1080p
+	static void DrawText(cv::Mat& frame, const cv::Rect& rect, const std::string& text, double height_ratio, double width_ratio, bool centered)
+	{
+		int thickness = std::max(1, int(std::lround(1.6 * frame.cols / 1280.0)));
+		int baseline = 0;
+		cv::Size text_size = cv::getTextSize(text, cv::FONT_HERSHEY_DUPLEX, 1.0, thickness, &baseline);
+		double scale = std::min(rect.height * height_ratio / text_size.height, rect.width * width_ratio / text_size.width);
+		text_size = cv::getTextSize(text, cv::FONT_HERSHEY_DUPLEX, scale, thickness, &baseline);
+		int x = centered ? rect.x + (rect.width - text_size.width) / 2 : rect.x + int(rect.height * 0.3);
+		cv::putText(frame, text, cv::Point(x, rect.y + (rect.height + text_size.height) / 2), cv::FONT_HERSHEY_DUPLEX, scale, cv::Scalar(250, 250, 250), thickness, cv::LINE_AA);
+	}
+
+	static void DrawBox(cv::Mat& frame, const cv::Rect& rect, uint8_t grey)
+	{
+		cv::rectangle(frame, rect, cv::Scalar(grey, grey, grey), cv::FILLED);
+	}
+
+	// Blurry mid-grey noise, nothing in it is bright or dark enough for any gate
+	static cv::Mat MakeBackground(cv::Size size, std::mt19937& rng)
+	{
+		cv::Mat small(18, 32, CV_8UC3);
+		for (int i = 0; i < small.rows; i++)
+		{
+			uint8_t* data = small.ptr<uint8_t>(i);
+			for (int j = 0; j < small.cols * 3; j++)
+				data[j] = uint8_t(std::uniform_int_distribution<uint32_t>(60, 169)(rng));
+		}
+		cv::Mat background;
+		cv::resize(small, background, size, 0, 0, cv::INTER_LINEAR);
+		return background;
+	}
+
+	static cv::Mat RenderScreen(Screen screen, const cv::Mat& background)
+	{
+		cv::Size size = background.size();
+		cv::Mat frame = background.clone();
+		switch (screen)
+		{
+		case Screen::Gameplay:
+			break;
+		case Screen::Black:
+			frame.setTo(cv::Scalar(0, 0, 0));
+			break;
+		case Screen::White:
+			frame.setTo(cv::Scalar(255, 255, 255));
+			break;
+		case Screen::Loading:
+			// white top box, black bottom box
+			frame.setTo(cv::Scalar(0, 0, 0));
+			DrawBox(frame, cv::Rect(0, 0, size.width, size.height * 300 / 720), 255);
+			break;
+		case Screen::Item:
+		{
+			cv::Rect rect = ScaleRect(size, 528, 900, 264, 297);
+			DrawBox(frame, ScaleRect(size, 518, 910, 256, 305), 25);
+			DrawText(frame, rect, "Korok Seed", 0.7, 0.95, false);
+			break;
+		}
+		case Screen::Travel:
+			DrawBox(frame, ScaleRect(size, 500, 780, 474, 508), 20);
+			DrawText(frame, ScaleRect(size, 610, 672, 478, 504), "Travel", 0.7, 0.95, true);
+			break;
+		case Screen::Tower:
+			DrawBox(frame, ScaleRect(size, 400, 880, 540, 650), 40);
+			DrawText(frame, ScaleRect(size, 504, 777, 582, 609), "Sheikah Tower activated.", 0.7, 0.85, true);
+			break;
+		case Screen::GateRegistered:
+			DrawBox(frame, ScaleRect(size, 400, 880, 540, 650), 40);
+			DrawText(frame, ScaleRect(size, 470, 810, 582, 609), "Travel Gate registered to map.", 0.7, 0.95, true);
+			break;
+		case Screen::Dialog:
+			DrawBox(frame, ScaleRect(size, 400, 880, 520, 670), 40);
+			DrawText(frame, ScaleRect(size, 420, 850, 555, 582), "I guess I owe you too", 0.75, 0.95, true);
+			break;
+		default:
+			break;
+		}
+		return frame;
+	}
+
+	// The script, the rendering and the block count all change the frames, a video is only reused if it was generated by
+	// the same bench_e2e.cpp (its hash, see gen_source_hashes.ps1) at the same size and block count
+	static std::filesystem::path SyntheticVideoPath(const std::filesystem::path& dir, cv::Size size, uint32_t num_blocks)
+	{
+		std::ostringstream filename;
+		filename << "synthetic_e2e_" << size.width << 'x' << size.height << '_' << num_blocks << '_' << std::hex << std::setw(16) << std::setfill('0') << source_hashes::synthetic_video << ".avi";
+		return dir / filename.str();
+	}
+
+	bool MakeSyntheticVideo(const std::filesystem::path& path, cv::Size size, uint32_t num_blocks, std::vector<MultiFrameEvent>& out_expected, uint32_t& out_num_frames)
+	{
+		out_expected.clear();
+		uint32_t frame = 0;
+		for (uint32_t block = 0; block < num_blocks; block++)
+		{
+			for (const ScriptedEvent& e : script)
+			{
+				if (e.data.type != EventType::None)
+					out_expected.push_back({ .evt = { .frame_number = frame, .data = e.data }, .duration = e.num_frames });
+				frame += e.num_frames;
+			}
+		}
+		out_num_frames = frame;
+		std::sort(out_expected.begin(), out_expected.end());
+
+		if (std::filesystem::exists(path))
+			return true;
+
+		std::cout << "Generating " << path.string() << std::endl;
+		cv::VideoWriter writer(path.string(), cv::VideoWriter::fourcc('M', 'J', 'P', 'G'), 30, size);
+		if (!writer.isOpened())
+		{
+			std::cout << "Cannot write video file " << path.string() << std::endl;
+			return false;
+		}
+
+		std::mt19937 rng(42);
+		std::vector<cv::Mat> backgrounds;
+		for (uint32_t i = 0; i < NUM_BACKGROUNDS; i++)
+			backgrounds.push_back(MakeBackground(size, rng));
+
+		// every screen on every background, the frames are written from this cache
+		std::vector<std::array<cv::Mat, uint32_t(Screen::Max)>> screens(NUM_BACKGROUNDS);
+		for (uint32_t i = 0; i < NUM_BACKGROUNDS; i++)
+		{
+			for (uint32_t j = 0; j < uint32_t(Screen::Max); j++)
+				screens[i][j] = RenderScreen(Screen(j), backgrounds[i]);
+		}
+
+		frame = 0;
+		for (uint32_t block = 0; block < num_blocks; block++)
+		{
+			for (const ScriptedEvent& e : script)
+			{
+				for (uint32_t i = 0; i < e.num_frames; i++, frame++)
+					writer.write(screens[(frame / 30) % NUM_BACKGROUNDS][uint32_t(e.screen)]);
+			}
+		}
+		writer.release();
+		return true;
+	}
+
+	bool RunPipeline(const std::string& video_file, const cv::Rect& game_rect, uint32_t start_frame, uint32_t end_frame, uint32_t num_threads, PipelineResult& out_result)
+	{
+		VideoParserScheduler scheduler;
+		if (num_threads == 0 || num_threads > scheduler.GetNumThreads())
+			num_threads = scheduler.GetNumThreads();
+
+		AnalyseOptions options = { .context_aware = false, .hw_counters = false };
+		options.enabled_detectors.set();
+
+		std::vector<std::string_view> perf_detector_names(FrameDetectors::names.begin(), FrameDetectors::names.end());
+		perf_detector_names.push_back("location");
+
+		auto tbegin = std::chrono::steady_clock::now();
+		scheduler.AllocateWorkBatch(start_frame, end_frame, num_threads);
+		std::vector<std::thread> threads;
+		std::vector<std::vector<SingleFrameEvent>> events(num_threads);
+		std::vector<uint32_t> num_frame_parsed(num_threads, 0);
+		std::vector<perf::Counters> perf_counters(num_threads, perf::Counters(perf_detector_names));
+		std::vector<FrameDetectors::OrderReport> order_reports(num_threads, { .order = FrameDetectors::cascade_order, .expected_cost_us = 0, .num_reorders = 0 });
+		for (uint32_t thd_idx = 0; thd_idx < num_threads; thd_idx++)
+		{
+			threads.emplace_back(AnalyseVideo,
+				video_file,
+				game_rect,
+				1.0, 0.0,
+				std::ref(events[thd_idx]),
+				std::ref(num_frame_parsed[thd_idx]),
+				std::ref(scheduler),
+				thd_idx,
+				std::cref(options),
+				std::ref(order_reports[thd_idx]),
+				std::ref(perf_counters[thd_idx]));
+		}
+		for (std::thread& thread : threads)
+			thread.join();
+		out_result.analyse_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - tbegin).count();
+		out_result.num_threads = num_threads;
+		out_result.threads.clear();
+		perf::Counters total_counters(perf_detector_names);
+		for (const perf::Counters& counters : perf_counters)
+		{
+			out_result.threads.push_back({ .frames = counters.GetFrames(), .seeks = counters.GetSeeks(), .work_seconds = counters.GetWorkNs() / 1e9 });
+			total_counters.Merge(counters);
+		}
+		out_result.allocs_per_frame = total_counters.GetAllocsPerFrame();
+
+		std::vector<SingleFrameEvent> merged_events;
+		EventDeduper::MergeRuns(events, merged_events);
+		EventDeduper::Dedup(merged_events, out_result.deduped_events);
+		EventAssembler::Assemble(out_result.deduped_events, out_result.assembled_events);
+
+		out_result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - tbegin).count();
+		out_result.num_frames = std::accumulate(num_frame_parsed.begin(), num_frame_parsed.end(), 0u);
+		return true;
+	}
+
+	static std::string EventToString(const MultiFrameEvent& e)
+	{
+		std::string str = "[" + std::to_string(e.evt.frame_number) + ", " + std::to_string(e.LastFrame()) + "] " + std::string(util::GetEventText(e.evt.data.type));
+		if (e.evt.data.type == EventType::Dialog)
+			str += " " + std::string(util::DialogIdToString(e.evt.data.dialog_data.dialog_id));
+		return str;
+	}
+
+	static bool SameEvent(const MultiFrameEvent& a, const MultiFrameEvent& b)
+	{
+		return a.evt.frame_number == b.evt.frame_number && a.duration == b.duration && a.evt.data == b.evt.data;
+	}
+
+	static void WriteJSONStrings(std::ostream& os, const std::vector<std::string>& strs)
+	{
+		os << '[';
+		for (size_t i = 0; i < strs.size(); i++)
+		{
+			if (i)
+				os << ',';
+			WriteJSONString(os, strs[i]);
+		}
+		os << ']';
+	}
+
+	bool RunEndToEnd(const std::string& json_path, uint32_t num_threads)
+	{
+		if (!TesseractAPI::MapTrainedData("eng"))
+			return false;
+
+		std::ostringstream os;
+		os << std::fixed << std::setprecision(3);
+		os << "{\"benchmark\":\"e2e\",\"results\":[" << std::endl;
+		bool all_passed = true;
+		for (size_t r = 0; r < std::size(resolutions); r++)
+		{
+			const Resolution& res = resolutions[r];
+			std::filesystem::path video_path = SyntheticVideoPath(std::filesystem::path(json_path).parent_path(), res.size, NUM_BLOCKS);
+			std::vector<MultiFrameEvent> expected;
+			uint32_t num_frames = 0;
+			if (!MakeSyntheticVideo(video_path, res.size, NUM_BLOCKS, expected, num_frames))
+				return false;
+
+			PipelineResult result;
+			if (!RunPipeline(video_path.string(), cv::Rect(0, 0, res.size.width, res.size.height), 0, num_frames - 1, num_threads, result))
+				return false;
+
+			std::vector<std::string> missing, unexpected;
+			for (const MultiFrameEvent& e : expected)
+			{
+				if (std::none_of(result.deduped_events.begin(), result.deduped_events.end(), [&e](const MultiFrameEvent& d) { return SameEvent(e, d); }))
+					missing.push_back(EventToString(e));
+			}
+			for (const MultiFrameEvent& d : result.deduped_events)
+			{
+				if (std::none_of(expected.begin(), expected.end(), [&d](const MultiFrameEvent& e) { return SameEvent(e, d); }))
+					unexpected.push_back(EventToString(d));
+			}
+			std::map<std::string_view, uint32_t> assembled_count;
+			for (const auto& e : result.assembled_events)
+				assembled_count[util::GetEventText(e->evt.data.type)]++;
+
+			double fps = result.seconds > 0 ? result.num_frames / result.seconds : 0;
+			std::cout << res.name << ": " << result.num_frames << " frames in " << std::fixed << std::setprecision(2) << result.seconds << " s, " << fps << " fps, "
+				<< expected.size() - missing.size() << "/" << expected.size() << " events exact" << std::endl;
+			for (const std::string& str : missing)
+				std::cout << "!!! missing " << str << std::endl;
+			for (const std::string& str : unexpected)
+				std::cout << "!!! unexpected " << str << std::endl;
+			if (result.num_frames != num_frames)
+				std::cout << "!!! " << result.num_frames << " frames parsed, " << num_frames << " expected" << std::endl;
+			bool passed = missing.empty() && unexpected.empty() && result.num_frames == num_frames;
+			all_passed = all_passed && passed;
+
+			os << "{\"resolution\":\"" << res.name << "\",\"frames\":" << result.num_frames << ",\"seconds\":" << result.seconds << ",\"fps\":" << fps
+				<< ",\"expected_events\":" << expected.size() << ",\"exact_events\":" << expected.size() - missing.size() << ",\"passed\":" << (passed ? "true" : "false")
+				<< ",\"missing\":";
+			WriteJSONStrings(os, missing);
+			os << ",\"unexpected\":";
+			WriteJSONStrings(os, unexpected);
+			os << ",\"assembled\":{";
+			for (auto itor = assembled_count.begin(); itor != assembled_count.end(); itor++)
+			{
+				if (itor != assembled_count.begin())
+					os << ',';
+				WriteJSONString(os, itor->first);
+				os << ':' << itor->second;
+			}
+			os << "}}" << (r + 1 < std::size(resolutions) ? "," : "") << std::endl;
+		}
+		os << "]}" << std::endl;
+
+		std::ofstream ofs(json_path);
+		if (!ofs.is_open())
+		{
+			std::cout << "Cannot write benchmark file " << json_path << std::endl;
+			return false;
+		}
+		ofs << os.str();
+		std::cout << "Results written to " << json_path << std::endl;
+		return all_passed;
+	}
+
+	bool CheckAllocBudget(double budget, const std::string& dir)
+	{
+		if (!alloc::Enable())
+		{
+			std::cout << "--check-alloc-budget needs the Profile build (ALLOC_TRACKING)" << std::endl;
+			return false;
+		}
+		if (!TesseractAPI::MapTrainedData("eng"))
+			return false;
+
+		const Resolution& res = resolutions[0];
+		std::filesystem::path video_path = SyntheticVideoPath(dir, res.size, NUM_BLOCKS);
+		std::vector<MultiFrameEvent> expected;
+		uint32_t num_frames = 0;
+		if (!MakeSyntheticVideo(video_path, res.size, NUM_BLOCKS, expected, num_frames))
+			return false;
+
+		PipelineResult result;
+		if (!RunPipeline(video_path.string(), cv::Rect(0, 0, res.size.width, res.size.height), 0, num_frames - 1, 0, result))
+			return false;
+		std::cout << "Allocations: " << result.allocs_per_frame << " per frame over " << result.num_frames << " frames, budget " << budget << std::endl;
+		if (result.allocs_per_frame > budget)
+		{
+			std::cout << "!!! " << result.allocs_per_frame << " allocations per frame above the budget (" << budget << ")" << std::endl;
+			return false;
+		}
+		return true;
+	}
+}
@@ -0,0 +1,351 @@
+#include <fstream>
+#include <iomanip>
+#include <random>
+#include "bench.h"
+#include "deduper.h"
+#include "alloc_tracker.h"
+
+namespace bench
+{
+	enum class Activity : uint8_t
+	{
+		Korok,
+		Load,
+		Warp,
+		Shrine,
+		DivineBeast,
+		Tower,
+		Memory,
+		ZoraMonument,
+		Dialog,
+	};
+
+	struct ActivityRate
+	{
+		Activity activity;
+		double per_hour;
+	};
+
+	// roughly a 50 hour 100% run: 900 koroks, 120 shrines, 4 divine beasts, 15 towers, 13 memories, 10 monuments
+	constexpr ActivityRate activity_rates[] = {
+		{ Activity::Korok,			18 },
+		{ Activity::Load,			20 },
+		{ Activity::Warp,			30 },
+		{ Activity::Shrine,			2.4 },
+		{ Activity::DivineBeast,	0.08 },
+		{ Activity::Tower,			0.3 },
+		{ Activity::Memory,			0.26 },
+		{ Activity::ZoraMonument,	0.2 },
+		{ Activity::Dialog,			2 },
+	};
+
+	constexpr uint32_t FRAMES_PER_HOUR = 30 * 60 * 60;
+	constexpr uint32_t MIN_GAMEPLAY_FRAMES = 300;		// between two activities, longer than any dedup spacing
+	constexpr double FLICKER_RATE = 0.02;				// frames of a screen the detector misses, e.g. compression artifacts
+	constexpr uint32_t PATCH_INTERVAL = 50;				// every Nth korok is patched out, every Nth gap gets a korok patched in
+	// the raw events reach the main thread as per-thread vectors of work items
+	constexpr uint32_t STREAM_THREADS = 8;
+	constexpr uint32_t STREAM_WORK_ITEM_FRAMES = 1800;
+	constexpr uint32_t default_hours[] = { 1, 10, 50 };
+
+	constexpr EventType divine_beast_abilities[] = { EventType::RevaliGale, EventType::UrbosaFury, EventType::MiphaGrace, EventType::DarukProtection };
+	constexpr EventType divine_beasts[] = { EventType::Medoh, EventType::Naboris, EventType::Ruta, EventType::Rudania };
+
+	struct SyntheticStream
+	{
+		uint32_t num_frames = 0;
+		std::vector<SingleFrameEvent> events;		// frame order
+		std::vector<RunConfig::Video::Patch> patches;
+		std::map<EventType, uint32_t> expected;		// assembled events by type
+	};
+
+	class StreamWriter
+	{
+	private:
+		SyntheticStream& _stream;
+		std::mt19937& _rng;
+		uint32_t _frame = 0;
+
+	public:
+		StreamWriter(SyntheticStream& stream, std::mt19937& rng)
+			: _stream(stream)
+			, _rng(rng)
+		{
+		}
+
+		uint32_t Frame() const { return _frame; }
+		uint32_t Uniform(uint32_t lower, uint32_t upper) { return std::uniform_int_distribution<uint32_t>(lower, upper)(_rng); }
+
+		void Gameplay(uint32_t num_frames)
+		{
+			_frame += num_frames;
+		}
+
+		// The first and the last frame are always detected, so the deduped duration doesn't depend on the flicker, and
+		// never two frames in a row are missed, which would split a black screen in two
+		void Screen(SingleFrameEventData data, uint32_t num_frames)
+		{
+			std::bernoulli_distribution flicker(FLICKER_RATE);
+			bool missed = false;
+			for (uint32_t i = 0; i < num_frames; i++, _frame++)
+			{
+				missed = !missed && i != 0 && i + 1 != num_frames && flicker(_rng);
+				if (!missed)
+					_stream.events.push_back({ .frame_number = _frame, .data = data });
+			}
+		}
+
+		void Screen(EventType type, uint32_t num_frames)
+		{
+			Screen({ .type = type }, num_frames);
+		}
+
+		void Load()
+		{
+			Screen(EventType::BlackScreen, 20);
+			Screen(EventType::LoadingScreen, Uniform(150, 450));
+			Screen(EventType::BlackScreen, 20);
+		}
+	};
+
+	static void WriteActivity(StreamWriter& writer, Activity activity, uint32_t index)
+	{
+		switch (activity)
+		{
+		case Activity::Korok:
+			writer.Screen(EventType::Korok, 45);
+			break;
+		case Activity::Load:
+			writer.Load();
+			break;
+		case Activity::Warp:
+			writer.Screen(EventType::TravelButton, 30);
+			writer.Gameplay(90);
+			writer.Load();
+			break;
+		case Activity::Shrine:
+			writer.Load();
+			writer.Gameplay(30);
+			writer.Screen(EventType::BlackScreen, 20);		// enter cutscene skipped
+			writer.Gameplay(writer.Uniform(3000, 12000));
+			writer.Screen(EventType::BlackScreen, 20);		// the glowing box breaks
+			writer.Screen(EventType::SpiritOrb, 60);
+			writer.Gameplay(300);
+			writer.Load();
+			break;
+		case Activity::DivineBeast:
+			writer.Screen(EventType::GateRegistered, 60);
+			for (uint32_t i = 0; i < 5; i++)
+			{
+				writer.Gameplay(1800);
+				writer.Screen(EventType::SlateAuthenticated, 60);
+			}
+			writer.Gameplay(600);
+			writer.Screen(EventType::BlackScreen, 20);		// blight fight starts
+			writer.Gameplay(3000);
+			writer.Screen(EventType::WhiteScreen, 30);		// blight defeated
+			writer.Gameplay(600);
+			writer.Screen(divine_beast_abilities[index % std::size(divine_beast_abilities)], 90);
+			break;
+		case Activity::Tower:
+			writer.Screen(EventType::TowerActivation, 120);
+			break;
+		case Activity::Memory:
+			writer.Screen(EventType::AlbumPage, 60);
+			writer.Gameplay(343);
+			writer.Screen(EventType::WhiteScreen, 30);		// fade in
+			writer.Gameplay(100);
+			writer.Screen(EventType::WhiteScreen, 30);		// fade out
+			break;
+		case Activity::ZoraMonument:
+			writer.Screen({ .type = EventType::ZoraMonument, .monument_data = { .monument_id = uint8_t(index % 10 + 1) } }, 60);
+			break;
+		case Activity::Dialog:
+			writer.Screen({ .type = EventType::Dialog, .dialog_data = { .dialog_id = DialogId(index % (uint32_t(DialogId::Max) - 1) + 1) } }, 90);
+			break;
+		}
+	}
+
+	static EventType AssembledType(Activity activity, uint32_t index)
+	{
+		switch (activity)
+		{
+		case Activity::Korok: return EventType::Korok;
+		case Activity::Load: return EventType::Load;
+		case Activity::Warp: return EventType::Warp;
+		case Activity::Shrine: return EventType::Shrine;
+		case Activity::DivineBeast: return divine_beasts[index % std::size(divine_beasts)];
+		case Activity::Tower: return EventType::TowerActivation;
+		case Activity::Memory: return EventType::Memory;
+		case Activity::ZoraMonument: return EventType::ZoraMonument;
+		case Activity::Dialog: return EventType::Dialog;
+		}
+		return EventType::None;
+	}
+
+	/**
+	 * Raw events of a run of the given length: the activities of activity_rates in random order with gameplay in between,
+	 * each screen detected on every frame but a few, plus patches removing some koroks and adding others.
+	 * expected gets what EventAssembler::Assemble() should produce once the patches are applied.
+	 */
+	static void MakeSyntheticStream(uint32_t hours, uint32_t seed, SyntheticStream& out_stream)
+	{
+		std::mt19937 rng(seed);
+		std::vector<Activity> activities;
+		for (const ActivityRate& rate : activity_rates)
+		{
+			uint32_t count = std::max(1u, uint32_t(std::lround(rate.per_hour * hours)));
+			activities.insert(activities.end(), count, rate.activity);
+		}
+		std::shuffle(activities.begin(), activities.end(), rng);
+
+		StreamWriter writer(out_stream, rng);
+		uint32_t num_frames = hours * FRAMES_PER_HOUR;
+		std::map<Activity, uint32_t> activity_index;
+		for (size_t i = 0; i < activities.size(); i++)
+		{
+			// spread the rest of the run over the gaps that are left
+			uint32_t remaining = num_frames > writer.Frame() ? num_frames - writer.Frame() : 0;
+			uint32_t mean_gap = remaining / uint32_t(activities.size() - i) / 2;
+			uint32_t gap = writer.Uniform(MIN_GAMEPLAY_FRAMES, std::max(MIN_GAMEPLAY_FRAMES, 2 * mean_gap));
+			if ((i + 1) % PATCH_INTERVAL == 0)
+			{
+				// a korok popup the detector missed, well clear of the activities around it
+				out_stream.patches.push_back({ .evt = { .frame_number = writer.Frame() + 100, .data = { .type = EventType::Korok } }, .end_frame = writer.Frame() + 129, .remove = false });
+				out_stream.expected[EventType::Korok]++;
+			}
+			writer.Gameplay(gap);
+
+			uint32_t index = activity_index[activities[i]]++;
+			uint32_t begin_frame = writer.Frame();
+			WriteActivity(writer, activities[i], index);
+			if (activities[i] == Activity::Korok && (index + 1) % PATCH_INTERVAL == 0)
+			{
+				// a false positive
+				out_stream.patches.push_back({ .evt = { .frame_number = begin_frame, .data = { .type = EventType::Korok } }, .end_frame = writer.Frame() - 1, .remove = true });
+				continue;
+			}
+			out_stream.expected[AssembledType(activities[i], index)]++;
+		}
+		writer.Gameplay(MIN_GAMEPLAY_FRAMES);
+		out_stream.num_frames = std::max(num_frames, writer.Frame());
+	}
+
+	struct StageResult
+	{
+		const char* name;
+		double seconds;
+		int64_t peak_bytes;			// above the live heap when the stage started
+		int64_t retained_bytes;		// still allocated when it ended
+	};
+
+	template<typename Func>
+	static StageResult MeasureStage(const char* name, Func&& func)
+	{
+		alloc::FlushThread();
+		int64_t base_bytes = alloc::GetLiveBytes();
+		alloc::ResetPeak();
+		auto tbegin = std::chrono::steady_clock::now();
+		func();
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - tbegin).count();
+		alloc::FlushThread();
+		return { .name = name, .seconds = seconds, .peak_bytes = alloc::GetPeakBytes() - base_bytes, .retained_bytes = alloc::GetLiveBytes() - base_bytes };
+	}
+
+	bool RunPostProcess(const std::string& json_path, uint32_t hours)
+	{
+		if (!alloc::Enable())
+			std::cout << "No ALLOC_TRACKING in this build, the heap peaks are reported as 0" << std::endl;
+
+		std::vector<uint32_t> run_hours;
+		if (hours != 0)
+			run_hours.push_back(hours);
+		else
+			run_hours.assign(std::begin(default_hours), std::end(default_hours));
+
+		std::ostringstream os;
+		os << std::fixed << std::setprecision(3);
+		os << "{\"benchmark\":\"postprocess\",\"results\":[" << std::endl;
+		bool all_passed = true;
+		for (size_t r = 0; r < run_hours.size(); r++)
+		{
+			SyntheticStream stream;
+			MakeSyntheticStream(run_hours[r], 1234 + run_hours[r], stream);
+
+			// the work threads hand their events over as one vector each, work items are handed out round robin
+			std::vector<std::vector<SingleFrameEvent>> thread_events(STREAM_THREADS);
+			for (const SingleFrameEvent& e : stream.events)
+				thread_events[e.frame_number / STREAM_WORK_ITEM_FRAMES % STREAM_THREADS].push_back(e);
+
+			std::vector<SingleFrameEvent> merged_events;
+			std::vector<MultiFrameEvent> deduped_events;
+			std::vector<std::shared_ptr<AssembledEvent>> assembled_events;
+			uint32_t num_added = 0, num_removed = 0;
+			size_t yaml_size = 0;
+			std::vector<StageResult> stages;
+			stages.push_back(MeasureStage("merge", [&]() {
+				EventDeduper::MergeRuns(thread_events, merged_events);
+			}));
+			stages.push_back(MeasureStage("patch", [&]() {
+				EventDeduper::ApplyPatches(stream.patches, merged_events, num_added, num_removed);
+			}));
+			stages.push_back(MeasureStage("dedup", [&]() {
+				EventDeduper::Dedup(merged_events, deduped_events);
+			}));
+			stages.push_back(MeasureStage("assemble", [&]() {
+				EventAssembler::Assemble(deduped_events, assembled_events);
+			}));
+			stages.push_back(MeasureStage("yaml", [&]() {
+				yaml_size += EventDeduper::DedupedEventsToYAMLString(deduped_events).size();
+				yaml_size += EventAssembler::AssembledEventsToYAMLString(assembled_events).size();
+			}));
+
+			std::map<EventType, uint32_t> assembled_count;
+			for (const auto& e : assembled_events)
+				assembled_count[e->evt.data.type]++;
+			bool passed = assembled_count == stream.expected;
+			all_passed = all_passed && passed;
+
+			std::cout << run_hours[r] << " h: " << stream.events.size() << " raw events, " << stream.patches.size() << " patches, " << deduped_events.size() << " deduped, "
+				<< assembled_events.size() << " assembled" << std::endl;
+			for (const StageResult& stage : stages)
+			{
+				std::cout << "  " << std::left << std::setw(10) << stage.name << std::right << std::fixed << std::setprecision(3) << std::setw(9) << stage.seconds << " s"
+					<< std::setprecision(1) << std::setw(9) << stage.peak_bytes / (1024.0 * 1024.0) << " MB peak" << std::setw(9) << stage.retained_bytes / (1024.0 * 1024.0) << " MB retained" << std::endl;
+			}
+			if (!passed)
+			{
+				std::set<EventType> types;
+				for (const auto& [type, count] : stream.expected)
+					types.insert(type);
+				for (const auto& [type, count] : assembled_count)
+					types.insert(type);
+				for (EventType type : types)
+				{
+					if (assembled_count[type] != stream.expected[type])
+						std::cout << "!!! " << assembled_count[type] << " " << util::GetEventText(type) << " events assembled, " << stream.expected[type] << " expected" << std::endl;
+				}
+			}
+
+			os << "{\"hours\":" << run_hours[r] << ",\"frames\":" << stream.num_frames << ",\"raw_events\":" << stream.events.size() << ",\"patches\":" << stream.patches.size()
+				<< ",\"deduped_events\":" << deduped_events.size() << ",\"assembled_events\":" << assembled_events.size() << ",\"passed\":" << (passed ? "true" : "false") << ",\"stages\":[";
+			for (size_t s = 0; s < stages.size(); s++)
+			{
+				os << (s ? "," : "") << "{\"name\":\"" << stages[s].name << "\",\"seconds\":" << stages[s].seconds << ",\"peak_bytes\":" << stages[s].peak_bytes
+					<< ",\"retained_bytes\":" << stages[s].retained_bytes << "}";
+			}
+			os << "]}" << (r + 1 < run_hours.size() ? "," : "") << std::endl;
+		}
+		os << "]}" << std::endl;
+
+		std::ofstream ofs(json_path);
+		if (!ofs.is_open())
+		{
+			std::cout << "Cannot write benchmark file " << json_path << std::endl;
+			return false;
+		}
+		ofs << os.str();
+		std::cout << "Results written to " << json_path << std::endl;
+		return all_passed;
+	}
+}
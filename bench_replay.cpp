@@ -0,0 +1,118 @@
+#include <fstream>
+#include <iomanip>
+#include "bench.h"
+#include "analyse.h"
+#include "corpus.h"
+#include "location_detector.h"
+#include "tess_api.h"
+
+namespace bench
+{
+	bool RunReplay(const std::string& corpus_file, const std::string& json_path)
+	{
+		auto load_tbegin = std::chrono::steady_clock::now();
+		std::vector<corpus::Record> records;
+		if (!corpus::Load(corpus_file, records))
+			return false;
+		if (records.empty())
+		{
+			std::cout << corpus_file << " has no records" << std::endl;
+			return false;
+		}
+		// threads record in no particular order
+		std::sort(records.begin(), records.end(), [](const corpus::Record& a, const corpus::Record& b) { return a.frame_number < b.frame_number; });
+		double load_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - load_tbegin).count();
+
+		if (!TesseractAPI::MapTrainedData("eng"))
+			return false;
+		TesseractAPI tess_api;
+		if (!tess_api.Init("eng"))
+			return false;
+		LocationDetector location_detector(tess_api.API());
+		if (!location_detector.Init("eng"))
+			return false;
+		FrameDetectors::EnableFlags enabled;
+		enabled.set();
+		FrameDetectors detectors(tess_api.API(), enabled);
+		if (!detectors.Init("eng"))
+			return false;
+
+		std::vector<std::string_view> perf_detector_names(FrameDetectors::names.begin(), FrameDetectors::names.end());
+		perf_detector_names.push_back("location");
+		perf::Counters perf_counters(perf_detector_names);
+		perf::BindThread(&perf_counters);
+		corpus::BeginReplay();
+
+		// every detector runs on every record, the context that skipped some of them while recording isn't known here
+		std::vector<SingleFrameEvent> events;
+		cv::Mat frame;
+		auto tbegin = std::chrono::steady_clock::now();
+		for (const corpus::Record& record : records)
+		{
+			corpus::ReplayFrame(record, frame);
+			{
+				perf::ScopedDetector perf_scope(LOCATION_PERF_INDEX);
+				if (!location_detector.GetLocation(frame, record.game_rect).empty())
+					perf_scope.SetDetected();
+			}
+			detectors.ProcessFrame(frame, record.game_rect, record.frame_number, 0, events);
+			perf_counters.CountFrame();
+		}
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - tbegin).count();
+		uint64_t uncovered = corpus::EndReplay();
+		perf::BindThread(nullptr);
+
+		std::map<std::string_view, uint32_t> event_count;
+		for (const SingleFrameEvent& e : events)
+			event_count[util::GetEventText(e.data.type)]++;
+
+		double fps = seconds > 0 ? records.size() / seconds : 0;
+		std::cout << corpus_file << ": " << records.size() << " records loaded in " << std::fixed << std::setprecision(2) << load_seconds << " s, replayed in "
+			<< seconds << " s, " << fps << " fps, " << events.size() << " events" << std::endl;
+		std::cout << "detector                 calls    ocr  detections   mean (us)" << std::endl;
+		for (uint32_t i = 0; i < uint32_t(perf_detector_names.size()); i++)
+		{
+			const perf::DetectorCounters& counters = perf_counters.GetDetector(i);
+			double mean_us = counters.calls ? counters.time.TotalNs() / 1e3 / counters.calls : 0;
+			std::cout << std::left << std::setw(21) << perf_detector_names[i] << std::right << std::setw(9) << counters.calls << std::setw(7) << counters.ocr_calls
+				<< std::setw(12) << counters.detections << std::setw(12) << mean_us << std::endl;
+		}
+		if (uncovered > 0)
+			std::cout << "!!! " << uncovered << " ROI reads outside of the recorded crops, the detectors changed since the corpus was recorded" << std::endl;
+
+		std::ostringstream os;
+		os << std::fixed << std::setprecision(3);
+		os << "{\"benchmark\":\"replay\",\"corpus\":";
+		WriteJSONString(os, corpus_file);
+		os << ",\"records\":" << records.size() << ",\"load_seconds\":" << load_seconds << ",\"seconds\":" << seconds << ",\"fps\":" << fps
+			<< ",\"uncovered_rois\":" << uncovered << ",\"events\":{";
+		for (auto itor = event_count.begin(); itor != event_count.end(); itor++)
+		{
+			if (itor != event_count.begin())
+				os << ',';
+			WriteJSONString(os, itor->first);
+			os << ':' << itor->second;
+		}
+		os << "},\"detectors\":[" << std::endl;
+		for (uint32_t i = 0; i < uint32_t(perf_detector_names.size()); i++)
+		{
+			const perf::DetectorCounters& counters = perf_counters.GetDetector(i);
+			os << "{\"name\":";
+			WriteJSONString(os, perf_detector_names[i]);
+			os << ",\"calls\":" << counters.calls << ",\"gate_passes\":" << counters.gate_passes << ",\"ocr_calls\":" << counters.ocr_calls
+				<< ",\"detections\":" << counters.detections << ",\"mean_ns\":" << (counters.calls ? counters.time.TotalNs() / counters.calls : 0)
+				<< ",\"p99_ns\":" << counters.time.PercentileNs(0.99) << "}" << (i + 1 < perf_detector_names.size() ? "," : "") << std::endl;
+		}
+		os << "]}" << std::endl;
+
+		std::ofstream ofs(json_path);
+		if (!ofs.is_open())
+		{
+			std::cout << "Cannot write benchmark file " << json_path << std::endl;
+			return false;
+		}
+		ofs << os.str();
+		std::cout << "Results written to " << json_path << std::endl;
+		return true;
+	}
+}
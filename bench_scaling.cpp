@@ -0,0 +1,94 @@
+#include <fstream>
+#include <iomanip>
+#include "bench.h"
+#include "scheduler.h"
+#include "tess_api.h"
+
+namespace bench
+{
+	bool RunScaling(const std::string& video_file, uint32_t start_frame, uint32_t num_frames, const std::string& json_path)
+	{
+		cv::VideoCapture cap(video_file);
+		if (!cap.isOpened())
+		{
+			std::cout << "Cannot open video file " << video_file << std::endl;
+			return false;
+		}
+		cv::Rect game_rect(0, 0, int(cap.get(cv::CAP_PROP_FRAME_WIDTH)), int(cap.get(cv::CAP_PROP_FRAME_HEIGHT)));
+		uint32_t video_frames = uint32_t(cap.get(cv::CAP_PROP_FRAME_COUNT));
+		cap.release();
+		if (start_frame >= video_frames)
+		{
+			std::cout << "Start frame " << start_frame << " is past the end of " << video_file << " (" << video_frames << " frames)" << std::endl;
+			return false;
+		}
+		num_frames = std::min(num_frames, video_frames - start_frame);
+
+		if (!TesseractAPI::MapTrainedData("eng"))
+			return false;
+
+		uint32_t max_threads = VideoParserScheduler().GetNumThreads();
+		std::vector<uint32_t> thread_counts;
+		for (uint32_t n = 1; n < max_threads; n *= 2)
+			thread_counts.push_back(n);
+		thread_counts.push_back(max_threads);
+
+		std::cout << video_file << ": frames [" << start_frame << ", " << start_frame + num_frames - 1 << "], " << game_rect.width << "x" << game_rect.height << std::endl;
+		std::cout << "threads       fps  efficiency  seeks  idle (s) per thread" << std::endl;
+
+		std::ostringstream os;
+		os << std::fixed << std::setprecision(3);
+		os << "{\"benchmark\":\"scaling\",\"video\":";
+		WriteJSONString(os, video_file);
+		os << ",\"start_frame\":" << start_frame << ",\"num_frames\":" << num_frames << ",\"results\":[" << std::endl;
+		double single_fps = 0;
+		for (size_t i = 0; i < thread_counts.size(); i++)
+		{
+			PipelineResult result;
+			if (!RunPipeline(video_file, game_rect, start_frame, start_frame + num_frames - 1, thread_counts[i], result))
+				return false;
+
+			// decode and detection only, dedup and assembly are single threaded and not what is being scaled
+			double fps = result.analyse_seconds > 0 ? result.num_frames / result.analyse_seconds : 0;
+			if (result.num_threads == 1)
+				single_fps = fps;
+			double efficiency = single_fps > 0 ? fps / (result.num_threads * single_fps) : 0;
+			uint64_t seeks = 0;
+			std::vector<double> idle_seconds;
+			for (const PipelineThreadStats& stats : result.threads)
+			{
+				seeks += stats.seeks;
+				idle_seconds.push_back(std::max(0.0, result.analyse_seconds - stats.work_seconds));
+			}
+
+			std::cout << std::setw(7) << result.num_threads << std::fixed << std::setprecision(1) << std::setw(10) << fps
+				<< std::setprecision(2) << std::setw(12) << efficiency << std::setw(7) << seeks << " ";
+			for (double idle : idle_seconds)
+				std::cout << " " << idle;
+			std::cout << std::endl;
+			if (result.num_frames != num_frames)
+				std::cout << "!!! " << result.num_frames << " frames parsed with " << result.num_threads << " threads, " << num_frames << " expected" << std::endl;
+
+			os << "{\"threads\":" << result.num_threads << ",\"frames\":" << result.num_frames << ",\"seconds\":" << result.analyse_seconds
+				<< ",\"fps\":" << fps << ",\"efficiency\":" << efficiency << ",\"seeks\":" << seeks << ",\"per_thread\":[";
+			for (size_t t = 0; t < result.threads.size(); t++)
+			{
+				const PipelineThreadStats& stats = result.threads[t];
+				os << (t ? "," : "") << "{\"frames\":" << stats.frames << ",\"seeks\":" << stats.seeks << ",\"work_seconds\":" << stats.work_seconds
+					<< ",\"idle_seconds\":" << idle_seconds[t] << "}";
+			}
+			os << "]}" << (i + 1 < thread_counts.size() ? "," : "") << std::endl;
+		}
+		os << "]}" << std::endl;
+
+		std::ofstream ofs(json_path);
+		if (!ofs.is_open())
+		{
+			std::cout << "Cannot write benchmark file " << json_path << std::endl;
+			return false;
+		}
+		ofs << os.str();
+		std::cout << "Results written to " << json_path << std::endl;
+		return true;
+	}
+}
@@ -0,0 +1,144 @@
+#include <fstream>
+#include <iomanip>
+#include "yaml-cpp/yaml.h"
+#include "bench.h"
+#include "scheduling_policy.h"
+
+namespace bench
+{
+	// used when no item of the trace needed a seek
+	constexpr uint64_t DEFAULT_SEEK_NS = 100'000'000;
+
+	struct SimulationResult
+	{
+		uint64_t makespan_ns;
+		uint64_t busy_ns;			// work and seeks summed over the workers
+		uint32_t seeks;
+	};
+
+	/**
+	 * Hand out the items of the trace to num_workers virtual workers through the policy. The worker that's idle first
+	 * asks for the next item, like the work threads do live. A worker pays seek_ns unless it continues with the item
+	 * right after its last one (or starts with item 0, where the video is positioned).
+	 */
+	static SimulationResult Simulate(SchedulingPolicy& policy, std::span<const uint64_t> work_ns, uint64_t seek_ns, uint32_t num_workers)
+	{
+		WorkItemSegments remaining;
+		remaining.Reset(uint32_t(work_ns.size()));
+		policy.Reset(uint32_t(work_ns.size()), num_workers);
+
+		std::vector<uint64_t> worker_time(num_workers, 0);
+		std::vector<int32_t> worker_last_item(num_workers, -1);
+		SimulationResult result = { .makespan_ns = 0, .busy_ns = 0, .seeks = 0 };
+		while (!remaining.Empty())
+		{
+			uint32_t worker = uint32_t(std::min_element(worker_time.begin(), worker_time.end()) - worker_time.begin());
+			int32_t last_item = worker_last_item[worker];
+			uint32_t item = policy.PickItem(worker, last_item, remaining);
+			remaining.Take(item, last_item);
+
+			uint64_t ns = work_ns[item];
+			if (item != uint32_t(last_item + 1))
+			{
+				ns += seek_ns;
+				result.seeks++;
+			}
+			worker_time[worker] += ns;
+			worker_last_item[worker] = int32_t(item);
+			result.busy_ns += ns;
+		}
+		result.makespan_ns = *std::max_element(worker_time.begin(), worker_time.end());
+		return result;
+	}
+
+	bool RunScheduleSimulation(const std::string& trace_file, uint32_t max_workers, const std::string& json_path)
+	{
+		std::vector<uint64_t> work_ns;
+		uint64_t total_seek_ns = 0;
+		uint32_t num_traced_seeks = 0;
+		uint32_t traced_workers = 0;
+		try {
+			YAML::Node trace_node = YAML::LoadFile(trace_file);
+			if (trace_node["num_workers"])
+				traced_workers = trace_node["num_workers"].as<uint32_t>();
+			YAML::Node items_node = trace_node["items"];
+			if (!items_node || !items_node.IsSequence())
+			{
+				std::cout << trace_file << ": items is missing" << std::endl;
+				return false;
+			}
+			for (std::size_t idx = 0; idx < items_node.size(); idx++)
+			{
+				work_ns.push_back(items_node[idx][0].as<uint64_t>());
+				uint64_t seek_ns = items_node[idx][1].as<uint64_t>();
+				if (seek_ns > 0)
+				{
+					total_seek_ns += seek_ns;
+					num_traced_seeks++;
+				}
+			}
+		}
+		catch (const YAML::Exception& e)
+		{
+			std::cout << "Cannot read schedule trace " << trace_file << ": " << e.what() << std::endl;
+			return false;
+		}
+		if (work_ns.empty())
+		{
+			std::cout << trace_file << " has no work items" << std::endl;
+			return false;
+		}
+
+		uint64_t seek_ns = num_traced_seeks > 0 ? total_seek_ns / num_traced_seeks : DEFAULT_SEEK_NS;
+		if (max_workers == 0)
+			max_workers = traced_workers > 0 ? traced_workers : 8;
+		std::vector<uint32_t> worker_counts;
+		for (uint32_t n = 1; n < max_workers; n *= 2)
+			worker_counts.push_back(n);
+		worker_counts.push_back(max_workers);
+
+		uint64_t total_work_ns = 0;
+		for (uint64_t ns : work_ns)
+			total_work_ns += ns;
+		// cost_weighted gets the trace itself as its estimates, which makes it a best case
+		std::vector<double> item_costs(work_ns.begin(), work_ns.end());
+
+		std::cout << trace_file << ": " << work_ns.size() << " work items, " << std::fixed << std::setprecision(1) << total_work_ns / 1e9 << " s of work, "
+			<< seek_ns / 1e6 << " ms per seek" << (num_traced_seeks > 0 ? "" : " (default)") << std::endl;
+		std::cout << "policy               workers  makespan (s)  speedup  efficiency  seeks" << std::endl;
+
+		std::ostringstream os;
+		os << std::fixed << std::setprecision(3);
+		os << "{\"benchmark\":\"schedule\",\"trace\":";
+		WriteJSONString(os, trace_file);
+		os << ",\"items\":" << work_ns.size() << ",\"work_seconds\":" << total_work_ns / 1e9 << ",\"seek_seconds\":" << seek_ns / 1e9 << ",\"results\":[" << std::endl;
+		bool first_result = true;
+		for (std::string_view name : scheduling_policy_names)
+		{
+			std::unique_ptr<SchedulingPolicy> policy = MakeSchedulingPolicy(name, item_costs);
+			for (uint32_t num_workers : worker_counts)
+			{
+				SimulationResult result = Simulate(*policy, work_ns, seek_ns, num_workers);
+				double speedup = result.makespan_ns > 0 ? double(total_work_ns) / result.makespan_ns : 0;
+				double efficiency = speedup / num_workers;
+				std::cout << std::left << std::setw(21) << name << std::right << std::setw(7) << num_workers << std::setprecision(1) << std::setw(14) << result.makespan_ns / 1e9
+					<< std::setprecision(2) << std::setw(9) << speedup << std::setw(12) << efficiency << std::setw(7) << result.seeks << std::endl;
+
+				os << (first_result ? "" : ",\n") << "{\"policy\":\"" << name << "\",\"workers\":" << num_workers << ",\"makespan_seconds\":" << result.makespan_ns / 1e9
+					<< ",\"busy_seconds\":" << result.busy_ns / 1e9 << ",\"speedup\":" << speedup << ",\"efficiency\":" << efficiency << ",\"seeks\":" << result.seeks << "}";
+				first_result = false;
+			}
+		}
+		os << std::endl << "]}" << std::endl;
+
+		std::ofstream ofs(json_path);
+		if (!ofs.is_open())
+		{
+			std::cout << "Cannot write benchmark file " << json_path << std::endl;
+			return false;
+		}
+		ofs << os.str();
+		std::cout << "Results written to " << json_path << std::endl;
+		return true;
+	}
+}
@@ -1,3 +1,4 @@
+#include <cassert>
 #include "common.h"
 
 namespace __details{
@@ -100,42 +101,113 @@ static_assert(__details::VerifyDialogIdTable());
 namespace util
 {
 
-uint32_t GetStringEditDistance(const std::string_view& first, const std::string_view& second, uint32_t max_allowed_edits)
+uint32_t GetStringEditDistanceDP(const std::string_view& first, const std::string_view& second, uint32_t max_allowed_edits)
 {
 	uint32_t m = uint32_t(first.length());
 	uint32_t n = uint32_t(second.length());
 	uint32_t s = max_allowed_edits;
 
-	std::vector<uint32_t> T((m + 1) * (n + 1));		// TODO: make this thread_local to avoid multiple memory allocations, or just use alloca()
-	T[0] = 0;
-	for (uint32_t i = 1; i <= std::min(s, n); i++) {
+	if (uint32_t(abs(int32_t(m) - int32_t(n))) > s)
+		return s + 1;
+
+	// only cells within s of the diagonal are computed, everything outside the band stays at s + 1
+	std::vector<uint32_t> T((m + 1) * (n + 1), s + 1);
+	for (uint32_t i = 0; i <= std::min(s, m); i++) {
 		T[i * (n + 1) + 0] = i;
 	}
 
-	for (uint32_t j = 1; j <= std::min(s, m); j++) {
+	for (uint32_t j = 0; j <= std::min(s, n); j++) {
 		T[0 * (n + 1) + j] = j;
 	}
 
 	for (uint32_t i = 1; i <= m; i++) {
-		uint32_t startColumn = std::max(i, s) - s + 1;
-		if (startColumn >= (n + 1))
-			return max_allowed_edits + 1;
+		uint32_t startColumn = std::max(i, s + 1) - s;
 		uint32_t endColumn = std::min(i + s, n);
 		uint32_t minInRow = T[i * (n + 1)];
-		if (i > s)
-			T[i * (n + 1) + startColumn - 1] = max_allowed_edits;
-		if (i + s <= n)
-			T[(i - 1) * (n + 1) + endColumn] = max_allowed_edits;
 		for (uint32_t j = startColumn; j <= endColumn; j++) {
 			uint32_t weight = first[i - 1] == second[j - 1] ? 0 : 1;
 			T[i * (n + 1) + j] = std::min(std::min(T[(i - 1) * (n + 1) + j] + 1, T[i * (n + 1) + j - 1] + 1), T[(i - 1) * (n + 1) + j - 1] + weight);
 			minInRow = std::min(minInRow, T[i * (n + 1) + j]);
 		}
-		if (minInRow > max_allowed_edits)
+		if (minInRow > s)
+			return s + 1;
+	}
+
+	return std::min(T[m * (n + 1) + n], s + 1);
+}
+
+EditDistancePattern::EditDistancePattern(const std::string_view& str)
+	: _str(str)
+	, _num_encoded(uint32_t(std::min<size_t>(str.size(), 64)))
+{
+	_peq.fill(0);
+	for (uint32_t i = 0; i < _num_encoded; i++)
+		_peq[uint8_t(str[i])] |= uint64_t(1) << i;
+}
+
+uint32_t EditDistancePattern::RowDistance(uint32_t row, const std::string_view& text, uint32_t max_allowed_edits) const
+{
+	// Hyyro's formulation of Myers' algorithm. Bit i of pv / mv is set if D[i + 1][j] - D[i][j] is +1 / -1,
+	// where i indexes the pattern and j the text. Carries only propagate towards higher bits, so the pattern chars
+	// after `row` don't affect the score tracked at `row`, which is what makes PrefixDistance() free.
+	uint32_t n = uint32_t(text.size());
+	if (uint32_t(abs(int32_t(row) - int32_t(n))) > max_allowed_edits)
+		return max_allowed_edits + 1;
+	if (row == 0)
+		return n;
+
+	const uint64_t row_bit = uint64_t(1) << (row - 1);
+	uint64_t pv = ~uint64_t(0);
+	uint64_t mv = 0;
+	uint32_t score = row;
+	for (uint32_t j = 0; j < n; j++)
+	{
+		uint64_t eq = _peq[uint8_t(text[j])];
+		uint64_t xv = eq | mv;
+		uint64_t xh = (((eq & pv) + pv) ^ pv) | eq;
+		uint64_t ph = mv | ~(xh | pv);
+		uint64_t mh = pv & xh;
+		if (ph & row_bit)
+			score++;
+		else if (mh & row_bit)
+			score--;
+		ph = (ph << 1) | 1;			// D[0][j] = j, the top row always increases
+		mh <<= 1;
+		pv = mh | ~(xv | ph);
+		mv = ph & xv;
+
+		// each of the remaining chars can lower the score by at most 1
+		if (score > max_allowed_edits + (n - j - 1))
 			return max_allowed_edits + 1;
 	}
 
-	return T[m * (n + 1) + n];
+	return std::min(score, max_allowed_edits + 1);
+}
+
+uint32_t EditDistancePattern::Distance(const std::string_view& text, uint32_t max_allowed_edits) const
+{
+	if (_str.size() > _num_encoded)
+		return GetStringEditDistanceDP(_str, text, max_allowed_edits);
+	return RowDistance(_num_encoded, text, max_allowed_edits);
+}
+
+uint32_t EditDistancePattern::PrefixDistance(const std::string_view& text, uint32_t max_allowed_edits) const
+{
+	if (text.size() > _num_encoded)
+		return GetStringEditDistanceDP(_str.substr(0, text.size()), text, max_allowed_edits);
+	return RowDistance(uint32_t(text.size()), text, max_allowed_edits);
+}
+
+uint32_t GetStringEditDistance(const std::string_view& first, const std::string_view& second, uint32_t max_allowed_edits)
+{
+	// the shorter string goes into the bit vectors
+	const std::string_view& shorter = first.size() <= second.size() ? first : second;
+	const std::string_view& longer = first.size() <= second.size() ? second : first;
+	uint32_t ret = EditDistancePattern(shorter).Distance(longer, max_allowed_edits);
+#ifdef _DEBUG
+	assert(ret == GetStringEditDistanceDP(first, second, max_allowed_edits));
+#endif
+	return ret;
 }
 
 void UnifyAmbiguousChars(std::string& str)
@@ -3,6 +3,8 @@
 #include <memory>
 #include <sstream>
 #include <fstream>
+#include <array>
+#include <span>
 
 #define WIN32_LEAN_AND_MEAN
 #include <windows.h>
@@ -59,6 +61,7 @@
 #endif
 
 #pragma comment(lib, "winmm.lib")
+#pragma comment(lib, "psapi.lib")
 
 enum class EventType : uint8_t
 {
@@ -142,6 +145,37 @@ namespace util
 	 */
 	uint32_t GetStringEditDistance(const std::string_view& first, const std::string_view& second, uint32_t max_allowed_edits);
 
+	/**
+	 * Dynamic-programming version of GetStringEditDistance(), allocates a (m+1)*(n+1) table on each call.
+	 * Kept as the reference the bit-parallel implementation is checked against (--check-matchers), and as the fallback for strings longer than 64 chars.
+	 */
+	uint32_t GetStringEditDistanceDP(const std::string_view& first, const std::string_view& second, uint32_t max_allowed_edits);
+
+	/**
+	 * Bit-parallel (Myers / Hyyro) edit distance against a fixed string, without any heap allocation.
+	 * This is the batched variant: the per-character bit masks are built once per OCR string, then every candidate of a
+	 * table (or every node a BK-tree walk visits) is one Distance() / PrefixDistance() call without any setup.
+	 * Both functions return max_allowed_edits + 1 as soon as the distance is known to be larger than max_allowed_edits.
+	 */
+	class EditDistancePattern
+	{
+	private:
+		std::array<uint64_t, 256> _peq;
+		std::string_view _str;
+		uint32_t _num_encoded;				// only the first 64 chars fit in the bit vectors
+
+	private:
+		uint32_t RowDistance(uint32_t row, const std::string_view& text, uint32_t max_allowed_edits) const;
+
+	public:
+		explicit EditDistancePattern(const std::string_view& str);
+
+		// edit distance between the whole pattern string and text
+		uint32_t Distance(const std::string_view& text, uint32_t max_allowed_edits) const;
+		// edit distance between the pattern string's prefix of text.size() chars and text, text must not be longer than the pattern string
+		uint32_t PrefixDistance(const std::string_view& text, uint32_t max_allowed_edits) const;
+	};
+
 	void UnifyAmbiguousChars(std::string& str);
 
 	/**
@@ -233,5 +233,23 @@ bool LoadRunYaml(RunConfig &run_cfg, std::string run_file)
 
 	}
 
+	return true;
+}
+
+bool ParseBoolOption(const RunConfig& run_cfg, const std::string& key, bool default_value, bool& out_value)
+{
+	out_value = default_value;
+	auto itor = run_cfg.options.find(key);
+	if (itor == run_cfg.options.end())
+		return true;
+	if (itor->second == "true" || itor->second == "1")
+		out_value = true;
+	else if (itor->second == "false" || itor->second == "0")
+		out_value = false;
+	else
+	{
+		std::cout << "run file: invalid " << key << " value '" << itor->second << "'" << std::endl;
+		return false;
+	}
 	return true;
 }
\ No newline at end of file
@@ -32,3 +32,9 @@ struct RunConfig
 };
 
 bool LoadRunYaml(RunConfig& run_cfg, std::string run_file);
+
+/**
+ * Read options[key] as a boolean (true/1 or false/0), out_value is default_value if the option is not set.
+ * Prints the offending value and returns false if it is not a boolean.
+ */
+bool ParseBoolOption(const RunConfig& run_cfg, const std::string& key, bool default_value, bool& out_value);
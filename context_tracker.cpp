@@ -0,0 +1,178 @@
+#include "context_tracker.h"
+#include "detector_registry.h"
+
+namespace
+{
+	constexpr uint32_t LOAD_MAX_BLACK_GAP = 5 * 30;			// a load starts with a loading screen shortly after a black screen
+	constexpr uint32_t LOAD_MAX_CLEAR_FRAMES = 15;			// the loading screen can flicker because of compression errors, but not for that long
+	constexpr uint32_t MEMORY_MIN_ALBUM_GAP = 330;			// same window as EventAssembler uses between the album page and the fade-in white screen
+	constexpr uint32_t MEMORY_MAX_ALBUM_GAP = 360;
+	constexpr uint32_t MEMORY_MAX_FRAMES = 190 * 30;		// longest memory cutscene is about 3 minutes
+
+	// where the location popup can read before and around the Zora monuments
+	constexpr std::string_view zora_locations[] = {
+		"Zora's Domain",
+		"East Reservoir Lake",
+		"Water Reservoir",
+		"Luto's Crossing",
+		"Inogo Bridge",
+		"Oren Bridge",
+		"Lanayru Tower",
+		"Lanayru Promenade",
+		"Lanayru Road - East Gate",
+		"Lanayru Road - West Gate",
+		"Ne'ez Yohma Shrine",
+		"Dako Tah Shrine",
+		"Kaya Wan Shrine",
+		"Sheh Rata Shrine",
+		"Shai Utoh Shrine",
+		"Mo'a Keet Shrine",
+		"Soh Kofi Shrine",
+		"Daka Tuss Shrine",
+		"Rucco Maag Shrine",
+	};
+}
+
+ContextTracker::ContextTracker()
+{
+	Reset();
+}
+
+void ContextTracker::Reset()
+{
+	_mode = Mode::Normal;
+	_mode_start_frame = 0;
+	_location.clear();
+	_last_black_frame = NO_FRAME;
+	_last_album_frame = NO_FRAME;
+	_load_black_seen = false;
+	_load_num_clear_frames = 0;
+	_memory_in_white = false;
+	_memory_num_white_endings = 0;
+}
+
+void ContextTracker::Enter(Mode mode, uint32_t frame_number)
+{
+	_mode = mode;
+	_mode_start_frame = frame_number;
+	if (mode == Mode::Load)
+	{
+		// warped, or entered / left a shrine
+		_location.clear();
+		_load_black_seen = false;
+		_load_num_clear_frames = 0;
+	}
+	else if (mode == Mode::Memory)
+	{
+		_memory_in_white = true;
+		_memory_num_white_endings = 0;
+	}
+}
+
+bool ContextTracker::IsZoraLocation() const
+{
+	if (_location.empty())
+		return true;
+	return std::find(std::begin(zora_locations), std::end(zora_locations), _location) != std::end(zora_locations);
+}
+
+bool ContextTracker::ShouldCheckLocation(uint32_t frame_number) const
+{
+	return _mode != Mode::Load && frame_number % LOCATION_INTERVAL == 0;
+}
+
+void ContextTracker::OnLocation(uint32_t frame_number, const std::string& location)
+{
+	if (location.empty())
+		return;
+
+	_location = location;
+	// the popup only shows up in game
+	if (_mode == Mode::Memory)
+		Enter(Mode::Normal, frame_number);
+}
+
+uint32_t ContextTracker::GetSkipMask(uint32_t frame_number) const
+{
+	uint32_t mask = 0;
+	if (!IsZoraLocation())
+		mask |= 1u << FrameDetectors::index_of<ZoraMonumentDetector>;
+
+	// In a memory every detector still runs once in a while: when the fade-in and fade-out white screens merge (memory
+	// skipped very fast), the second white screen ending is never seen, and a detection on a probe frame ends the memory instead.
+	bool probe = _mode == Mode::Memory && (frame_number - _mode_start_frame) % LOCATION_INTERVAL == 0;
+	if (_mode == Mode::Load || (_mode == Mode::Memory && !probe))
+		mask |= ~(1u << FrameDetectors::index_of<BlackWhiteLoadScreenDetector>);
+
+	return mask;
+}
+
+void ContextTracker::OnFrame(uint32_t frame_number, std::span<const SingleFrameEvent> events)
+{
+	bool black = false, white = false, loading = false, other = false;
+	for (const SingleFrameEvent& e : events)
+	{
+		switch (e.data.type)
+		{
+		case EventType::BlackScreen:
+			black = true;
+			_last_black_frame = frame_number;
+			break;
+		case EventType::WhiteScreen:
+			white = true;
+			break;
+		case EventType::LoadingScreen:
+			loading = true;
+			break;
+		case EventType::AlbumPage:
+			_last_album_frame = frame_number;
+			other = true;
+			break;
+		default:
+			other = true;
+			break;
+		}
+	}
+
+	switch (_mode)
+	{
+	case Mode::Normal:
+		if (loading && _last_black_frame != NO_FRAME && frame_number - _last_black_frame <= LOAD_MAX_BLACK_GAP)
+			Enter(Mode::Load, frame_number);
+		else if (white && _last_album_frame != NO_FRAME
+			&& frame_number - _last_album_frame >= MEMORY_MIN_ALBUM_GAP && frame_number - _last_album_frame <= MEMORY_MAX_ALBUM_GAP)
+			Enter(Mode::Memory, frame_number);
+		break;
+
+	case Mode::Load:
+		if (black)
+		{
+			_load_black_seen = true;
+			_load_num_clear_frames = 0;
+		}
+		else if (loading)
+			_load_num_clear_frames = 0;
+		else if (_load_black_seen || ++_load_num_clear_frames >= LOAD_MAX_CLEAR_FRAMES)
+			Enter(Mode::Normal, frame_number);		// faded back in, or the loading screen was a false positive
+		break;
+
+	case Mode::Memory:
+		if (other || frame_number - _mode_start_frame > MEMORY_MAX_FRAMES)
+		{
+			Enter(Mode::Normal, frame_number);
+			break;
+		}
+		if (_memory_in_white && !white)
+		{
+			// the fade-in white screen ended, the timeout counts from the start of the cutscene
+			if (++_memory_num_white_endings == 2)
+			{
+				Enter(Mode::Normal, frame_number);
+				break;
+			}
+			_mode_start_frame = frame_number;
+		}
+		_memory_in_white = white;
+		break;
+	}
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include <string>
+#include "common.h"
+
+
+/**
+ * Low-rate state of the run, followed by a work thread across contiguous frames: the last location popup seen and
+ * whether the video is inside a load or a memory cutscene. It tells which detectors can possibly fire on the next frame.
+ *   - Load: from a loading screen until the game fades back in, only black/white/load screens can show up
+ *   - Memory: from the fade-in white screen of a memory until its fade-out white screen, same thing
+ *   - Location specific detectors (Zora monuments) only run while the last location seen is near them, or unknown
+ */
+class ContextTracker
+{
+public:
+	static constexpr uint32_t LOCATION_INTERVAL = 30;		// frames between two location checks, and between two full probes in a memory
+
+private:
+	enum class Mode
+	{
+		Normal,
+		Load,
+		Memory,
+	};
+
+	static constexpr uint32_t NO_FRAME = ~uint32_t(0);
+
+	Mode _mode;
+	uint32_t _mode_start_frame;
+	std::string _location;			// empty if unknown
+	uint32_t _last_black_frame;
+	uint32_t _last_album_frame;
+
+	// Load
+	bool _load_black_seen;			// the black screen following the loading screen
+	uint32_t _load_num_clear_frames;
+
+	// Memory
+	bool _memory_in_white;
+	uint32_t _memory_num_white_endings;
+
+private:
+	void Enter(Mode mode, uint32_t frame_number);
+	bool IsZoraLocation() const;
+
+public:
+	ContextTracker();
+
+	// forget everything, e.g. when the next frame isn't contiguous to the last one
+	void Reset();
+
+	bool ShouldCheckLocation(uint32_t frame_number) const;
+	void OnLocation(uint32_t frame_number, const std::string& location);
+
+	// bit i set for every FrameDetectors detector i that can't fire on this frame
+	uint32_t GetSkipMask(uint32_t frame_number) const;
+
+	// events detected on the frame by FrameDetectors::ProcessFrame()
+	void OnFrame(uint32_t frame_number, std::span<const SingleFrameEvent> events);
+};
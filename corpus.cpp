@@ -0,0 +1,272 @@
+#include <atomic>
+#include <fstream>
+#include <mutex>
+#include "corpus.h"
+
+namespace corpus
+{
+	enum class ThreadMode : uint8_t
+	{
+		Off,
+		Record,
+		Replay,
+	};
+
+	static std::atomic<bool> s_enabled = false;
+	static std::filesystem::path s_dir;
+	static uint32_t s_every_nth = 0;
+	static std::mutex s_mutex;			// guards the file, taken once per FLUSH_BYTES of records
+	static std::ofstream s_file;
+	static std::atomic<uint64_t> s_num_records = 0;
+
+	static thread_local ThreadMode t_mode = ThreadMode::Off;
+	static thread_local std::vector<cv::Rect> t_rois;		// disjoint, recording: every ROI read so far, replay: the crops of the current record
+	static thread_local bool t_ocr = false;
+	static thread_local std::vector<uint8_t> t_buffer;
+	static thread_local uint64_t t_uncovered = 0;
+
+	static void Put(std::vector<uint8_t>& buffer, uint32_t value)
+	{
+		const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&value);
+		buffer.insert(buffer.end(), bytes, bytes + sizeof(value));
+	}
+
+	static void PutRect(std::vector<uint8_t>& buffer, const cv::Rect& rect)
+	{
+		Put(buffer, uint32_t(rect.x));
+		Put(buffer, uint32_t(rect.y));
+		Put(buffer, uint32_t(rect.width));
+		Put(buffer, uint32_t(rect.height));
+	}
+
+	static bool Get(std::ifstream& ifs, uint32_t& value)
+	{
+		return bool(ifs.read(reinterpret_cast<char*>(&value), sizeof(value)));
+	}
+
+	static bool GetRect(std::ifstream& ifs, cv::Rect& rect)
+	{
+		uint32_t x, y, width, height;
+		if (!Get(ifs, x) || !Get(ifs, y) || !Get(ifs, width) || !Get(ifs, height))
+			return false;
+		rect = cv::Rect(int(x), int(y), int(width), int(height));
+		return true;
+	}
+
+	static void FlushBuffer()
+	{
+		if (t_buffer.empty())
+			return;
+		std::lock_guard<std::mutex> lock(s_mutex);
+		s_file.write(reinterpret_cast<const char*>(t_buffer.data()), std::streamsize(t_buffer.size()));
+		t_buffer.clear();
+	}
+
+	void Enable(const std::filesystem::path& dir, uint32_t every_nth)
+	{
+		s_dir = dir;
+		s_every_nth = every_nth;
+		s_enabled = true;
+	}
+
+	bool IsEnabled()
+	{
+		return s_enabled;
+	}
+
+	bool BeginVideo(uint32_t video_index)
+	{
+		if (!s_enabled)
+			return true;
+		std::filesystem::path path = s_dir / ("corpus_" + std::to_string(video_index) + ".bin");
+		std::lock_guard<std::mutex> lock(s_mutex);
+		s_file.open(path, std::ios::binary | std::ios::trunc);
+		if (!s_file.is_open())
+		{
+			std::cout << "Cannot write corpus file " << path.string() << std::endl;
+			return false;
+		}
+		std::vector<uint8_t> header;
+		Put(header, FILE_MAGIC);
+		Put(header, FILE_VERSION);
+		s_file.write(reinterpret_cast<const char*>(header.data()), std::streamsize(header.size()));
+		s_num_records = 0;
+		return true;
+	}
+
+	uint64_t EndVideo()
+	{
+		if (!s_enabled)
+			return 0;
+		std::lock_guard<std::mutex> lock(s_mutex);
+		s_file.close();
+		return s_num_records;
+	}
+
+	void BeginThread()
+	{
+		if (!s_enabled)
+			return;
+		t_mode = ThreadMode::Record;
+		t_rois.clear();
+		t_ocr = false;
+	}
+
+	void EndThread()
+	{
+		if (t_mode != ThreadMode::Record)
+			return;
+		FlushBuffer();
+		t_mode = ThreadMode::Off;
+	}
+
+	void OnFrame(uint32_t frame_number, const cv::Mat& img, const cv::Rect& game_rect)
+	{
+		if (t_mode != ThreadMode::Record)
+			return;
+		bool record = t_ocr || (s_every_nth != 0 && frame_number % s_every_nth == 0);
+		t_ocr = false;
+		if (!record)
+			return;
+
+		Put(t_buffer, frame_number);
+		Put(t_buffer, uint32_t(img.cols));
+		Put(t_buffer, uint32_t(img.rows));
+		PutRect(t_buffer, game_rect);
+		Put(t_buffer, uint32_t(t_rois.size()));
+		std::vector<uint8_t> png;
+		for (const cv::Rect& rect : t_rois)
+		{
+			cv::imencode(".png", img(rect), png);
+			PutRect(t_buffer, rect);
+			Put(t_buffer, uint32_t(png.size()));
+			t_buffer.insert(t_buffer.end(), png.begin(), png.end());
+		}
+		s_num_records++;
+		if (t_buffer.size() >= FLUSH_BYTES)
+			FlushBuffer();
+	}
+
+	void OnROI(const cv::Rect& rect)
+	{
+		if (t_mode == ThreadMode::Off)
+			return;
+
+		bool covered = std::any_of(t_rois.begin(), t_rois.end(), [&rect](const cv::Rect& roi) { return (roi & rect) == rect; });
+		if (t_mode == ThreadMode::Replay)
+		{
+			if (!covered)
+				t_uncovered++;
+			return;
+		}
+		if (covered)
+			return;
+
+		// merge with every region it overlaps, which can make the merged region overlap others in turn
+		cv::Rect merged = rect;
+		for (size_t i = 0; i < t_rois.size();)
+		{
+			if ((t_rois[i] & merged).area() > 0)
+			{
+				merged |= t_rois[i];
+				t_rois.erase(t_rois.begin() + i);
+				i = 0;
+			}
+			else
+				i++;
+		}
+		t_rois.push_back(merged);
+	}
+
+	void OnOCR()
+	{
+		t_ocr = true;
+	}
+
+	bool Load(const std::string& filename, std::vector<Record>& out_records)
+	{
+		std::ifstream ifs(filename, std::ios::binary);
+		if (!ifs.is_open())
+		{
+			std::cout << "Cannot open corpus file " << filename << std::endl;
+			return false;
+		}
+		uint32_t magic = 0, version = 0;
+		if (!Get(ifs, magic) || !Get(ifs, version) || magic != FILE_MAGIC || version != FILE_VERSION)
+		{
+			std::cout << filename << " is not a version " << FILE_VERSION << " corpus file" << std::endl;
+			return false;
+		}
+
+		std::vector<uint8_t> png;
+		uint32_t frame_number;
+		while (Get(ifs, frame_number))
+		{
+			Record record = { .frame_number = frame_number };
+			uint32_t width, height, num_crops;
+			if (!Get(ifs, width) || !Get(ifs, height) || !GetRect(ifs, record.game_rect) || !Get(ifs, num_crops))
+			{
+				std::cout << filename << ": record of frame " << frame_number << " is truncated" << std::endl;
+				return false;
+			}
+			record.source_size = cv::Size(int(width), int(height));
+			for (uint32_t i = 0; i < num_crops; i++)
+			{
+				Crop crop;
+				uint32_t png_size;
+				if (!GetRect(ifs, crop.rect) || !Get(ifs, png_size))
+				{
+					std::cout << filename << ": record of frame " << frame_number << " is truncated" << std::endl;
+					return false;
+				}
+				png.resize(png_size);
+				if (!ifs.read(reinterpret_cast<char*>(png.data()), std::streamsize(png_size)))
+				{
+					std::cout << filename << ": record of frame " << frame_number << " is truncated" << std::endl;
+					return false;
+				}
+				crop.img = cv::imdecode(png, cv::IMREAD_COLOR);
+				if (crop.img.size() != crop.rect.size() || (crop.rect & cv::Rect(cv::Point(0, 0), record.source_size)) != crop.rect)
+				{
+					std::cout << filename << ": crop " << i << " of frame " << frame_number << " is invalid" << std::endl;
+					return false;
+				}
+				record.crops.push_back(std::move(crop));
+			}
+			out_records.push_back(std::move(record));
+		}
+		return true;
+	}
+
+	void BeginReplay()
+	{
+		t_mode = ThreadMode::Replay;
+		t_rois.clear();
+		t_uncovered = 0;
+	}
+
+	void ReplayFrame(const Record& record, cv::Mat& io_frame)
+	{
+		if (io_frame.size() != record.source_size || io_frame.type() != CV_8UC3)
+			io_frame = cv::Mat::zeros(record.source_size, CV_8UC3);
+		else
+		{
+			// only the crops of the previous record need clearing
+			for (const cv::Rect& rect : t_rois)
+				io_frame(rect).setTo(cv::Scalar::all(0));
+		}
+		t_rois.clear();
+		for (const Crop& crop : record.crops)
+		{
+			crop.img.copyTo(io_frame(crop.rect));
+			t_rois.push_back(crop.rect);
+		}
+	}
+
+	uint64_t EndReplay()
+	{
+		t_mode = ThreadMode::Off;
+		t_rois.clear();
+		return t_uncovered;
+	}
+}
@@ -0,0 +1,68 @@
+#pragma once
+#include <filesystem>
+#include <string>
+#include <vector>
+#include "common.h"
+
+
+/**
+ * Opt-in ROI corpus: the regions of the frames the detectors actually read, so they can be tuned and benchmarked
+ * without decoding the video again. Every ROI handed out by Detector::BBoxConversion() is remembered per thread
+ * (overlapping ROIs are merged), and a recorded frame stores a lossless crop of each region seen so far. A frame is
+ * recorded when one of its detectors got past its gates to OCR, and every every_nth frame if every_nth isn't 0.
+ * Records of all threads go to one file per video, in no particular order.
+ * Everything is a no-op until Enable() is called.
+ */
+namespace corpus
+{
+	constexpr uint32_t FILE_MAGIC = 0x43494f52;		// "ROIC"
+	constexpr uint32_t FILE_VERSION = 1;
+	// records are buffered per thread and appended to the file once this many bytes are pending
+	constexpr size_t FLUSH_BYTES = 1024 * 1024;
+
+	struct Crop
+	{
+		cv::Rect rect;			// in source frame pixels
+		cv::Mat img;
+	};
+
+	struct Record
+	{
+		uint32_t frame_number;
+		cv::Size source_size;
+		cv::Rect game_rect;
+		std::vector<Crop> crops;
+	};
+
+	// corpus files go to <dir>/corpus_<video index>.bin
+	void Enable(const std::filesystem::path& dir, uint32_t every_nth);
+	bool IsEnabled();
+
+	// open the corpus file of a video, EndVideo() once its work threads are joined. Returns false if it can't be written
+	bool BeginVideo(uint32_t video_index);
+	// number of records written
+	uint64_t EndVideo();
+
+	// Work threads: the ROI and OCR hooks only do something between BeginThread() and EndThread()
+	void BeginThread();
+	void EndThread();
+	// called with the frame the detectors just ran on, records it if it qualifies
+	void OnFrame(uint32_t frame_number, const cv::Mat& img, const cv::Rect& game_rect);
+
+	// called by the detectors
+	void OnROI(const cv::Rect& rect);
+	void OnOCR();
+
+	// Read every record of a corpus file, returns false and prints why if it can't be read
+	bool Load(const std::string& filename, std::vector<Record>& out_records);
+
+	/**
+	 * Replay: build the frame of a record (the crops over a black frame) in io_frame, reusing its buffer across records.
+	 * Until EndReplay(), ROIs read by the detectors on the calling thread that aren't covered by the crops of the current
+	 * record are counted, they show that the detectors changed since the corpus was recorded.
+	 */
+	void BeginReplay();
+	void ReplayFrame(const Record& record, cv::Mat& io_frame);
+	// number of uncovered ROI reads
+	uint64_t EndReplay();
+}
@@ -1,3 +1,4 @@
+#include <numeric>
 #include "deduper.h"
 
 namespace __details
@@ -41,47 +42,175 @@ namespace __details
 
 constexpr std::array<uint32_t, uint32_t(EventType::Max)> minimal_spacing = __details::CreateMinimalSpacingArray();
 
-void EventDeduper::Dedup(const std::multimap<uint32_t, SingleFrameEvent>& events, std::vector<MultiFrameEvent>& out_deduped_events)
+void EventDeduper::MergeRuns(std::span<const std::vector<SingleFrameEvent>> sources, std::vector<SingleFrameEvent>& out_events)
+{
+	struct Run
+	{
+		const SingleFrameEvent* cur;
+		const SingleFrameEvent* end;
+	};
+
+	// split the sources where the frame number goes down
+	std::vector<Run> runs;
+	size_t num_events = 0;
+	for (const std::vector<SingleFrameEvent>& source : sources)
+	{
+		num_events += source.size();
+		size_t run_begin = 0;
+		for (size_t i = 1; i <= source.size(); i++)
+		{
+			if (i == source.size() || source[i].frame_number < source[i - 1].frame_number)
+			{
+				runs.push_back({ .cur = source.data() + run_begin, .end = source.data() + i });
+				run_begin = i;
+			}
+		}
+	}
+
+	out_events.clear();
+	out_events.reserve(num_events);
+	if (runs.size() == 1)
+	{
+		out_events.assign(runs[0].cur, runs[0].end);
+		return;
+	}
+
+	// min heap of the runs by their next frame, the earlier run first for the same frame
+	std::vector<uint32_t> heap(runs.size());
+	std::iota(heap.begin(), heap.end(), 0);
+	auto later = [&runs](uint32_t a, uint32_t b) { return std::tie(runs[a].cur->frame_number, a) > std::tie(runs[b].cur->frame_number, b); };
+	std::make_heap(heap.begin(), heap.end(), later);
+	while (!heap.empty())
+	{
+		std::pop_heap(heap.begin(), heap.end(), later);
+		uint32_t r = heap.back();
+		Run& run = runs[r];
+		// the runs mostly cover disjoint frame ranges, take everything up to the next run in one go
+		uint32_t next = heap.size() > 1 ? heap.front() : r;
+		uint32_t limit_frame = heap.size() > 1 ? runs[next].cur->frame_number : UINT32_MAX;
+		do
+		{
+			out_events.push_back(*run.cur++);
+		} while (run.cur != run.end && (run.cur->frame_number < limit_frame || (run.cur->frame_number == limit_frame && r < next)));
+
+		if (run.cur != run.end)
+			std::push_heap(heap.begin(), heap.end(), later);
+		else
+			heap.pop_back();
+	}
+}
+
+void EventDeduper::ApplyPatches(const std::vector<RunConfig::Video::Patch>& patches, std::vector<SingleFrameEvent>& events, uint32_t& out_num_added, uint32_t& out_num_removed)
+{
+	auto by_frame = [](const SingleFrameEvent& a, const SingleFrameEvent& b) { return a.frame_number < b.frame_number; };
+	// added events are merged in once per stretch of adding patches, after the events already there for the same frame
+	std::vector<SingleFrameEvent> added_events;
+	auto merge_added = [&]() {
+		if (added_events.empty())
+			return;
+		std::stable_sort(added_events.begin(), added_events.end(), by_frame);
+		size_t num_events = events.size();
+		events.insert(events.end(), added_events.begin(), added_events.end());
+		std::inplace_merge(events.begin(), events.begin() + num_events, events.end(), by_frame);
+		added_events.clear();
+	};
+
+	for (const RunConfig::Video::Patch& patch : patches)
+	{
+		if (!patch.remove)
+		{
+			for (uint32_t frame = patch.evt.frame_number; frame <= patch.end_frame; frame++)
+			{
+				SingleFrameEvent evt = patch.evt;
+				evt.frame_number = frame;
+				added_events.push_back(evt);
+				out_num_added++;
+			}
+		}
+		else
+		{
+			merge_added();
+			auto first = std::lower_bound(events.begin(), events.end(), patch.evt.frame_number, [](const SingleFrameEvent& e, uint32_t frame) { return e.frame_number < frame; });
+			auto last = std::upper_bound(first, events.end(), patch.end_frame, [](uint32_t frame, const SingleFrameEvent& e) { return frame < e.frame_number; });
+			auto removed = std::remove_if(first, last, [&patch](const SingleFrameEvent& e) { return e.data == patch.evt.data; });
+			out_num_removed += uint32_t(last - removed);
+			events.erase(removed, last);
+		}
+	}
+	merge_added();
+}
+
+void EventDeduper::Dedup(std::span<const SingleFrameEvent> events, std::vector<MultiFrameEvent>& out_deduped_events)
 {
 	out_deduped_events.clear();
 
-	std::set<MultiFrameEvent> ordered_deduped_events;
+	StreamingDeduper deduper;
+	deduper.Push(events, 0, out_deduped_events);
+	deduper.Finish(out_deduped_events);
+}
 
-	std::array<MultiFrameEvent, uint32_t(EventType::Max)> active_event{};
-	active_event.fill({.duration = 0});
+StreamingDeduper::StreamingDeduper()
+{
+	_active_event.fill({ .duration = 0 });
+}
 
-	for (const auto& e : events)
+void StreamingDeduper::Push(std::span<const SingleFrameEvent> events, uint32_t watermark, std::vector<MultiFrameEvent>& out_deduped_events)
+{
+	for (const SingleFrameEvent& e : events)
 	{
-		auto t = std::to_underlying(e.second.data.type);
-		if (active_event[t].duration == 0)
+		auto t = std::to_underlying(e.data.type);
+		if (_active_event[t].duration == 0)
 		{
-			active_event[t].evt = e.second;
-			active_event[t].duration = 1;
+			_active_event[t].evt = e;
+			_active_event[t].duration = 1;
 		}
 		else
 		{
-			if (active_event[t].evt.frame_number + active_event[t].duration - 1 + minimal_spacing[t] <= e.second.frame_number || active_event[t].evt.data != e.second.data)
+			if (_active_event[t].evt.frame_number + _active_event[t].duration - 1 + minimal_spacing[t] <= e.frame_number || _active_event[t].evt.data != e.data)
 			{
-				ordered_deduped_events.emplace(active_event[t]);
-				active_event[t].evt = e.second;
-				active_event[t].duration = 1;
+				_finished_events.emplace(_active_event[t]);
+				_active_event[t].evt = e;
+				_active_event[t].duration = 1;
 			}
 			else
-				active_event[t].duration = e.second.frame_number - active_event[t].evt.frame_number + 1;
+				_active_event[t].duration = e.frame_number - _active_event[t].evt.frame_number + 1;
 		}
 	}
 
-	for (size_t i = 0; i < active_event.size(); i++)
+	// an active event can't be extended once the watermark is past its spacing, the ones that can still be hold back
+	// every finished event starting at or after them
+	uint32_t first_open_frame = watermark;
+	for (size_t t = 0; t < _active_event.size(); t++)
 	{
-		if (active_event[i].duration != 0)
+		if (_active_event[t].duration == 0)
+			continue;
+		if (_active_event[t].LastFrame() + minimal_spacing[t] <= watermark)
 		{
-			ordered_deduped_events.emplace(active_event[i]);
+			_finished_events.emplace(_active_event[t]);
+			_active_event[t].duration = 0;
 		}
+		else
+			first_open_frame = std::min(first_open_frame, _active_event[t].evt.frame_number);
 	}
+	while (!_finished_events.empty() && _finished_events.begin()->evt.frame_number < first_open_frame)
+	{
+		out_deduped_events.push_back(*_finished_events.begin());
+		_finished_events.erase(_finished_events.begin());
+	}
+}
 
-	out_deduped_events.reserve(ordered_deduped_events.size());
-	for (const MultiFrameEvent& e : ordered_deduped_events)
+void StreamingDeduper::Finish(std::vector<MultiFrameEvent>& out_deduped_events)
+{
+	for (MultiFrameEvent& active : _active_event)
+	{
+		if (active.duration != 0)
+			_finished_events.emplace(active);
+		active.duration = 0;
+	}
+	out_deduped_events.reserve(out_deduped_events.size() + _finished_events.size());
+	for (const MultiFrameEvent& e : _finished_events)
 		out_deduped_events.push_back(e);
+	_finished_events.clear();
 }
 
 std::string EventDeduper::DedupedEventsToYAMLString(std::vector<MultiFrameEvent>& deduped_events)
@@ -1,13 +1,42 @@
 #pragma once
+#include <set>
 #include "common.h"
+#include "config.h"
 
 class EventDeduper
 {
 public:
-	static void Dedup(const std::multimap<uint32_t, SingleFrameEvent>& events, std::vector<MultiFrameEvent>& out_deduped_events);
+	/**
+	 * Merge raw events into one vector sorted by frame. Every source is made of runs sorted by frame, like the events of a
+	 * work thread are per work item; events of the same frame keep the order of the sources
+	 */
+	static void MergeRuns(std::span<const std::vector<SingleFrameEvent>> sources, std::vector<SingleFrameEvent>& out_events);
+	// add the events of the patches adding one for every frame of their range, remove the matching events in the range of the others. events is sorted by frame
+	static void ApplyPatches(const std::vector<RunConfig::Video::Patch>& patches, std::vector<SingleFrameEvent>& events, uint32_t& out_num_added, uint32_t& out_num_removed);
+	// events sorted by frame
+	static void Dedup(std::span<const SingleFrameEvent> events, std::vector<MultiFrameEvent>& out_deduped_events);
 	static std::string DedupedEventsToYAMLString(std::vector<MultiFrameEvent>& deduped_events);
 };
 
+/**
+ * Dedup() over a stream: raw events are pushed in frame order together with a watermark, the frame below which every
+ * raw event has been pushed. Deduped events are handed out as soon as nothing below the watermark can change them, in
+ * the order Dedup() returns them
+ */
+class StreamingDeduper
+{
+private:
+	std::array<MultiFrameEvent, uint32_t(EventType::Max)> _active_event;
+	std::set<MultiFrameEvent> _finished_events;
+
+public:
+	StreamingDeduper();
+	// events sorted by frame and not below the previous watermark, 0 for no watermark
+	void Push(std::span<const SingleFrameEvent> events, uint32_t watermark, std::vector<MultiFrameEvent>& out_deduped_events);
+	// the end of the stream, hands out everything left
+	void Finish(std::vector<MultiFrameEvent>& out_deduped_events);
+};
+
 class EventAssembler
 {
 public:
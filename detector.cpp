@@ -1,37 +1,50 @@
 #include "detector.h"
+#include "perf_counters.h"
+#include "trace.h"
+#include "audit.h"
 
-std::string Detector::OCR(const cv::Mat& input, double scale_factor, uint8_t greyscale_lower, uint8_t greyscale_upper, bool invert_color, tesseract::TessBaseAPI& tess_api, const char* char_whitelist)
+std::string Detector::OCR(const cv::Mat& input, double scale_factor, uint8_t greyscale_lower, uint8_t greyscale_upper, bool invert_color, tesseract::TessBaseAPI& tess_api, const char* char_whitelist,
+	const std::source_location& call_site)
 {
-	cv::Mat bbox_frame;
-	cv::resize(input, bbox_frame, cv::Size(int(input.cols / scale_factor), int(input.rows / scale_factor)));
+	perf::CountOCRCall();
+	corpus::OnOCR();
+	trace::ScopedSpan trace_span("ocr");
 
-	cv::cvtColor(bbox_frame, bbox_frame, cv::COLOR_BGR2GRAY);
-	for (int i = 0; i < bbox_frame.rows; i++)
+	cv::Mat bbox_frame;
+	PIX* pix;
 	{
-		uint8_t lower = greyscale_lower;
-		uint8_t upper = greyscale_upper;
-		uint8_t* data = bbox_frame.row(i).data;
-		for (int j = 0; j < bbox_frame.cols; j++)
-			data[j] = uint8_t(uint32_t(std::clamp(data[j], lower, upper) - lower) * 255 / (upper - lower));
-		if (invert_color)
+		perf::ScopedStage perf_stage(perf::Stage::OCRPreprocess);
+		cv::resize(input, bbox_frame, cv::Size(int(input.cols / scale_factor), int(input.rows / scale_factor)));
+
+		cv::cvtColor(bbox_frame, bbox_frame, cv::COLOR_BGR2GRAY);
+		for (int i = 0; i < bbox_frame.rows; i++)
 		{
+			uint8_t lower = greyscale_lower;
+			uint8_t upper = greyscale_upper;
+			uint8_t* data = bbox_frame.row(i).data;
 			for (int j = 0; j < bbox_frame.cols; j++)
-				data[j] = 255 - data[j];
+				data[j] = uint8_t(uint32_t(std::clamp(data[j], lower, upper) - lower) * 255 / (upper - lower));
+			if (invert_color)
+			{
+				for (int j = 0; j < bbox_frame.cols; j++)
+					data[j] = 255 - data[j];
+			}
 		}
-	}
-	cv::cvtColor(bbox_frame, bbox_frame, cv::COLOR_GRAY2BGRA);
+		cv::cvtColor(bbox_frame, bbox_frame, cv::COLOR_GRAY2BGRA);
 
-	// reorder the channels in each pixel for leptonica
-	util::OpenCvMatBGRAToLeptonicaRGBAInplace(bbox_frame);
+		// reorder the channels in each pixel for leptonica
+		util::OpenCvMatBGRAToLeptonicaRGBAInplace(bbox_frame);
 
-	// construct the PIX struct
-	PIX* pix = pixCreateHeader(bbox_frame.cols, bbox_frame.rows, 32);
-	pixSetDimensions(pix, bbox_frame.cols, bbox_frame.rows, 32);
-	pixSetWpl(pix, bbox_frame.cols);
-	pixSetSpp(pix, 4);
-	pixSetData(pix, (l_uint32*)bbox_frame.data);
+		// construct the PIX struct
+		pix = pixCreateHeader(bbox_frame.cols, bbox_frame.rows, 32);
+		pixSetDimensions(pix, bbox_frame.cols, bbox_frame.rows, 32);
+		pixSetWpl(pix, bbox_frame.cols);
+		pixSetSpp(pix, 4);
+		pixSetData(pix, (l_uint32*)bbox_frame.data);
+	}
 
 	// OCR
+	perf::ScopedStage perf_stage(perf::Stage::OCR);
 	if (!tess_api.SetVariable("tessedit_char_whitelist", char_whitelist))
 		return "";
 
@@ -47,11 +60,16 @@ std::string Detector::OCR(const cv::Mat& input, double scale_factor, uint8_t gre
 	if (ret.size() && ret[ret.size() - 1] == '\n')
 		ret = ret.substr(0, ret.size() - 1);
 
+	if (audit::IsEnabled())
+		audit::OnOCR(call_site, input, ret);
+
 	return ret;
 }
 
 void Detector::GreyscaleAccHistogram(const cv::Mat& img, std::array<uint32_t, 256> &pix_count)
 {
+	perf::ScopedStage perf_stage(perf::Stage::Gate);
+
 	cv::Mat grey_image;
 	cv::cvtColor(img, grey_image, cv::COLOR_BGR2GRAY);		// converting to gray
 
@@ -68,6 +86,8 @@ void Detector::GreyscaleAccHistogram(const cv::Mat& img, std::array<uint32_t, 25
 
 cv::Range Detector::GreyscaleHorizontalClamp(const cv::Mat& img, uint8_t brightness_lower, uint8_t brightness_upper)
 {
+	perf::ScopedStage perf_stage(perf::Stage::Gate);
+
 	cv::Mat grey_image;
 	cv::cvtColor(img, grey_image, cv::COLOR_BGR2GRAY);		// converting to gray
 
@@ -90,6 +110,8 @@ cv::Range Detector::GreyscaleHorizontalClamp(const cv::Mat& img, uint8_t brightn
 
 void Detector::BGRAccHistogram(const cv::Mat& img, std::array<std::array<uint32_t, 256>, 3>& pix_count)
 {
+	perf::ScopedStage perf_stage(perf::Stage::Gate);
+
 	pix_count[0].fill(0);
 	pix_count[1].fill(0);
 	pix_count[2].fill(0);
@@ -111,6 +133,36 @@ void Detector::BGRAccHistogram(const cv::Mat& img, std::array<std::array<uint32_
 	}
 }
 
+void Detector::GreyscaleUniformityTest(const cv::Mat& img, uint8_t dark_upper, uint8_t bright_lower, double max_outlier_ratio, bool& all_dark, bool& all_bright)
+{
+	perf::ScopedStage perf_stage(perf::Stage::Gate);
+
+	constexpr int rows_per_batch = 4;
+	thread_local cv::Mat grey_rows;
+
+	const double area = double(img.rows * img.cols);
+	uint32_t num_not_dark = 0;
+	uint32_t num_not_bright = 0;
+	for (int row = 0; row < img.rows; row += rows_per_batch)
+	{
+		cv::cvtColor(img.rowRange(row, std::min(row + rows_per_batch, img.rows)), grey_rows, cv::COLOR_BGR2GRAY);
+		for (int i = 0; i < grey_rows.rows; i++)
+		{
+			uint8_t* data = grey_rows.row(i).data;
+			for (int j = 0; j < grey_rows.cols; j++)
+			{
+				num_not_dark += data[j] > dark_upper;
+				num_not_bright += data[j] < bright_lower;
+			}
+		}
+		if (num_not_dark / area >= max_outlier_ratio && num_not_bright / area >= max_outlier_ratio)
+			break;
+	}
+
+	all_dark = num_not_dark / area < max_outlier_ratio;
+	all_bright = num_not_bright / area < max_outlier_ratio;
+}
+
 bool Detector::GreyscaleTest(const cv::Mat& img, const std::vector<GreyScaleTestCriteria> &criteria)
 {
 	// scan the image
@@ -128,6 +180,20 @@ bool Detector::GreyscaleTest(const cv::Mat& img, const std::vector<GreyScaleTest
 			return false;
 	}
 
+	if (audit::IsEnabled())
+	{
+		std::ostringstream stats;
+		for (size_t i = 0; i < criteria.size(); i++)
+		{
+			uint32_t num_pixel = count[criteria[i].brightness_range_upper];
+			if (criteria[i].brightness_range_lower > 0)
+				num_pixel -= count[criteria[i].brightness_range_lower - 1];
+			stats << (i ? ", " : "") << '[' << uint32_t(criteria[i].brightness_range_lower) << '-' << uint32_t(criteria[i].brightness_range_upper) << "]: "
+				<< double(num_pixel) / (img.rows * img.cols) << " in [" << criteria[i].pixel_ratio_lower << ", " << criteria[i].pixel_ratio_upper << ']';
+		}
+		audit::OnGatePassed(stats.str());
+	}
+
 	return true;
 }
 
@@ -1,12 +1,21 @@
 #pragma once
 #include <string>
 #include <vector>
+#include <source_location>
 #include "common.h"
+#include "corpus.h"
 
 
 class Detector
 {
 public:
+	// rect in 1280x720 game screen coordinates
+	struct Roi {
+		uint32_t left;
+		uint32_t right;
+		uint32_t top;
+		uint32_t bottom;
+	};
 	struct GreyScaleTestCriteria {
 		uint8_t brightness_range_lower;
 		uint8_t brightness_range_upper;
@@ -18,10 +27,31 @@ public:
 	static void GreyscaleAccHistogram(const cv::Mat& img, std::array<uint32_t, 256> &pix_count);
 	static cv::Range GreyscaleHorizontalClamp(const cv::Mat& img, uint8_t brightness_lower, uint8_t brightness_upper);
 	static void BGRAccHistogram(const cv::Mat& img, std::array<std::array<uint32_t, 256>, 3>& pix_count);
-	static std::string OCR(const cv::Mat& input, double scale_factor, uint8_t greyscale_lower, uint8_t greyscale_upper, bool invert_color, tesseract::TessBaseAPI& tess_api, const char* char_whitelist);
+	// Test whether less than max_outlier_ratio of the pixels are brighter than dark_upper (all_dark) or darker than bright_lower (all_bright).
+	// The image is converted a few rows at a time and the scan stops as soon as neither can be true any more.
+	static void GreyscaleUniformityTest(const cv::Mat& img, uint8_t dark_upper, uint8_t bright_lower, double max_outlier_ratio, bool& all_dark, bool& all_bright);
+	// call_site identifies the caller in the OCR audit
+	static std::string OCR(const cv::Mat& input, double scale_factor, uint8_t greyscale_lower, uint8_t greyscale_upper, bool invert_color, tesseract::TessBaseAPI& tess_api, const char* char_whitelist,
+		const std::source_location& call_site = std::source_location::current());
 
+	// ROI in 1280x720 game screen coordinates to frame pixels, for the detectors reading it
 	template<uint32_t left, uint32_t right, uint32_t top, uint32_t bottom, uint32_t orig_width = 1280, uint32_t orig_height = 720>
 	static cv::Rect BBoxConversion(uint32_t width, uint32_t height, const cv::Rect& rect)
+	{
+		cv::Rect bbox = BBoxRect<left, right, top, bottom, orig_width, orig_height>(width, height, rect);
+		corpus::OnROI(bbox);
+		return bbox;
+	}
+
+	template<Roi roi>
+	static cv::Rect BBoxConversion(uint32_t width, uint32_t height, const cv::Rect& rect)
+	{
+		return BBoxConversion<roi.left, roi.right, roi.top, roi.bottom>(width, height, rect);
+	}
+
+	// same as BBoxConversion() for code that isn't a detector, the ROI isn't reported to the corpus
+	template<uint32_t left, uint32_t right, uint32_t top, uint32_t bottom, uint32_t orig_width = 1280, uint32_t orig_height = 720>
+	static cv::Rect BBoxRect(uint32_t width, uint32_t height, const cv::Rect& rect)
 	{
 		constexpr double bbox_x0 = left / (double)orig_width;
 		constexpr double bbox_x1 = right / (double)orig_width;
@@ -40,4 +70,10 @@ public:
 		}
 		return cv::Rect(bbox_col0 + rect.x, bbox_row0 + rect.y, bbox_col1 - bbox_col0, bbox_row1 - bbox_row0);
 	}
+
+	template<Roi roi>
+	static cv::Rect BBoxRect(uint32_t width, uint32_t height, const cv::Rect& rect)
+	{
+		return BBoxRect<roi.left, roi.right, roi.top, roi.bottom>(width, height, rect);
+	}
 };
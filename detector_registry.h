@@ -0,0 +1,546 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <bitset>
+#include <limits>
+#include <map>
+#include <tuple>
+#include <type_traits>
+#include "common.h"
+#include "config.h"
+#include "perf_counters.h"
+#include "trace.h"
+#include "audit.h"
+#include "item_detector.h"
+#include "tower_activation.h"
+#include "location_detector.h"
+#include "source_hashes.h"
+
+
+/**
+ * Uniform per-frame interface of the detectors run by AnalyseVideo. Each specialization provides
+ *   name:      used for the enable_<name> key in run.yaml's detector_options
+ *   gate_cost: rough number of pixels examined before the detector rejects a regular game frame (at 1280x720)
+ *   excludes:  detectors that can't fire on a frame this one fired on. The relation is made symmetric by the registry
+ *   source_hash: hash of the detector's sources (generated, see gen_source_hashes.ps1), a change invalidates its cached results
+ *   rois:      the ROIs the detector reads, main one first. The fingerprints and the kernel benchmarks are built from them
+ *   Detect:    runs the detector on one frame, returns EventType::None if nothing is detected
+ */
+template<class T>
+struct DetectorTraits;
+
+// not run by a registry, analyse.cpp calls it on its own. Only the name and the ROI
+template<>
+struct DetectorTraits<LocationDetector>
+{
+	static constexpr std::string_view name = "location";
+	static constexpr std::array rois = { LocationDetector::name_roi };
+};
+
+template<>
+struct DetectorTraits<ItemDetector>
+{
+	static constexpr std::string_view name = "item";
+	static constexpr uint64_t source_hash = source_hashes::item_detector;
+	static constexpr uint32_t gate_cost = 4092;		// left third of the item name box
+	static constexpr std::array rois = { ItemDetector::name_roi, ItemDetector::plus_icon_roi };
+	using excludes = std::tuple<>;
+	static SingleFrameEventData Detect(ItemDetector& d, const cv::Mat& img, const cv::Rect& game_rect)
+	{
+		return { .type = d.GetEvent(img, game_rect) };
+	}
+};
+
+template<>
+struct DetectorTraits<TowerActivationDetector>
+{
+	static constexpr std::string_view name = "tower";
+	static constexpr uint64_t source_hash = source_hashes::tower_activation;
+	static constexpr uint32_t gate_cost = 7371;
+	static constexpr std::array rois = { TowerActivationDetector::text_roi };
+	using excludes = std::tuple<>;
+	static SingleFrameEventData Detect(TowerActivationDetector& d, const cv::Mat& img, const cv::Rect& game_rect)
+	{
+		return { .type = d.IsActivatingTower(img, game_rect) ? EventType::TowerActivation : EventType::None };
+	}
+};
+
+template<>
+struct DetectorTraits<TravelDetector>
+{
+	static constexpr std::string_view name = "travel";
+	static constexpr uint64_t source_hash = source_hashes::tower_activation;
+	static constexpr uint32_t gate_cost = 2600;		// left side of the button
+	static constexpr std::array rois = { TravelDetector::button_text_roi, TravelDetector::left_side_roi, TravelDetector::right_side_roi };
+	using excludes = std::tuple<>;
+	static SingleFrameEventData Detect(TravelDetector& d, const cv::Mat& img, const cv::Rect& game_rect)
+	{
+		return { .type = d.IsTravelButtonPresent(img, game_rect) ? EventType::TravelButton : EventType::None };
+	}
+};
+
+template<>
+struct DetectorTraits<BlackWhiteLoadScreenDetector>
+{
+	static constexpr std::string_view name = "black_white_load";
+	static constexpr uint64_t source_hash = source_hashes::tower_activation;
+	static constexpr uint32_t gate_cost = 2400;		// a few rows of the top box
+	static constexpr std::array rois = { BlackWhiteLoadScreenDetector::top_roi, BlackWhiteLoadScreenDetector::bottom_roi };
+	// a black, white or loading screen has no room for any HUD text
+	using excludes = std::tuple<ItemDetector, TowerActivationDetector, TravelDetector, SingleLineDialogDetector, ThreeLineDialogDetector, AlbumPageDetector, ZoraMonumentDetector>;
+	static SingleFrameEventData Detect(BlackWhiteLoadScreenDetector& d, const cv::Mat& img, const cv::Rect& game_rect)
+	{
+		return { .type = d.GetEvent(img, game_rect) };
+	}
+};
+
+template<>
+struct DetectorTraits<SingleLineDialogDetector>
+{
+	static constexpr std::string_view name = "single_line_dialog";
+	static constexpr uint64_t source_hash = source_hashes::tower_activation;
+	static constexpr uint32_t gate_cost = 6800;		// line above the text
+	static constexpr std::array rois = { SingleLineDialogDetector::text_roi, SingleLineDialogDetector::above_roi, SingleLineDialogDetector::below_roi };
+	using excludes = std::tuple<AlbumPageDetector>;
+	static SingleFrameEventData Detect(SingleLineDialogDetector& d, const cv::Mat& img, const cv::Rect& game_rect)
+	{
+		return d.GetEvent(img, game_rect);
+	}
+};
+
+template<>
+struct DetectorTraits<ThreeLineDialogDetector>
+{
+	static constexpr std::string_view name = "three_line_dialog";
+	static constexpr uint64_t source_hash = source_hashes::tower_activation;
+	static constexpr uint32_t gate_cost = 17340;		// lines above the 2-line and 3-line text
+	static constexpr std::array rois = {
+		ThreeLineDialogDetector::line3_text_roi, ThreeLineDialogDetector::line2_text_roi,
+		ThreeLineDialogDetector::line3_above_roi, ThreeLineDialogDetector::line3_below_roi, ThreeLineDialogDetector::line2_above_roi, ThreeLineDialogDetector::line2_below_roi
+	};
+	using excludes = std::tuple<AlbumPageDetector>;
+	static SingleFrameEventData Detect(ThreeLineDialogDetector& d, const cv::Mat& img, const cv::Rect& game_rect)
+	{
+		return d.GetEvent(img, game_rect);
+	}
+};
+
+template<>
+struct DetectorTraits<AlbumPageDetector>
+{
+	static constexpr std::string_view name = "album";
+	static constexpr uint64_t source_hash = source_hashes::tower_activation;
+	static constexpr uint32_t gate_cost = 210;		// L button
+	static constexpr std::array rois = {
+		AlbumPageDetector::title_roi, AlbumPageDetector::l_button_roi, AlbumPageDetector::r_button_roi, AlbumPageDetector::left_side_roi, AlbumPageDetector::right_side_roi
+	};
+	using excludes = std::tuple<>;
+	static SingleFrameEventData Detect(AlbumPageDetector& d, const cv::Mat& img, const cv::Rect& game_rect)
+	{
+		return { .type = d.IsOnAlbumPage(img, game_rect) ? EventType::AlbumPage : EventType::None };
+	}
+};
+
+template<>
+struct DetectorTraits<ZoraMonumentDetector>
+{
+	static constexpr std::string_view name = "zora_monument";
+	static constexpr uint64_t source_hash = source_hashes::tower_activation;
+	static constexpr uint32_t gate_cost = 4500;		// line above the text
+	static constexpr std::array rois = { ZoraMonumentDetector::line1_roi, ZoraMonumentDetector::above_roi, ZoraMonumentDetector::line1_middle_roi };
+	using excludes = std::tuple<>;
+	static SingleFrameEventData Detect(ZoraMonumentDetector& d, const cv::Mat& img, const cv::Rect& game_rect)
+	{
+		uint8_t id = d.GetMonumentID(img, game_rect);
+		if (id < 1 || id > 10)
+			return { .type = EventType::None };
+		return { .type = EventType::ZoraMonument, .monument_data = { .monument_id = id } };
+	}
+};
+
+/**
+ * A fixed set of detectors. Once one of them fires on a frame, the detectors it excludes are skipped for that frame.
+ * They start out in cascade_order (cheapest gate first). Every REORDER_INTERVAL frames the cost and detection rate of
+ * each detector measured by the perf counters of the thread (see perf::ScopedDetector) are folded into running
+ * estimates, and the order with the lowest expected cost per frame is picked. Without bound perf counters the order
+ * stays as it is.
+ */
+template<class... Detectors>
+class DetectorRegistry
+{
+public:
+	static constexpr uint32_t NUM_DETECTORS = uint32_t(sizeof...(Detectors));
+	static constexpr std::array<std::string_view, NUM_DETECTORS> names = { DetectorTraits<Detectors>::name... };
+	static constexpr std::array<uint64_t, NUM_DETECTORS> detector_source_hashes = { DetectorTraits<Detectors>::source_hash... };
+	static constexpr size_t NUM_ROIS = (DetectorTraits<Detectors>::rois.size() + ...);
+	// the rois of all the detectors, in registry order
+	static constexpr std::array<Detector::Roi, NUM_ROIS> rois = [] {
+		std::array<Detector::Roi, NUM_ROIS> all = {};
+		size_t n = 0;
+		((std::ranges::copy(DetectorTraits<Detectors>::rois, all.begin() + n), n += DetectorTraits<Detectors>::rois.size()), ...);
+		return all;
+	}();
+	using EnableFlags = std::bitset<NUM_DETECTORS>;
+
+	static_assert(NUM_DETECTORS <= 16, "exclusion masks are kept in a uint32_t, the order search is exponential in the number of detectors");
+
+	static constexpr uint32_t REORDER_INTERVAL = 60 * 30;
+	static constexpr double STATS_DECAY = 0.5;			// weight of the previous estimates when a new window is folded in
+	static constexpr double MIN_IMPROVEMENT = 0.02;		// relative gain needed to switch to a new order
+
+	using Order = std::array<uint32_t, NUM_DETECTORS>;
+
+	struct OrderReport
+	{
+		Order order;
+		double expected_cost_us;		// 0 until every enabled detector has been measured
+		uint32_t num_reorders;
+	};
+
+private:
+	template<class T>
+	static consteval uint32_t IndexOf()
+	{
+		constexpr bool matches[] = { std::is_same_v<T, Detectors>... };
+		for (uint32_t i = 0; i < NUM_DETECTORS; i++)
+		{
+			if (matches[i])
+				return i;
+		}
+		return NUM_DETECTORS;
+	}
+
+	template<class... Excluded>
+	static consteval uint32_t ExclusionMask(std::tuple<Excluded...>*)
+	{
+		// excluding a detector that's not part of the registry is a no-op
+		return ((IndexOf<Excluded>() < NUM_DETECTORS ? 1u << IndexOf<Excluded>() : 0u) | ... | 0u);
+	}
+
+	static consteval std::array<uint32_t, NUM_DETECTORS> MakeExclusionMasks()
+	{
+		std::array<uint32_t, NUM_DETECTORS> masks = { ExclusionMask((typename DetectorTraits<Detectors>::excludes*)nullptr)... };
+		// if a excludes b, b excludes a as well
+		for (uint32_t a = 0; a < NUM_DETECTORS; a++)
+		{
+			for (uint32_t b = 0; b < NUM_DETECTORS; b++)
+			{
+				if (masks[a] & (1u << b))
+					masks[b] |= 1u << a;
+			}
+		}
+		return masks;
+	}
+
+	static consteval std::array<uint32_t, NUM_DETECTORS> MakeCascadeOrder()
+	{
+		constexpr uint32_t costs[] = { DetectorTraits<Detectors>::gate_cost... };
+		std::array<uint32_t, NUM_DETECTORS> order;
+		for (uint32_t i = 0; i < NUM_DETECTORS; i++)
+			order[i] = i;
+		// insertion sort, stable so that equal costs keep the template argument order
+		for (uint32_t i = 1; i < NUM_DETECTORS; i++)
+		{
+			for (uint32_t j = i; j > 0 && costs[order[j - 1]] > costs[order[j]]; j--)
+				std::swap(order[j - 1], order[j]);
+		}
+		return order;
+	}
+
+public:
+	// exclusion_masks[i] has bit j set if detector j can't fire on a frame detector i fired on
+	static constexpr std::array<uint32_t, NUM_DETECTORS> exclusion_masks = MakeExclusionMasks();
+	// detector indices sorted by gate_cost
+	static constexpr Order cascade_order = MakeCascadeOrder();
+	template<class T>
+	static constexpr uint32_t index_of = IndexOf<T>();
+
+private:
+	struct DetectorStats
+	{
+		// perf counters at the start of the current window
+		uint64_t calls_before = 0;
+		uint64_t ns_before = 0;
+		uint64_t detections_before = 0;
+		// running estimates
+		bool measured = false;
+		double cost_us = 0;
+		double detection_rate = 0;
+	};
+
+	std::tuple<Detectors...> _detectors;
+	uint32_t _disabled_mask;		// detectors turned off in run.yaml
+	Order _order = cascade_order;
+	std::array<DetectorStats, NUM_DETECTORS> _stats;
+	const perf::Counters* _stats_counters = nullptr;		// the perf counters _stats started the window from
+	uint32_t _frames_in_window = 0;
+	double _expected_cost_us = 0;
+	uint32_t _num_reorders = 0;
+
+private:
+	template<size_t I>
+	void RunDetector(const cv::Mat& img, const cv::Rect& game_rect, uint32_t frame_number, uint32_t& skip_mask, std::vector<SingleFrameEvent>& out_events, std::vector<uint8_t>* out_event_detectors)
+	{
+		using T = std::tuple_element_t<I, std::tuple<Detectors...>>;
+		if (skip_mask & (1u << I))
+			return;
+
+		perf::ScopedDetector perf_scope(static_cast<uint32_t>(I));
+		trace::ScopedSpan trace_span(names[I], "frame", frame_number);
+		audit::ScopedDetector audit_scope(names[I], frame_number);
+		SingleFrameEventData data = DetectorTraits<T>::Detect(std::get<I>(_detectors), img, game_rect);
+
+		if (data.type != EventType::None)
+		{
+			perf::ScopedStage perf_stage(perf::Stage::Emission);
+			perf_scope.SetDetected();
+			audit_scope.SetDetected();
+			out_events.push_back({
+				.frame_number = frame_number,
+				.data = data,
+			});
+			if (out_event_detectors)
+				out_event_detectors->push_back(uint8_t(I));
+			skip_mask |= exclusion_masks[I];
+		}
+	}
+
+	// the detectors in the current order, each call dispatched statically
+	template<size_t... I>
+	void RunInOrder(std::index_sequence<I...>, const cv::Mat& img, const cv::Rect& game_rect, uint32_t frame_number, uint32_t& skip_mask, std::vector<SingleFrameEvent>& out_events,
+		std::vector<uint8_t>* out_event_detectors)
+	{
+		for (uint32_t i : _order)
+			((i == I && (RunDetector<I>(img, game_rect, frame_number, skip_mask, out_events, out_event_detectors), true)) || ...);
+	}
+
+	// start a window at the current values of the perf counters
+	void ResetWindow(const perf::Counters* counters)
+	{
+		_stats_counters = counters;
+		for (uint32_t i = 0; i < NUM_DETECTORS; i++)
+		{
+			const perf::DetectorCounters& d = counters->GetDetector(i);
+			_stats[i].calls_before = d.calls;
+			_stats[i].ns_before = d.time.TotalNs();
+			_stats[i].detections_before = d.detections;
+		}
+	}
+
+	/**
+	 * Expected time spent in the detectors per frame when they run in this order. Detector j only runs if none of the
+	 * earlier detectors excluding it fired. Those are assumed not to fire together, so the probability of skipping j
+	 * is the sum of their detection rates.
+	 */
+	double ExpectedCost(const Order& order) const
+	{
+		double cost = 0;
+		uint32_t ran_mask = 0;
+		for (uint32_t j : order)
+		{
+			if (_disabled_mask & (1u << j))
+				continue;
+			cost += _stats[j].cost_us * RunProbability(j, ran_mask);
+			ran_mask |= 1u << j;
+		}
+		return cost;
+	}
+
+	double RunProbability(uint32_t j, uint32_t ran_mask) const
+	{
+		double skip_probability = 0;
+		for (uint32_t i = 0; i < NUM_DETECTORS; i++)
+		{
+			if ((ran_mask & (1u << i)) && (exclusion_masks[i] & (1u << j)))
+				skip_probability += _stats[i].detection_rate;
+		}
+		return 1.0 - std::min(skip_probability, 1.0);
+	}
+
+	/**
+	 * Find the order minimizing ExpectedCost(). The cost of running a detector only depends on the set of detectors run
+	 * before it, not on their order, so this is a DP over subsets of the enabled detectors rather than a permutation search.
+	 */
+	Order FindBestOrder() const
+	{
+		std::vector<uint32_t> enabled;
+		for (uint32_t i : cascade_order)
+		{
+			if (!(_disabled_mask & (1u << i)))
+				enabled.push_back(i);
+		}
+		uint32_t n = uint32_t(enabled.size());
+
+		// best[s] is the lowest cost of running the subset s of enabled first, last[s] the detector run last in that order
+		std::vector<double> best(size_t(1) << n, std::numeric_limits<double>::infinity());
+		std::vector<uint8_t> last(size_t(1) << n, 0);
+		best[0] = 0;
+		for (uint32_t s = 0; s < (1u << n); s++)
+		{
+			uint32_t ran_mask = 0;
+			for (uint32_t k = 0; k < n; k++)
+			{
+				if (s & (1u << k))
+					ran_mask |= 1u << enabled[k];
+			}
+			for (uint32_t k = 0; k < n; k++)
+			{
+				if (s & (1u << k))
+					continue;
+				double cost = best[s] + _stats[enabled[k]].cost_us * RunProbability(enabled[k], ran_mask);
+				if (cost < best[s | (1u << k)])
+				{
+					best[s | (1u << k)] = cost;
+					last[s | (1u << k)] = uint8_t(k);
+				}
+			}
+		}
+
+		Order order;
+		uint32_t pos = 0;
+		for (uint32_t s = (1u << n) - 1; s != 0; s &= ~(1u << last[s]))
+			order[n - 1 - pos++] = enabled[last[s]];
+		// disabled detectors go last, they're never run anyway
+		for (uint32_t i = 0; i < NUM_DETECTORS; i++)
+		{
+			if (_disabled_mask & (1u << i))
+				order[pos++] = i;
+		}
+		return order;
+	}
+
+	void UpdateOrder()
+	{
+		const perf::Counters* counters = perf::GetThreadCounters();
+		if (!counters)
+			return;
+		if (counters != _stats_counters)
+		{
+			// bound since the last window, the counts so far aren't ours
+			ResetWindow(counters);
+			return;
+		}
+
+		bool all_measured = true;
+		for (uint32_t i = 0; i < NUM_DETECTORS; i++)
+		{
+			DetectorStats& stats = _stats[i];
+			const perf::DetectorCounters& d = counters->GetDetector(i);
+			uint64_t window_calls = d.calls - stats.calls_before;
+			if (window_calls > 0)
+			{
+				double cost_us = (d.time.TotalNs() - stats.ns_before) / 1000.0 / window_calls;
+				double detection_rate = double(d.detections - stats.detections_before) / window_calls;
+				if (stats.measured)
+				{
+					stats.cost_us = STATS_DECAY * stats.cost_us + (1.0 - STATS_DECAY) * cost_us;
+					stats.detection_rate = STATS_DECAY * stats.detection_rate + (1.0 - STATS_DECAY) * detection_rate;
+				}
+				else
+				{
+					stats.cost_us = cost_us;
+					stats.detection_rate = detection_rate;
+					stats.measured = true;
+				}
+			}
+			stats.calls_before = d.calls;
+			stats.ns_before = d.time.TotalNs();
+			stats.detections_before = d.detections;
+
+			if (!stats.measured && !(_disabled_mask & (1u << i)))
+				all_measured = false;
+		}
+		if (!all_measured)
+			return;
+
+		_expected_cost_us = ExpectedCost(_order);
+		Order best_order = FindBestOrder();
+		double best_cost = ExpectedCost(best_order);
+		if (best_cost < _expected_cost_us * (1.0 - MIN_IMPROVEMENT))
+		{
+			_order = best_order;
+			_expected_cost_us = best_cost;
+			_num_reorders++;
+		}
+	}
+
+public:
+	DetectorRegistry(tesseract::TessBaseAPI& api, const EnableFlags& enabled)
+		: _detectors(Detectors(api)...)
+		, _disabled_mask(uint32_t(~enabled.to_ulong()))
+	{
+		if (const perf::Counters* counters = perf::GetThreadCounters())
+			ResetWindow(counters);
+	}
+
+	bool Init(const char* lang)
+	{
+		return std::apply([lang](auto&... detectors) { return (detectors.Init(lang) && ...); }, _detectors);
+	}
+
+	/**
+	 * Run the enabled detectors on the frame in the current order, skipping the ones excluded by an earlier detection
+	 * and the ones in context_skip_mask (bit i set to skip detector i).
+	 * If out_event_detectors is set, the index of the detector is appended to it for every event appended to out_events
+	 */
+	void ProcessFrame(const cv::Mat& img, const cv::Rect& game_rect, uint32_t frame_number, uint32_t context_skip_mask, std::vector<SingleFrameEvent>& out_events,
+		std::vector<uint8_t>* out_event_detectors = nullptr)
+	{
+		uint32_t skip_mask = _disabled_mask | context_skip_mask;
+		RunInOrder(std::index_sequence_for<Detectors...>{}, img, game_rect, frame_number, skip_mask, out_events, out_event_detectors);
+
+		if (++_frames_in_window == REORDER_INTERVAL)
+		{
+			UpdateOrder();
+			_frames_in_window = 0;
+		}
+	}
+
+	OrderReport GetOrderReport() const
+	{
+		return { .order = _order, .expected_cost_us = _expected_cost_us, .num_reorders = _num_reorders };
+	}
+
+	// "album > black_white_load > ...", disabled detectors are left out
+	static std::string OrderToString(const Order& order, const EnableFlags& enabled)
+	{
+		std::string str;
+		for (uint32_t i : order)
+		{
+			if (!enabled[i])
+				continue;
+			if (!str.empty())
+				str += " > ";
+			str += names[i];
+		}
+		return str;
+	}
+
+	/**
+	 * Read the enable_<name> options (see ParseBoolOption()), every detector is enabled unless set to false.
+	 * Prints the offending entry and returns false if a value is not a boolean.
+	 */
+	static bool ParseEnableFlags(const RunConfig& run_cfg, EnableFlags& out_enabled)
+	{
+		for (uint32_t i = 0; i < NUM_DETECTORS; i++)
+		{
+			bool enabled;
+			if (!ParseBoolOption(run_cfg, "enable_" + std::string(names[i]), true, enabled))
+				return false;
+			out_enabled[i] = enabled;
+		}
+		return true;
+	}
+};
+
+// Detectors run on every frame by AnalyseVideo
+using FrameDetectors = DetectorRegistry<
+	ItemDetector,
+	TowerActivationDetector,
+	TravelDetector,
+	BlackWhiteLoadScreenDetector,
+	SingleLineDialogDetector,
+	ThreeLineDialogDetector,
+	AlbumPageDetector,
+	ZoraMonumentDetector
+>;
@@ -0,0 +1,312 @@
+#include <algorithm>
+#include <map>
+#include "event_store.h"
+
+// records are stored as they are in memory
+static_assert(sizeof(EventStore::Header) == 64, "EventStore::Header is expected to be a packed 64 byte struct");
+static_assert(sizeof(EventStore::Event) == 20 && std::is_trivially_copyable_v<EventStore::Event>, "EventStore::Event is expected to be a packed 20 byte struct");
+static_assert(sizeof(EventStore::Segment) == 8, "EventStore::Segment is expected to be a packed 8 byte struct");
+
+constexpr uint32_t NUM_TYPES = uint32_t(EventType::Max);
+
+template<typename T>
+static void Append(std::vector<uint8_t>& buffer, std::span<const T> items)
+{
+	const uint8_t* bytes = reinterpret_cast<const uint8_t*>(items.data());
+	buffer.insert(buffer.end(), bytes, bytes + items.size_bytes());
+}
+
+EventStore::~EventStore()
+{
+	Close();
+}
+
+bool EventStore::Write(const std::filesystem::path& path, const std::vector<std::shared_ptr<AssembledEvent>>& events)
+{
+	std::vector<const AssembledEvent*> sorted(events.size());
+	std::transform(events.begin(), events.end(), sorted.begin(), [](const std::shared_ptr<AssembledEvent>& e) { return e.get(); });
+	std::stable_sort(sorted.begin(), sorted.end(), [](const AssembledEvent* a, const AssembledEvent* b) { return *a < *b; });
+
+	std::vector<Event> records;
+	records.reserve(sorted.size());
+	std::vector<Segment> segments;
+	std::string names;
+	std::map<std::string_view, uint32_t> name_offsets;
+	for (const AssembledEvent* e : sorted)
+	{
+		// the virtual accessors aren't const
+		AssembledEvent& event = const_cast<AssembledEvent&>(*e);
+		Event record = { .frame_number = event.evt.frame_number, .duration = event.duration, .data = event.evt.data, .first_segment = uint32_t(segments.size()), .num_segments = 0 };
+		if (event.GetNumSegments() > 1)
+		{
+			record.num_segments = event.GetNumSegments();
+			for (uint32_t i = 0; i < record.num_segments; i++)
+			{
+				std::string_view name = event.GetSegmentName(i);
+				auto [itor, inserted] = name_offsets.emplace(name, uint32_t(names.size()));
+				if (inserted)
+				{
+					names += name;
+					names += '\0';
+				}
+				segments.push_back({ .end_frame_offset = event.GetSegmentEndFrameOffset(i), .name_offset = itor->second });
+			}
+		}
+		records.push_back(record);
+	}
+	return WriteRecords(path, records, segments, names);
+}
+
+bool EventStore::Write(const std::filesystem::path& path, const std::vector<MultiFrameEvent>& events)
+{
+	std::vector<MultiFrameEvent> sorted(events);
+	std::stable_sort(sorted.begin(), sorted.end());
+
+	std::vector<Event> records;
+	records.reserve(sorted.size());
+	for (const MultiFrameEvent& e : sorted)
+		records.push_back({ .frame_number = e.evt.frame_number, .duration = e.duration, .data = e.evt.data, .first_segment = 0, .num_segments = 0 });
+	return WriteRecords(path, records, {}, {});
+}
+
+bool EventStore::WriteRecords(const std::filesystem::path& path, std::span<const Event> records, std::span<const Segment> segments, std::string_view names)
+{
+	std::vector<uint32_t> type_offsets(NUM_TYPES + 1, 0);
+	for (const Event& record : records)
+		type_offsets[uint32_t(record.data.type) + 1]++;
+	for (uint32_t t = 0; t < NUM_TYPES; t++)
+		type_offsets[t + 1] += type_offsets[t];
+	// the events are in frame order, so are the indices of each type
+	std::vector<uint32_t> type_index(records.size());
+	std::vector<uint32_t> type_fill(type_offsets.begin(), type_offsets.end() - 1);
+	for (uint32_t i = 0; i < uint32_t(records.size()); i++)
+		type_index[type_fill[uint32_t(records[i].data.type)]++] = i;
+
+	Header header = {
+		.magic = FILE_MAGIC,
+		.version = FILE_VERSION,
+		.num_events = uint32_t(records.size()),
+		.num_types = NUM_TYPES,
+		.num_segments = uint32_t(segments.size()),
+		.names_size = uint32_t(names.size()),
+	};
+	header.events_offset = sizeof(Header);
+	header.type_offsets_offset = header.events_offset + records.size() * sizeof(Event);
+	header.type_index_offset = header.type_offsets_offset + type_offsets.size() * sizeof(uint32_t);
+	header.segments_offset = header.type_index_offset + type_index.size() * sizeof(uint32_t);
+	header.names_offset = header.segments_offset + segments.size() * sizeof(Segment);
+
+	std::vector<uint8_t> buffer;
+	buffer.reserve(header.names_offset + names.size());
+	Append(buffer, std::span<const Header>(&header, 1));
+	Append(buffer, records);
+	Append(buffer, std::span<const uint32_t>(type_offsets));
+	Append(buffer, std::span<const uint32_t>(type_index));
+	Append(buffer, segments);
+	Append(buffer, std::span<const char>(names));
+
+	std::ofstream ofs(path, std::ios::binary | std::ios::trunc);
+	if (!ofs.is_open() || !ofs.write(reinterpret_cast<const char*>(buffer.data()), std::streamsize(buffer.size())))
+	{
+		std::cout << "Cannot write event store " << path.string() << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool EventStore::Open(const std::filesystem::path& path)
+{
+	Close();
+	HANDLE file = ::CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	LARGE_INTEGER size = {};
+	if (file != INVALID_HANDLE_VALUE && ::GetFileSizeEx(file, &size) && size.QuadPart >= LONGLONG(sizeof(Header)))
+	{
+		_mapping = ::CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (_mapping)
+			_data = static_cast<const uint8_t*>(::MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0));
+		_size = uint64_t(size.QuadPart);
+	}
+	if (file != INVALID_HANDLE_VALUE)
+		::CloseHandle(file);
+	if (!_data)
+	{
+		std::cout << "Cannot map event store " << path.string() << std::endl;
+		Close();
+		return false;
+	}
+
+	// only the header and the tables it points to are checked, the events are read on demand
+	_header = reinterpret_cast<const Header*>(_data);
+	const Header& h = *_header;
+	auto fits = [this](uint64_t offset, uint64_t count, uint64_t item_size) { return offset <= _size && count <= (_size - offset) / item_size; };
+	if (h.magic != FILE_MAGIC || h.version != FILE_VERSION || h.num_types != NUM_TYPES)
+	{
+		std::cout << path.string() << " is not a version " << FILE_VERSION << " event store of this build" << std::endl;
+		Close();
+		return false;
+	}
+	if (!fits(h.events_offset, h.num_events, sizeof(Event)) || !fits(h.type_offsets_offset, NUM_TYPES + 1, sizeof(uint32_t)) || !fits(h.type_index_offset, h.num_events, sizeof(uint32_t))
+		|| !fits(h.segments_offset, h.num_segments, sizeof(Segment)) || !fits(h.names_offset, h.names_size, 1)
+		|| h.events_offset % alignof(Event) != 0 || h.type_offsets_offset % 4 != 0 || h.type_index_offset % 4 != 0 || h.segments_offset % alignof(Segment) != 0
+		|| (h.names_size > 0 && _data[h.names_offset + h.names_size - 1] != '\0'))
+	{
+		std::cout << path.string() << " is truncated or corrupt" << std::endl;
+		Close();
+		return false;
+	}
+	_events = std::span<const Event>(reinterpret_cast<const Event*>(_data + h.events_offset), h.num_events);
+	_type_offsets = std::span<const uint32_t>(reinterpret_cast<const uint32_t*>(_data + h.type_offsets_offset), NUM_TYPES + 1);
+	_type_index = std::span<const uint32_t>(reinterpret_cast<const uint32_t*>(_data + h.type_index_offset), h.num_events);
+	_segments = std::span<const Segment>(reinterpret_cast<const Segment*>(_data + h.segments_offset), h.num_segments);
+	_names = std::string_view(reinterpret_cast<const char*>(_data + h.names_offset), h.names_size);
+	if (_type_offsets[0] != 0 || _type_offsets[NUM_TYPES] != h.num_events || !std::is_sorted(_type_offsets.begin(), _type_offsets.end()))
+	{
+		std::cout << path.string() << " is truncated or corrupt" << std::endl;
+		Close();
+		return false;
+	}
+	return true;
+}
+
+void EventStore::Close()
+{
+	if (_data)
+		::UnmapViewOfFile(_data);
+	if (_mapping)
+		::CloseHandle(_mapping);
+	_data = nullptr;
+	_mapping = nullptr;
+	_size = 0;
+	_header = nullptr;
+	_events = {};
+	_type_offsets = {};
+	_type_index = {};
+	_segments = {};
+	_names = {};
+}
+
+std::span<const EventStore::Event> EventStore::GetEvents(uint32_t frame_start, uint32_t frame_end) const
+{
+	auto first = std::lower_bound(_events.begin(), _events.end(), frame_start, [](const Event& e, uint32_t frame) { return e.frame_number < frame; });
+	auto last = std::upper_bound(first, _events.end(), frame_end, [](uint32_t frame, const Event& e) { return frame < e.frame_number; });
+	return std::span<const Event>(first, last);
+}
+
+std::span<const uint32_t> EventStore::GetEventIndices(EventType type, uint32_t frame_start, uint32_t frame_end) const
+{
+	if (uint32_t(type) >= NUM_TYPES)
+		return {};
+	std::span<const uint32_t> indices = _type_index.subspan(_type_offsets[uint32_t(type)], _type_offsets[uint32_t(type) + 1] - _type_offsets[uint32_t(type)]);
+	auto frame_of = [this](uint32_t idx) { return idx < _events.size() ? _events[idx].frame_number : UINT32_MAX; };
+	auto first = std::lower_bound(indices.begin(), indices.end(), frame_start, [&frame_of](uint32_t idx, uint32_t frame) { return frame_of(idx) < frame; });
+	auto last = std::upper_bound(first, indices.end(), frame_end, [&frame_of](uint32_t frame, uint32_t idx) { return frame < frame_of(idx); });
+	return std::span<const uint32_t>(first, last);
+}
+
+static void WriteEventYAML(std::ostream& os, const EventStore& store, const EventStore::Event& e)
+{
+	os << "      - {frame: [" << e.frame_number << ", " << e.LastFrame() << "]";
+	os << ", type: \"" << util::GetEventText(e.data.type) << "\"";
+	switch (e.data.type)
+	{
+	case EventType::ZoraMonument:
+		os << ", id: " << uint32_t(e.data.monument_data.monument_id);
+		break;
+	case EventType::Dialog:
+		os << ", id: \"" << util::DialogIdToString(e.data.dialog_data.dialog_id) << '\"';
+		break;
+	default:
+		break;
+	}
+	std::span<const EventStore::Segment> segments = store.GetSegments(e);
+	if (!segments.empty())
+	{
+		os << ", segments: [";
+		for (size_t i = 0; i < segments.size(); i++)
+		{
+			if (i > 0)
+				os << ", ";
+			os << "[" << segments[i].end_frame_offset + e.frame_number << ", \"" << store.GetSegmentName(segments[i]) << "\"]";
+		}
+		os << ']';
+	}
+	os << "}" << std::endl;
+}
+
+bool QueryEventStores(const std::vector<std::filesystem::path>& paths, const EventQuery& query)
+{
+	std::vector<std::filesystem::path> files;
+	for (const std::filesystem::path& path : paths)
+	{
+		if (!std::filesystem::is_directory(path))
+		{
+			files.push_back(path);
+			continue;
+		}
+		std::vector<std::filesystem::path> dir_files;
+		for (const auto& entry : std::filesystem::directory_iterator(path))
+		{
+			std::string name = entry.path().filename().string();
+			if (entry.is_regular_file() && name.starts_with("events_") && name.ends_with(".bin"))
+				dir_files.push_back(entry.path());
+		}
+		std::sort(dir_files.begin(), dir_files.end());
+		files.insert(files.end(), dir_files.begin(), dir_files.end());
+	}
+
+	std::ostringstream os;
+	os << "---" << std::endl;
+	os << "results:" << std::endl;
+	std::array<uint64_t, NUM_TYPES> total_counts = {};
+	EventStore store;
+	for (const std::filesystem::path& file : files)
+	{
+		if (!store.Open(file))
+		{
+			std::cout << os.str();
+			return false;
+		}
+		os << "  - file: \"" << file.generic_string() << "\"" << std::endl;
+		if (query.count_only)
+		{
+			os << "    counts:" << std::endl;
+			for (uint32_t t = 0; t < NUM_TYPES; t++)
+			{
+				if (query.type != EventType::None && EventType(t) != query.type)
+					continue;
+				uint32_t count = uint32_t(store.GetEventIndices(EventType(t), query.frame_start, query.frame_end).size());
+				total_counts[t] += count;
+				if (count > 0)
+					os << "      \"" << util::GetEventText(EventType(t)) << "\": " << count << std::endl;
+			}
+		}
+		else
+		{
+			os << "    events:" << std::endl;
+			if (query.type == EventType::None)
+			{
+				for (const EventStore::Event& e : store.GetEvents(query.frame_start, query.frame_end))
+					WriteEventYAML(os, store, e);
+			}
+			else
+			{
+				for (uint32_t idx : store.GetEventIndices(query.type, query.frame_start, query.frame_end))
+					WriteEventYAML(os, store, store.GetEvents()[idx]);
+			}
+		}
+		// one file at a time, a query over many runs can return a lot
+		std::cout << os.str();
+		os.str("");
+	}
+	if (query.count_only && files.size() > 1)
+	{
+		os << "total:" << std::endl;
+		for (uint32_t t = 0; t < NUM_TYPES; t++)
+		{
+			if (total_counts[t] > 0)
+				os << "  \"" << util::GetEventText(EventType(t)) << "\": " << total_counts[t] << std::endl;
+		}
+	}
+	std::cout << os.str();
+	return true;
+}
@@ -0,0 +1,113 @@
+#pragma once
+#include <filesystem>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "common.h"
+
+
+/**
+ * Binary file of the events of a video, read through a memory mapping so a query only touches the pages it needs. It
+ * holds either the final (assembled) events, events_<i>.bin, or the deduped ones, deduped_<i>.bin, which have no
+ * segments. Layout, all offsets from the start of the file:
+ *   Header
+ *   Event[num_events]				sorted like MultiFrameEvent (by frame, duration, type)
+ *   uint32_t[EventType::Max + 1]	type offsets: the events of type t are type_index[type_offsets[t] .. type_offsets[t + 1])
+ *   uint32_t[num_events]			type_index: event indices grouped by type, by frame within a type
+ *   Segment[num_segments]			segments of the assembled events that have more than one
+ *   char[]							segment names, NUL terminated
+ */
+class EventStore
+{
+public:
+	static constexpr uint32_t FILE_MAGIC = 0x54535645;		// "EVST"
+	static constexpr uint32_t FILE_VERSION = 1;
+
+	struct Header
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint32_t num_events;
+		uint32_t num_types;			// EventType::Max of the writer
+		uint32_t num_segments;
+		uint32_t names_size;
+		uint64_t events_offset;
+		uint64_t type_offsets_offset;
+		uint64_t type_index_offset;
+		uint64_t segments_offset;
+		uint64_t names_offset;
+	};
+
+	struct Event
+	{
+		uint32_t frame_number;
+		uint32_t duration;
+		SingleFrameEventData data;
+		uint32_t first_segment;
+		uint32_t num_segments;		// 0 for a single segment event
+
+		uint32_t LastFrame() const { return frame_number + duration - 1; }
+	};
+
+	struct Segment
+	{
+		uint32_t end_frame_offset;		// from the frame_number of the event
+		uint32_t name_offset;			// into the names
+	};
+
+private:
+	const uint8_t* _data = nullptr;
+	uint64_t _size = 0;
+	HANDLE _mapping = nullptr;		// the file mapping object
+	const Header* _header = nullptr;
+	std::span<const Event> _events;
+	std::span<const uint32_t> _type_offsets;
+	std::span<const uint32_t> _type_index;
+	std::span<const Segment> _segments;
+	std::string_view _names;
+
+private:
+	// computes the type index, records are sorted
+	static bool WriteRecords(const std::filesystem::path& path, std::span<const Event> records, std::span<const Segment> segments, std::string_view names);
+
+public:
+	EventStore() = default;
+	~EventStore();
+	EventStore(const EventStore&) = delete;
+	EventStore& operator=(const EventStore&) = delete;
+
+	// Write the events to path, returns false if the file can't be written
+	static bool Write(const std::filesystem::path& path, const std::vector<std::shared_ptr<AssembledEvent>>& events);
+	static bool Write(const std::filesystem::path& path, const std::vector<MultiFrameEvent>& events);
+
+	// Map a file written by Write(), returns false and prints why if it can't be used
+	bool Open(const std::filesystem::path& path);
+	void Close();
+
+	std::span<const Event> GetEvents() const { return _events; }
+	// events starting within [frame_start, frame_end]
+	std::span<const Event> GetEvents(uint32_t frame_start, uint32_t frame_end) const;
+	// indices of the events of a type starting within [frame_start, frame_end], in frame order
+	std::span<const uint32_t> GetEventIndices(EventType type, uint32_t frame_start, uint32_t frame_end) const;
+	// the accessors of the segments check the bounds, the tables aren't validated by Open()
+	std::span<const Segment> GetSegments(const Event& event) const {
+		if (event.first_segment > _segments.size() || event.num_segments > _segments.size() - event.first_segment)
+			return {};
+		return _segments.subspan(event.first_segment, event.num_segments);
+	}
+	std::string_view GetSegmentName(const Segment& segment) const {
+		return segment.name_offset < _names.size() ? std::string_view(_names.data() + segment.name_offset) : std::string_view();
+	}
+};
+
+struct EventQuery
+{
+	EventType type = EventType::None;		// None for every type
+	uint32_t frame_start = 0;
+	uint32_t frame_end = UINT32_MAX;
+	bool count_only = false;				// events per type instead of the events
+};
+
+// Answer the query over event store files and directories of them (their events_*.bin), printed as YAML
+bool QueryEventStores(const std::vector<std::filesystem::path>& paths, const EventQuery& query);
@@ -0,0 +1,206 @@
+#include <algorithm>
+#include <charconv>
+#include <sstream>
+#include "event_stream.h"
+
+bool EventStream::Open(const std::filesystem::path& path, const std::vector<RunConfig::Video::Patch>& patches)
+{
+	_path = path;
+	_patches = patches;
+	_file.open(path, std::ios::trunc);
+	if (!_file.is_open())
+	{
+		std::cout << "Cannot write event stream " << path.string() << std::endl;
+		return false;
+	}
+	return true;
+}
+
+void EventStream::BeginSegment(uint32_t start_frame)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	_watermark = std::max(_watermark, start_frame);
+}
+
+void EventStream::AddEvents(uint32_t frame_start, uint32_t frame_end, std::span<const SingleFrameEvent> events)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	PendingItem& item = _items[frame_start];
+	item.frame_end = frame_end;
+	item.events.insert(item.events.end(), events.begin(), events.end());
+}
+
+void EventStream::OnItemDone(uint32_t frame_start, uint32_t frame_end, std::span<const SingleFrameEvent> events)
+{
+	std::unique_lock<std::mutex> lock(_mutex);
+	PendingItem& item = _items[frame_start];
+	item.frame_end = frame_end;
+	item.done = true;
+	item.events.insert(item.events.end(), events.begin(), events.end());
+	Drain();
+
+	// one thread at a time writes the output, in the order it was produced, the others carry on with their work items
+	if (_writing || _output.empty())
+		return;
+	_writing = true;
+	while (!_output.empty())
+	{
+		std::string output;
+		output.swap(_output);
+		lock.unlock();
+		_file << output;
+		// complete lines for whoever tails the file
+		_file.flush();
+		lock.lock();
+	}
+	_writing = false;
+}
+
+void EventStream::Drain()
+{
+	uint32_t chunk_start = _watermark;
+	_chunk.clear();
+	while (!_items.empty() && _items.begin()->first == _watermark && _items.begin()->second.done)
+	{
+		auto itor = _items.begin();
+		_chunk.insert(_chunk.end(), itor->second.events.begin(), itor->second.events.end());
+		_watermark = itor->second.frame_end + 1;
+		_items.erase(itor);
+	}
+	if (_watermark == chunk_start)
+		return;
+	EmitChunk(_watermark - 1);
+}
+
+void EventStream::EmitChunk(uint32_t chunk_end)
+{
+	// cached and journaled events of an item come as more than one run
+	std::stable_sort(_chunk.begin(), _chunk.end(), [](const SingleFrameEvent& a, const SingleFrameEvent& b) { return a.frame_number < b.frame_number; });
+	// the patches are applied frame by frame, so to the part within the chunk only. That includes the frames between
+	// the segments, which no work item covers
+	std::vector<RunConfig::Video::Patch> patches;
+	for (const RunConfig::Video::Patch& patch : _patches)
+	{
+		uint32_t first_frame = std::max(patch.evt.frame_number, _patched_to);
+		uint32_t last_frame = std::min(patch.end_frame, chunk_end);
+		if (first_frame > last_frame)
+			continue;
+		RunConfig::Video::Patch& chunk_patch = patches.emplace_back(patch);
+		chunk_patch.evt.frame_number = first_frame;
+		chunk_patch.end_frame = last_frame;
+	}
+	if (!patches.empty())
+		EventDeduper::ApplyPatches(patches, _chunk, _num_added, _num_removed);
+	_patched_to = chunk_end + 1;
+
+	_new_events.clear();
+	_deduper.Push(_chunk, _watermark, _new_events);
+	Output(_new_events);
+}
+
+void EventStream::Output(std::span<const MultiFrameEvent> events)
+{
+	if (events.empty())
+		return;
+	std::ostringstream os;
+	for (const MultiFrameEvent& e : events)
+	{
+		os << "{\"frame\":[" << e.evt.frame_number << "," << e.LastFrame() << "],\"type\":\"" << util::GetEventText(e.evt.data.type) << "\"";
+		switch (e.evt.data.type)
+		{
+		case EventType::ZoraMonument:
+			os << ",\"id\":" << uint32_t(e.evt.data.monument_data.monument_id);
+			break;
+		case EventType::Dialog:
+			os << ",\"id\":\"" << util::DialogIdToString(e.evt.data.dialog_data.dialog_id) << "\"";
+			break;
+		default:
+			break;
+		}
+		os << "}\n";
+	}
+	_output += os.str();
+	_num_events += uint32_t(events.size());
+}
+
+bool EventStream::Finish(uint32_t& out_num_events, uint32_t& out_num_added, uint32_t& out_num_removed)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	if (!_items.empty())
+		std::cout << "!!! " << _path.string() << ": " << _items.size() << " work items never completed, their events are missing" << std::endl;
+	// the patches past the last segment
+	_chunk.clear();
+	EmitChunk(UINT32_MAX - 1);
+	_new_events.clear();
+	_deduper.Finish(_new_events);
+	Output(_new_events);
+	// the work threads are done, so is their writing
+	_file << _output;
+	_output.clear();
+	_file.close();
+
+	out_num_events = _num_events;
+	out_num_added = _num_added;
+	out_num_removed = _num_removed;
+	if (_file.fail())
+	{
+		std::cout << "Cannot write event stream " << _path.string() << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool EventStream::Read(const std::filesystem::path& path, std::vector<MultiFrameEvent>& out_events)
+{
+	std::ifstream ifs(path);
+	if (!ifs.is_open())
+	{
+		std::cout << "Cannot open event stream " << path.string() << std::endl;
+		return false;
+	}
+
+	out_events.clear();
+	std::string line;
+	for (uint32_t line_number = 1; std::getline(ifs, line); line_number++)
+	{
+		// the lines Output() writes, {"frame":[first,last],"type":"<text>"} with an "id" for dialogs and monuments
+		auto parse_number = [&line](size_t pos, uint32_t& out_value) -> size_t {
+			auto [ptr, ec] = std::from_chars(line.data() + pos, line.data() + line.size(), out_value);
+			return ec == std::errc() ? size_t(ptr - line.data()) : std::string::npos;
+		};
+		MultiFrameEvent e = {};
+		uint32_t last_frame = 0;
+		size_t pos = line.find("\"frame\":[");
+		if (pos != std::string::npos)
+			pos = parse_number(pos + 9, e.evt.frame_number);
+		if (pos != std::string::npos && line[pos] == ',')
+			pos = parse_number(pos + 1, last_frame);
+		else
+			pos = std::string::npos;
+		size_t type_pos = line.find("\"type\":\"");
+		size_t type_end = type_pos == std::string::npos ? std::string::npos : line.find('"', type_pos + 8);
+		if (pos == std::string::npos || type_end == std::string::npos || last_frame < e.evt.frame_number)
+		{
+			std::cout << path.string() << ":" << line_number << ": not an event" << std::endl;
+			return false;
+		}
+		e.duration = last_frame - e.evt.frame_number + 1;
+		e.evt.data.type = util::GetEventType(std::string_view(line).substr(type_pos + 8, type_end - type_pos - 8));
+
+		size_t id_pos = line.find("\"id\":", type_end);
+		if (e.evt.data.type == EventType::Dialog && id_pos != std::string::npos && line[id_pos + 5] == '"')
+		{
+			size_t id_end = line.find('"', id_pos + 6);
+			if (id_end != std::string::npos)
+				e.evt.data.dialog_data.dialog_id = util::GetDialogId(std::string_view(line).substr(id_pos + 6, id_end - id_pos - 6));
+		}
+		else if (e.evt.data.type == EventType::ZoraMonument && id_pos != std::string::npos)
+		{
+			uint32_t id = 0;
+			if (parse_number(id_pos + 5, id) != std::string::npos)
+				e.evt.data.monument_data.monument_id = uint8_t(id);
+		}
+		out_events.push_back(e);
+	}
+	return true;
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <span>
+#include <vector>
+#include "common.h"
+#include "config.h"
+#include "deduper.h"
+
+
+/**
+ * In-order emission of the deduped events of a video while it's still being analysed. Work items report their raw
+ * events when they complete; the watermark is the first frame of the first work item that hasn't, everything below
+ * it is patched, pushed through a StreamingDeduper and the finished events are appended to an NDJSON file right away,
+ * outside of the lock by one work thread at a time.
+ * The deduped events aren't kept: once formatted they only exist in the file, Read() loads them back for the YAML
+ * output and EventAssembler after the video. While it is analysed the stream holds the raw events of the work items
+ * completed above the watermark, the deduper's open events (one per event type plus the finished ones a later raw
+ * event could still merge with) and the lines not written yet. With the in_order scheduling policy the first of these
+ * is about one work item per thread. The other policies work as well, but an item that is still being analysed holds
+ * back the raw events of every item completed after it.
+ * The segments have to be analysed in increasing frame order.
+ */
+class EventStream
+{
+private:
+	struct PendingItem
+	{
+		uint32_t frame_end;
+		bool done;
+		std::vector<SingleFrameEvent> events;
+	};
+
+	std::mutex _mutex;
+	std::ofstream _file;
+	std::filesystem::path _path;
+	std::vector<RunConfig::Video::Patch> _patches;
+	StreamingDeduper _deduper;
+	std::map<uint32_t, PendingItem> _items;			// by first frame
+	uint32_t _watermark = 0;
+	uint32_t _patched_to = 0;						// first frame the patches haven't been applied to
+	std::vector<SingleFrameEvent> _chunk;			// raw events of the items the watermark just passed
+	std::vector<MultiFrameEvent> _new_events;
+	uint32_t _num_events = 0;						// deduped events output so far
+	std::string _output;							// NDJSON lines not written yet
+	bool _writing = false;							// a thread is writing _output
+	uint32_t _num_added = 0;
+	uint32_t _num_removed = 0;
+
+private:
+	// with the mutex held
+	void Drain();
+	// patch and dedup _chunk, the raw events up to chunk_end
+	void EmitChunk(uint32_t chunk_end);
+	// append the events to _output
+	void Output(std::span<const MultiFrameEvent> events);
+
+public:
+	// returns false if the file can't be written
+	bool Open(const std::filesystem::path& path, const std::vector<RunConfig::Video::Patch>& patches);
+
+	void BeginSegment(uint32_t start_frame);
+	// raw events of a work item that isn't done yet, e.g. the cached results of some of its detectors
+	void AddEvents(uint32_t frame_start, uint32_t frame_end, std::span<const SingleFrameEvent> events);
+	// Thread safe. The work item is complete, with events its raw events
+	void OnItemDone(uint32_t frame_start, uint32_t frame_end, std::span<const SingleFrameEvent> events);
+
+	// Once every segment is done: write what's left and close the file. Returns false if it couldn't be written
+	bool Finish(uint32_t& out_num_events, uint32_t& out_num_added, uint32_t& out_num_removed);
+
+	// The deduped events of a file written by a stream, in the order they were written. Prints why and returns false if it can't be read
+	static bool Read(const std::filesystem::path& path, std::vector<MultiFrameEvent>& out_events);
+};
@@ -0,0 +1,239 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <mutex>
+#include <utility>
+#include "fingerprint.h"
+#include "detector_registry.h"
+
+namespace fingerprint
+{
+	static_assert(sizeof(Record) == 176, "Record is expected to be a packed 176 byte struct");
+	static_assert(sizeof(Header) == 28, "Header is expected to be a packed 28 byte struct");
+
+	using RoiFunc = cv::Rect(*)(uint32_t width, uint32_t height, const cv::Rect& game_rect);
+
+	// the ROIs of the frame detectors then the location (see DetectorTraits), a change to them needs a new FILE_VERSION
+	static constexpr std::array<Detector::Roi, NUM_ROIS> roi_rects = [] {
+		static_assert(FrameDetectors::NUM_ROIS + DetectorTraits<LocationDetector>::rois.size() == NUM_ROIS, "the ROIs don't fit the records");
+		std::array<Detector::Roi, NUM_ROIS> all = {};
+		std::ranges::copy(DetectorTraits<LocationDetector>::rois, std::ranges::copy(FrameDetectors::rois, all.begin()).out);
+		return all;
+	}();
+
+	template<size_t... I>
+	static constexpr std::array<RoiFunc, NUM_ROIS> MakeRoiFuncs(std::index_sequence<I...>)
+	{
+		return { &Detector::BBoxRect<roi_rects[I]>... };
+	}
+	static constexpr std::array<RoiFunc, NUM_ROIS> rois = MakeRoiFuncs(std::make_index_sequence<NUM_ROIS>());
+
+	static std::atomic<bool> s_enabled = false;
+	static std::mutex s_mutex;			// guards the file, taken once per FLUSH_FRAMES records
+	static std::fstream s_file;
+	static std::atomic<uint64_t> s_num_frames = 0;
+
+	static thread_local bool t_active = false;
+	static thread_local uint32_t t_first_frame = 0;
+	static thread_local std::vector<Record> t_records;		// consecutive frames from t_first_frame
+	static thread_local cv::Mat t_thumb_bgr, t_thumb_grey;
+
+	static void FlushRecords()
+	{
+		if (t_records.empty())
+			return;
+		std::lock_guard<std::mutex> lock(s_mutex);
+		// frames nobody wrote yet read back as zeros, which is an invalid record
+		s_file.seekp(std::streamoff(sizeof(Header)) + std::streamoff(t_first_frame) * std::streamoff(sizeof(Record)));
+		s_file.write(reinterpret_cast<const char*>(t_records.data()), std::streamsize(t_records.size() * sizeof(Record)));
+		s_num_frames += t_records.size();
+		t_records.clear();
+	}
+
+	static uint8_t Luma(const cv::Scalar& bgr)
+	{
+		return uint8_t(std::min(255.0, 0.114 * bgr[0] + 0.587 * bgr[1] + 0.299 * bgr[2] + 0.5));
+	}
+
+	void Enable()
+	{
+		s_enabled = true;
+	}
+
+	bool IsEnabled()
+	{
+		return s_enabled;
+	}
+
+	bool BeginVideo(const std::filesystem::path& video_file, const cv::Rect& game_rect)
+	{
+		if (!s_enabled)
+			return true;
+		std::filesystem::path path = video_file;
+		path += ".fp";
+		Header header = { .magic = FILE_MAGIC, .version = FILE_VERSION, .record_size = uint32_t(sizeof(Record)),
+			.game_rect = { game_rect.x, game_rect.y, game_rect.width, game_rect.height } };
+
+		std::lock_guard<std::mutex> lock(s_mutex);
+		s_num_frames = 0;
+		// a sidecar of the same game rect is extended, the frames analysed again are overwritten
+		Header existing = {};
+		std::ifstream ifs(path, std::ios::binary);
+		bool extend = ifs.read(reinterpret_cast<char*>(&existing), sizeof(existing)) && std::memcmp(&existing, &header, sizeof(header)) == 0;
+		ifs.close();
+		if (extend)
+			s_file.open(path, std::ios::binary | std::ios::in | std::ios::out);
+		else
+		{
+			s_file.open(path, std::ios::binary | std::ios::in | std::ios::out | std::ios::trunc);
+			s_file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		}
+		if (!s_file.is_open() || !s_file.good())
+		{
+			std::cout << "Cannot write fingerprint file " << path.string() << std::endl;
+			s_file.close();
+			return false;
+		}
+		return true;
+	}
+
+	uint64_t EndVideo()
+	{
+		if (!s_enabled)
+			return 0;
+		std::lock_guard<std::mutex> lock(s_mutex);
+		s_file.close();
+		return s_num_frames;
+	}
+
+	void BeginThread()
+	{
+		if (!s_enabled)
+			return;
+		t_active = true;
+		t_records.clear();
+		t_records.reserve(FLUSH_FRAMES);
+	}
+
+	void EndThread()
+	{
+		if (!t_active)
+			return;
+		FlushRecords();
+		t_active = false;
+	}
+
+	void OnFrame(uint32_t frame_number, const cv::Mat& img, const cv::Rect& game_rect)
+	{
+		if (!t_active)
+			return;
+		if (!t_records.empty() && frame_number != t_first_frame + t_records.size())
+			FlushRecords();
+		if (t_records.empty())
+			t_first_frame = frame_number;
+		Compute(img, game_rect, t_records.emplace_back());
+		if (t_records.size() >= FLUSH_FRAMES)
+			FlushRecords();
+	}
+
+	void Compute(const cv::Mat& img, const cv::Rect& game_rect, Record& out_record)
+	{
+		// downscale first, converting 144 pixels is cheaper than converting the frame
+		cv::resize(img(game_rect), t_thumb_bgr, cv::Size(THUMB_WIDTH, THUMB_HEIGHT), 0, 0, cv::INTER_AREA);
+		cv::cvtColor(t_thumb_bgr, t_thumb_grey, cv::COLOR_BGR2GRAY);
+		for (int row = 0; row < THUMB_HEIGHT; row++)
+			std::memcpy(out_record.thumb + row * THUMB_WIDTH, t_thumb_grey.ptr(row), THUMB_WIDTH);
+		for (uint32_t i = 0; i < NUM_ROIS; i++)
+			out_record.roi_means[i] = Luma(cv::mean(img(rois[i](img.cols, img.rows, game_rect))));
+		out_record.valid = 1;
+		std::memset(out_record.reserved, 0, sizeof(out_record.reserved));
+	}
+
+	bool Load(const std::string& filename, Header& out_header, std::vector<Record>& out_records)
+	{
+		std::ifstream ifs(filename, std::ios::binary | std::ios::ate);
+		if (!ifs.is_open())
+		{
+			std::cout << "Cannot open fingerprint file " << filename << std::endl;
+			return false;
+		}
+		uint64_t file_size = uint64_t(ifs.tellg());
+		ifs.seekg(0);
+		if (!ifs.read(reinterpret_cast<char*>(&out_header), sizeof(out_header)) || out_header.magic != FILE_MAGIC || out_header.version != FILE_VERSION
+			|| out_header.record_size != sizeof(Record))
+		{
+			std::cout << filename << " is not a version " << FILE_VERSION << " fingerprint file" << std::endl;
+			return false;
+		}
+		// a record cut short by a crash is left out
+		out_records.resize((file_size - sizeof(Header)) / sizeof(Record));
+		if (!ifs.read(reinterpret_cast<char*>(out_records.data()), std::streamsize(out_records.size() * sizeof(Record))))
+		{
+			std::cout << "Cannot read fingerprint file " << filename << std::endl;
+			return false;
+		}
+		return true;
+	}
+
+	bool Search(const std::string& sidecar_file, const std::string& reference_file, double max_distance, uint32_t margin_frames)
+	{
+		Header header;
+		std::vector<Record> records;
+		if (!Load(sidecar_file, header, records))
+			return false;
+		cv::Mat reference = cv::imread(reference_file, cv::IMREAD_COLOR);
+		if (reference.empty())
+		{
+			std::cout << "Cannot read reference image " << reference_file << std::endl;
+			return false;
+		}
+		// a full frame has the game screen where the video has it, anything else is taken as the game screen itself
+		cv::Rect game_rect(header.game_rect[0], header.game_rect[1], header.game_rect[2], header.game_rect[3]);
+		if ((game_rect & cv::Rect(0, 0, reference.cols, reference.rows)) != game_rect)
+			game_rect = cv::Rect(0, 0, reference.cols, reference.rows);
+		Record query;
+		Compute(reference, game_rect, query);
+
+		auto tbegin = std::chrono::steady_clock::now();
+		uint32_t max_sum = uint32_t(max_distance * SIGNATURE_SIZE);
+		uint32_t num_valid = 0, num_matches = 0;
+		std::vector<std::pair<uint32_t, uint32_t>> segments;
+		for (uint32_t frame = 0; frame < uint32_t(records.size()); frame++)
+		{
+			const Record& record = records[frame];
+			if (!record.valid)
+				continue;
+			num_valid++;
+			const uint8_t* a = record.thumb;
+			const uint8_t* b = query.thumb;
+			uint32_t sum = 0;
+			for (size_t i = 0; i < SIGNATURE_SIZE; i++)
+				sum += uint32_t(std::abs(int(a[i]) - int(b[i])));
+			if (sum > max_sum)
+				continue;
+			num_matches++;
+			uint32_t start = frame > margin_frames ? frame - margin_frames : 0;
+			uint32_t end = std::min(frame + margin_frames, uint32_t(records.size()) - 1);
+			if (!segments.empty() && segments.back().second + 1 >= start)
+				segments.back().second = end;
+			else
+				segments.emplace_back(start, end);
+		}
+		double scan_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - tbegin).count();
+
+		uint64_t num_segment_frames = 0;
+		for (const auto& [start, end] : segments)
+			num_segment_frames += end - start + 1;
+		std::cout << sidecar_file << ": " << num_valid << " fingerprinted frames scanned in " << std::fixed << std::setprecision(1) << scan_seconds * 1000 << " ms ("
+			<< (records.size() * sizeof(Record) / 1e9) / std::max(scan_seconds, 1e-9) << " GB/s)" << std::endl;
+		std::cout << num_matches << " frames within " << max_distance << " of " << reference_file << ", " << segments.size() << " segments covering "
+			<< num_segment_frames << " frames (" << (num_valid > 0 ? 100.0 * num_segment_frames / num_valid : 0) << "% of the fingerprinted frames)" << std::endl;
+		std::cout << "segments:" << std::endl;
+		for (const auto& [start, end] : segments)
+			std::cout << "  - [" << start << ", " << end << "]" << std::endl;
+		return true;
+	}
+}
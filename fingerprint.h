@@ -0,0 +1,67 @@
+#pragma once
+#include <filesystem>
+#include <string>
+#include "common.h"
+
+
+/**
+ * Opt-in per-frame fingerprints: a sidecar next to each video with a tiny signature of every analysed frame, computed
+ * from the frame the detectors just ran on. A signature is a 16x9 luma thumbnail of the game screen plus the mean luma
+ * of each detector ROI, 176 bytes per frame, at a fixed offset by frame number so the work threads can fill it in any
+ * order and later runs can extend it. Search() scans a sidecar for frames that look like a reference frame and turns
+ * them into segments, so a new or retuned detector only has to decode around its candidates.
+ * Everything is a no-op until Enable() is called.
+ */
+namespace fingerprint
+{
+	constexpr uint32_t FILE_MAGIC = 0x52504656;		// "VFPR"
+	constexpr uint32_t FILE_VERSION = 3;
+	constexpr int THUMB_WIDTH = 16;
+	constexpr int THUMB_HEIGHT = 9;
+	constexpr uint32_t NUM_ROIS = 26;
+	// records are buffered per thread and written once this many consecutive frames are pending
+	constexpr uint32_t FLUSH_FRAMES = 1024;
+
+	struct Header
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint32_t record_size;
+		int32_t game_rect[4];		// x, y, width, height
+	};
+
+	struct Record
+	{
+		uint8_t thumb[THUMB_WIDTH * THUMB_HEIGHT];
+		uint8_t roi_means[NUM_ROIS];
+		uint8_t valid;				// 0 for frames that weren't analysed
+		uint8_t reserved[5];
+	};
+	// the compared part of a record, thumbnail and ROI means
+	constexpr size_t SIGNATURE_SIZE = sizeof(Record::thumb) + sizeof(Record::roi_means);
+
+	// sidecars go to <video file>.fp
+	void Enable();
+	bool IsEnabled();
+
+	// open or extend the sidecar of a video, EndVideo() once its work threads are joined. Returns false if it can't be written
+	bool BeginVideo(const std::filesystem::path& video_file, const cv::Rect& game_rect);
+	// number of frames written
+	uint64_t EndVideo();
+
+	// Work threads: OnFrame() only does something between BeginThread() and EndThread()
+	void BeginThread();
+	void EndThread();
+	void OnFrame(uint32_t frame_number, const cv::Mat& img, const cv::Rect& game_rect);
+
+	void Compute(const cv::Mat& img, const cv::Rect& game_rect, Record& out_record);
+	// Read a whole sidecar, returns false and prints why if it can't be read
+	bool Load(const std::string& filename, Header& out_header, std::vector<Record>& out_records);
+
+	/**
+	 * Print the frames of the sidecar whose signature is within max_distance (mean absolute difference in luma levels) of
+	 * the reference image as segments padded by margin_frames. The reference is a frame of the same video, or a capture
+	 * of the game screen only.
+	 */
+	bool Search(const std::string& sidecar_file, const std::string& reference_file, double max_distance, uint32_t margin_frames);
+}
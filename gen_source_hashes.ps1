@@ -0,0 +1,47 @@
+# Writes source_hashes.h, the hashes of the sources the results of each detector depend on. They key the results cache
+# (see ResultCache), so that any change to a detector or to the code shared by all of them invalidates its cached results.
+# The hash of the synthetic video generator names the videos of the end-to-end benchmark, so they are rendered again.
+# Run by the pre-build event of event-detector.vcxproj, the header is only rewritten when a hash changed.
+param([string]$Dir = $PSScriptRoot)
+
+# first 8 bytes of the SHA-256 of the files, line endings normalized so that a checkout with CRLF hashes the same
+function Get-SourceHash([string[]]$Files)
+{
+	$sha = [System.Security.Cryptography.SHA256]::Create()
+	foreach ($file in $Files)
+	{
+		$text = [System.IO.File]::ReadAllText((Join-Path $Dir $file)).Replace("`r`n", "`n")
+		$bytes = [System.Text.Encoding]::UTF8.GetBytes($file + "`n" + $text)
+		$null = $sha.TransformBlock($bytes, 0, $bytes.Length, $null, 0)
+	}
+	$null = $sha.TransformFinalBlock([byte[]]@(), 0, 0)
+	return '0x' + [System.BitConverter]::ToString($sha.Hash, 0, 8).Replace('-', '').ToLower() + 'ull'
+}
+
+# frame preparation, the context tracking, OCR and the helpers every detector uses
+$pipeline = Get-SourceHash @('analyse.cpp', 'common.h', 'common.cpp', 'context_tracker.h', 'context_tracker.cpp', 'detector.h', 'detector.cpp',
+	'detector_registry.h', 'location_detector.h', 'location_detector.cpp', 'prefix_matcher.h', 'prefix_matcher.cpp', 'tess_api.h', 'tess_api.cpp')
+$item_detector = Get-SourceHash @('item_detector.h', 'item_detector.cpp')
+$tower_activation = Get-SourceHash @('tower_activation.h', 'tower_activation.cpp')
+$synthetic_video = Get-SourceHash @('bench_e2e.cpp')
+
+$content = @"
+#pragma once
+#include <cstdint>
+
+// Generated by gen_source_hashes.ps1 before every build, don't edit
+namespace source_hashes
+{
+	constexpr uint64_t pipeline = $pipeline;
+	constexpr uint64_t item_detector = $item_detector;
+	constexpr uint64_t tower_activation = $tower_activation;
+	constexpr uint64_t synthetic_video = $synthetic_video;
+}
+
+"@.Replace("`r`n", "`n")
+
+$path = Join-Path $Dir 'source_hashes.h'
+if (!(Test-Path $path) -or [System.IO.File]::ReadAllText($path) -ne $content)
+{
+	[System.IO.File]::WriteAllText($path, $content)
+}
@@ -0,0 +1,33 @@
+#include "hw_counters.h"
+
+namespace perf
+{
+	std::string_view GetHWCounterName(HWCounter counter)
+	{
+		constexpr std::string_view names[] = {
+			"cycles",
+		};
+		static_assert(std::size(names) == NUM_HW_COUNTERS);
+		return names[uint32_t(counter)];
+	}
+
+	bool HWCounterGroup::Open()
+	{
+		ULONG64 cycles;
+		_available_mask = ::QueryThreadCycleTime(::GetCurrentThread(), &cycles) ? 1u << uint32_t(HWCounter::Cycles) : 0;
+		return _available_mask != 0;
+	}
+
+	bool HWCounterGroup::Read(HWSample& out) const
+	{
+		out.fill(0);
+		if (!_available_mask)
+			return false;
+
+		ULONG64 cycles;
+		if (!::QueryThreadCycleTime(::GetCurrentThread(), &cycles))
+			return false;
+		out[uint32_t(HWCounter::Cycles)] = cycles;
+		return true;
+	}
+}
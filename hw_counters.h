@@ -0,0 +1,40 @@
+#pragma once
+#include <array>
+#include <string_view>
+#include "common.h"
+
+
+namespace perf
+{
+	enum class HWCounter : uint8_t
+	{
+		Cycles,
+		Max,
+	};
+	constexpr uint32_t NUM_HW_COUNTERS = uint32_t(HWCounter::Max);
+
+	std::string_view GetHWCounterName(HWCounter counter);
+
+	using HWSample = std::array<uint64_t, NUM_HW_COUNTERS>;
+
+	/**
+	 * Hardware counters of the calling thread. Only the cycles are provided, from QueryThreadCycleTime: instructions,
+	 * cache and branch misses need a kernel driver (or ETW PMU sampling with admin rights) on Windows.
+	 */
+	class HWCounterGroup
+	{
+	private:
+		uint32_t _available_mask = 0;		// bit i set if HWCounter(i) is counted
+
+	public:
+		HWCounterGroup() = default;
+		HWCounterGroup(const HWCounterGroup&) = delete;
+		HWCounterGroup& operator=(const HWCounterGroup&) = delete;
+
+		// must be called on the thread to count, returns false if no counter is available
+		bool Open();
+
+		uint32_t GetAvailableMask() const { return _available_mask; }
+		bool Read(HWSample& out) const;
+	};
+}
@@ -1,5 +1,6 @@
 #include "item_detector.h"
 #include "detector.h"
+#include "perf_counters.h"
 
 ItemDetector::ItemDetector(tesseract::TessBaseAPI& api)
 	: _tess_api(api)
@@ -24,6 +25,8 @@ static std::vector<std::pair<EventType, std::string_view>> _items= {
 
 EventType ItemDetector::ItemNameToEventType(const std::string& str)
 {
+	perf::ScopedStage perf_stage(perf::Stage::Matching);
+
 	for (const auto& item : _items)
 	{
 		if (item.second == str)
@@ -34,7 +37,7 @@ EventType ItemDetector::ItemNameToEventType(const std::string& str)
 
 EventType ItemDetector::GetEvent(const cv::Mat& img, const cv::Rect & game_rect)
 {
-	cv::Rect rect = Detector::BBoxConversion<528, 900, 264, 297>(img.cols, img.rows, game_rect);
+	cv::Rect rect = Detector::BBoxConversion<name_roi>(img.cols, img.rows, game_rect);
 
 	// Peek the left-most third of the bbox, the items we want to detect are at least this wide
 	cv::Rect rect_test = rect;
@@ -55,7 +58,7 @@ EventType ItemDetector::GetEvent(const cv::Mat& img, const cv::Rect & game_rect)
 	// we want to detect the one from Kohga, which has "Inventory" text and a "+" icon at the lower-right corner of the item popup window
 	if (ret == EventType::ThunderHelm)
 	{
-		cv::Rect plus_icon_rect = Detector::BBoxConversion<893, 910, 409, 426>(img.cols, img.rows, game_rect);
+		cv::Rect plus_icon_rect = Detector::BBoxConversion<plus_icon_roi>(img.cols, img.rows, game_rect);
 		static const std::vector<Detector::GreyScaleTestCriteria> crit = {
 			{.brightness_range_lower = 180, .brightness_range_upper = 255, .pixel_ratio_lower = 0.5, .pixel_ratio_upper = 1},
 		};
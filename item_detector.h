@@ -1,5 +1,6 @@
 #pragma once
 #include "common.h"
+#include "detector.h"
 
 
 class ItemDetector
@@ -11,6 +12,10 @@ private:
 	// Lookup the item list and find the best match for the detected item string
 	EventType ItemNameToEventType(const std::string& str);
 
+public:
+	static constexpr Detector::Roi name_roi = { 528, 900, 264, 297 };
+	static constexpr Detector::Roi plus_icon_roi = { 893, 910, 409, 426 };		// lower-right corner of the item popup
+
 public:
 	ItemDetector(tesseract::TessBaseAPI &api);
 	~ItemDetector() = default;
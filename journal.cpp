@@ -0,0 +1,167 @@
+#include <array>
+#include <io.h>
+#include "journal.h"
+
+// records store the events as they are in memory
+static_assert(sizeof(SingleFrameEvent) == 8 && std::is_trivially_copyable_v<SingleFrameEvent>, "SingleFrameEvent is expected to be a packed 8 byte struct");
+
+static constexpr std::array<uint32_t, 256> MakeCRC32Table()
+{
+	std::array<uint32_t, 256> table{};
+	for (uint32_t i = 0; i < 256; i++)
+	{
+		uint32_t crc = i;
+		for (uint32_t bit = 0; bit < 8; bit++)
+			crc = (crc & 1) ? (crc >> 1) ^ 0xedb88320u : crc >> 1;
+		table[i] = crc;
+	}
+	return table;
+}
+
+static constexpr std::array<uint32_t, 256> crc32_table = MakeCRC32Table();
+
+static uint32_t UpdateCRC32(uint32_t crc, const void* data, size_t size)
+{
+	const uint8_t* bytes = static_cast<const uint8_t*>(data);
+	for (size_t i = 0; i < size; i++)
+		crc = crc32_table[(crc ^ bytes[i]) & 0xff] ^ (crc >> 8);
+	return crc;
+}
+
+static bool Read(FILE* file, void* data, size_t size)
+{
+	return std::fread(data, 1, size, file) == size;
+}
+
+static bool Write(FILE* file, const void* data, size_t size)
+{
+	return std::fwrite(data, 1, size, file) == size;
+}
+
+static FILE* OpenFile(const std::filesystem::path& path, const char* mode)
+{
+	// fopen() is an error with the SDL checks
+	FILE* file = nullptr;
+	return ::fopen_s(&file, path.string().c_str(), mode) == 0 ? file : nullptr;
+}
+
+// flush to the disk, not just to the OS
+static bool Sync(FILE* file)
+{
+	if (std::fflush(file) != 0)
+		return false;
+	return ::_commit(::_fileno(file)) == 0;
+}
+
+EventJournal::~EventJournal()
+{
+	Close();
+}
+
+uint64_t EventJournal::Hash(std::string_view bytes)
+{
+	uint64_t hash = 0xcbf29ce484222325ull;
+	for (char c : bytes)
+	{
+		hash ^= uint8_t(c);
+		hash *= 0x100000001b3ull;
+	}
+	return hash;
+}
+
+bool EventJournal::Open(const std::filesystem::path& path, uint64_t run_key, std::vector<Item>& out_items)
+{
+	Close();
+	_path = path;
+	_write_failed = false;
+
+	// the length up to the last complete record, anything after it is dropped
+	uint64_t valid_size = 0;
+	if (FILE* file = OpenFile(path, "rb"))
+	{
+		uint32_t magic = 0, version = 0;
+		uint64_t key = 0;
+		if (!Read(file, &magic, sizeof(magic)) || !Read(file, &version, sizeof(version)) || !Read(file, &key, sizeof(key))
+			|| magic != FILE_MAGIC || version != FILE_VERSION)
+			std::cout << path.string() << " isn't a version " << FILE_VERSION << " journal, starting over" << std::endl;
+		else if (key != run_key)
+			std::cout << path.string() << " was written with a different configuration, starting over" << std::endl;
+		else
+		{
+			valid_size = sizeof(magic) + sizeof(version) + sizeof(key);
+			while (true)
+			{
+				uint32_t header[4];		// magic, frame_start, frame_end, num_events
+				if (!Read(file, header, sizeof(header)) || header[0] != RECORD_MAGIC || header[1] > header[2])
+					break;
+				Item item = { .frame_start = header[1], .frame_end = header[2] };
+				// a garbage count must not turn into a huge allocation, an item can't have more events than frames times types
+				if (uint64_t(header[3]) > uint64_t(header[2] - header[1] + 1) * uint32_t(EventType::Max))
+					break;
+				item.events.resize(header[3]);
+				uint32_t crc = 0;
+				if (!Read(file, item.events.data(), item.events.size() * sizeof(SingleFrameEvent)) || !Read(file, &crc, sizeof(crc)))
+					break;
+				uint32_t expected_crc = ~UpdateCRC32(UpdateCRC32(~0u, &header[1], 3 * sizeof(uint32_t)), item.events.data(), item.events.size() * sizeof(SingleFrameEvent));
+				if (crc != expected_crc)
+					break;
+				valid_size += sizeof(header) + item.events.size() * sizeof(SingleFrameEvent) + sizeof(crc);
+				out_items.push_back(std::move(item));
+			}
+		}
+		std::fclose(file);
+
+		std::error_code ec;
+		uint64_t file_size = std::filesystem::file_size(path, ec);
+		if (!ec && valid_size > 0 && file_size > valid_size)
+			std::cout << path.string() << ": dropped " << file_size - valid_size << " bytes after the last complete work item" << std::endl;
+	}
+
+	if (valid_size > 0)
+	{
+		std::error_code ec;
+		std::filesystem::resize_file(path, valid_size, ec);
+		if (!ec)
+			_file = OpenFile(path, "ab");
+	}
+	else
+	{
+		_file = OpenFile(path, "wb");
+		if (_file && !(Write(_file, &FILE_MAGIC, sizeof(FILE_MAGIC)) && Write(_file, &FILE_VERSION, sizeof(FILE_VERSION)) && Write(_file, &run_key, sizeof(run_key)) && Sync(_file)))
+		{
+			std::fclose(_file);
+			_file = nullptr;
+		}
+	}
+	if (!_file)
+	{
+		std::cout << "Cannot write journal " << path.string() << std::endl;
+		return false;
+	}
+	return true;
+}
+
+void EventJournal::Close()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	if (_file)
+	{
+		std::fclose(_file);
+		_file = nullptr;
+	}
+}
+
+void EventJournal::Append(uint32_t frame_start, uint32_t frame_end, std::span<const SingleFrameEvent> events)
+{
+	uint32_t header[4] = { RECORD_MAGIC, frame_start, frame_end, uint32_t(events.size()) };
+	uint32_t crc = ~UpdateCRC32(UpdateCRC32(~0u, &header[1], 3 * sizeof(uint32_t)), events.data(), events.size_bytes());
+
+	std::lock_guard<std::mutex> lock(_mutex);
+	if (!_file || _write_failed)
+		return;
+	if (!(Write(_file, header, sizeof(header)) && Write(_file, events.data(), events.size_bytes()) && Write(_file, &crc, sizeof(crc)) && Sync(_file)))
+	{
+		std::cout << "Cannot write journal " << _path.string() << ", the rest of the video isn't journaled" << std::endl;
+		_write_failed = true;
+	}
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include <cstdio>
+#include <filesystem>
+#include <mutex>
+#include <span>
+#include <vector>
+#include "common.h"
+
+
+/**
+ * Append-only journal of the raw events of each completed work item, so a run that died can resume without redoing
+ * them. Every record is one work item: its frame range, its SingleFrameEvents as they are in memory and a CRC32, and
+ * is flushed to disk before Append() returns. A record cut short by a crash fails its checksum and is dropped when the
+ * journal is opened again, together with everything after it.
+ * The file starts with a key of the run configuration (video, game rect, color correction, detectors); a journal
+ * written with a different one is discarded. Changes to the detector code aren't part of the key.
+ */
+class EventJournal
+{
+public:
+	static constexpr uint32_t FILE_MAGIC = 0x4c4a5645;		// "EVJL"
+	static constexpr uint32_t FILE_VERSION = 1;
+	static constexpr uint32_t RECORD_MAGIC = 0x4d455449;	// "ITEM"
+
+	struct Item
+	{
+		uint32_t frame_start;
+		uint32_t frame_end;
+		std::vector<SingleFrameEvent> events;
+	};
+
+private:
+	std::mutex _mutex;
+	FILE* _file = nullptr;
+	std::filesystem::path _path;
+	bool _write_failed = false;
+
+public:
+	EventJournal() = default;
+	~EventJournal();
+	EventJournal(const EventJournal&) = delete;
+	EventJournal& operator=(const EventJournal&) = delete;
+
+	// FNV-1a, for building the run key
+	static uint64_t Hash(std::string_view bytes);
+
+	/**
+	 * Read the items of an existing journal written with the same run_key into out_items, then open it for appending.
+	 * Returns false if the file can't be created or written.
+	 */
+	bool Open(const std::filesystem::path& path, uint64_t run_key, std::vector<Item>& out_items);
+	void Close();
+
+	// Thread safe. A failed write is reported once, the run goes on without the journal
+	void Append(uint32_t frame_start, uint32_t frame_end, std::span<const SingleFrameEvent> events);
+};
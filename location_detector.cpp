@@ -1,5 +1,6 @@
 #include "location_detector.h"
 #include "detector.h"
+#include "perf_counters.h"
 
 // Pre-process the location names to make matching easier
 [[nodiscard]]
@@ -43,24 +44,99 @@ bool LocationDetector::InitLocationList(const char* lang)
 	while (std::getline(ifs, line))
 		_locations.emplace_back(line, PreprocessLocationName(line));
 
+	BuildBKTree();
+
 	return true;
 }
 
+void LocationDetector::BuildBKTree()
+{
+	_bk_tree.clear();
+	_bk_tree.resize(_locations.size());
+	_bk_tree_to_visit.reserve(_locations.size());
+	for (uint32_t i = 1; i < uint32_t(_locations.size()); i++)
+	{
+		const std::string& name = _locations[i].preprocessed_name;
+		util::EditDistancePattern pattern(name);
+		uint32_t node = 0;
+		while (true)
+		{
+			const std::string& node_name = _locations[node].preprocessed_name;
+			uint32_t dist = pattern.Distance(node_name, uint32_t(std::max(name.size(), node_name.size())));
+			auto itor = std::find_if(_bk_tree[node].children.begin(), _bk_tree[node].children.end(), [dist](const auto& c) { return c.first == dist; });
+			if (itor == _bk_tree[node].children.end())
+			{
+				_bk_tree[node].children.emplace_back(dist, i);
+				_bk_tree[node].max_child_dist = std::max(_bk_tree[node].max_child_dist, dist);
+				break;
+			}
+			node = itor->second;
+		}
+	}
+}
+
 std::string LocationDetector::FindBestLocationMatch(const std::string& loc_in)
 {
+	perf::ScopedStage perf_stage(perf::Stage::Matching);
+
+	if (_bk_tree.empty())
+		return "";
+
 	std::string loc_in_preprocessed = PreprocessLocationName(loc_in);
 	uint32_t max_allowed_edits = uint32_t(loc_in_preprocessed.size() / 5);			// allow maximum 1/5 recognition error
 	uint32_t candidate_num_edits = max_allowed_edits + 1;
-	std::string candidate;
-	for (const Location& loc : _locations)
+	uint32_t candidate = uint32_t(_locations.size());
+	util::EditDistancePattern pattern(loc_in_preprocessed);
+
+	// Only names within radius edits of the query can still win, radius shrinks to the candidate's distance once there is
+	// one. By the triangle inequality only children whose distance to the current node is within radius of the query's
+	// distance to that node can hold such a name, the rest of the tree is never visited. So the query's distance only
+	// needs to be exact up to the farthest child plus radius, anything above rules out the node and all its children
+	_bk_tree_to_visit.clear();
+	_bk_tree_to_visit.push_back(0);
+	while (!_bk_tree_to_visit.empty())
 	{
-		if (uint32_t(abs(int32_t(loc.preprocessed_name.size()) - int32_t(loc_in_preprocessed.size()))) > max_allowed_edits)
-			continue;
+		uint32_t node = _bk_tree_to_visit.back();
+		_bk_tree_to_visit.pop_back();
+		const Location& loc = _locations[node];
+		uint32_t radius = std::min(max_allowed_edits, candidate_num_edits);
+		uint32_t num_edits = pattern.Distance(loc.preprocessed_name, _bk_tree[node].max_child_dist + radius);
 
-		uint32_t num_edits = util::GetStringEditDistance(loc.preprocessed_name, loc_in_preprocessed, max_allowed_edits + 1);
-		// prefer shorter names if the editing distance is the same.
+		// prefer shorter names if the editing distance is the same, and earlier entries in the list after that.
 		// This is because Tesseract might incorrectly recognize extra random characters inside the location bbox but after the names.
-		if (num_edits < candidate_num_edits || (num_edits == candidate_num_edits && candidate.size() > loc.name.size()))
+		if (num_edits <= max_allowed_edits)
+		{
+			if (num_edits < candidate_num_edits
+				|| (num_edits == candidate_num_edits && (_locations[candidate].name.size() > loc.name.size() || (_locations[candidate].name.size() == loc.name.size() && candidate > node))))
+			{
+				candidate_num_edits = num_edits;
+				candidate = node;
+			}
+		}
+
+		for (const auto& [dist, child] : _bk_tree[node].children)
+		{
+			if (dist + radius >= num_edits && dist <= num_edits + radius)
+				_bk_tree_to_visit.push_back(child);
+		}
+	}
+
+	if (candidate == uint32_t(_locations.size()))
+		return "";
+	return _locations[candidate].name;
+}
+
+std::string LocationDetector::FindBestLocationMatchLinear(const std::string& loc_in) const
+{
+	std::string loc_in_preprocessed = PreprocessLocationName(loc_in);
+	uint32_t max_allowed_edits = uint32_t(loc_in_preprocessed.size() / 5);
+	uint32_t candidate_num_edits = max_allowed_edits + 1;
+	std::string candidate;
+	util::EditDistancePattern pattern(loc_in_preprocessed);
+	for (const Location& loc : _locations)
+	{
+		uint32_t num_edits = pattern.Distance(loc.preprocessed_name, max_allowed_edits);
+		if (num_edits < candidate_num_edits || (num_edits == candidate_num_edits && num_edits <= max_allowed_edits && candidate.size() > loc.name.size()))
 		{
 			candidate_num_edits = num_edits;
 			candidate = loc.name;
@@ -71,7 +147,7 @@ std::string LocationDetector::FindBestLocationMatch(const std::string& loc_in)
 
 std::string LocationDetector::GetLocation(const cv::Mat& img, const cv::Rect &game_rect)
 {
-	cv::Rect rect = Detector::BBoxConversion<49, 644, 603, 667>(img.cols, img.rows, game_rect);
+	cv::Rect rect = Detector::BBoxConversion<name_roi>(img.cols, img.rows, game_rect);
 
 	// Peek the left-most quarter of the location frame, the shorted location name is "Docks", which is about this wide
 	cv::Rect rect_test = rect;
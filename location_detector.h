@@ -1,4 +1,6 @@
+#pragma once
 #include "common.h"
+#include "detector.h"
 
 
 class LocationDetector
@@ -10,21 +12,36 @@ private:
 		std::string preprocessed_name;
 	};
 
+	// BK-tree over the preprocessed names, node i is _locations[i]
+	struct BKTreeNode
+	{
+		std::vector<std::pair<uint32_t, uint32_t>> children;		// (edit distance to this node, child node index)
+		uint32_t max_child_dist = 0;
+	};
+
 private:
 	tesseract::TessBaseAPI &_tess_api;
 	std::vector<Location> _locations;
+	std::vector<BKTreeNode> _bk_tree;
+	std::vector<uint32_t> _bk_tree_to_visit;		// traversal stack, every node is pushed at most once so it never grows past _locations.size()
 
 private:
 	bool InitLocationList(const char* lang);
+	void BuildBKTree();
 
-	// Lookup the location list and find the best match for the detected location string
-	std::string FindBestLocationMatch(const std::string& loc_in);
+public:
+	static constexpr Detector::Roi name_roi = { 49, 644, 603, 667 };
 
 public:
 	LocationDetector(tesseract::TessBaseAPI& api);
 	~LocationDetector() = default;
 	bool Init(const char* lang);
 
+	// Lookup the location list and find the best match for the detected location string, public for the benchmarks
+	std::string FindBestLocationMatch(const std::string& loc_in);
+	// Same result by scoring every location, the reference for --check-matchers
+	std::string FindBestLocationMatchLinear(const std::string& loc_in) const;
+
 	// returns empty string if nothing is detected
 	std::string GetLocation(const cv::Mat& img, const cv::Rect &game_rect);
 };
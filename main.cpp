@@ -1,3 +1,4 @@
+#include <charconv>
 #include <filesystem>
 #include <thread>
 #include <ranges>
@@ -6,271 +7,161 @@
 #include "yaml-cpp/yaml.h"
 
 #include "common.h"
-#include "location_detector.h"
-#include "item_detector.h"
-#include "tower_activation.h"
+#include "detector_registry.h"
 #include "config.h"
 #include "scheduler.h"
 #include "deduper.h"
+#include "tess_api.h"
+#include "perf_counters.h"
+#include "trace.h"
+#include "audit.h"
+#include "alloc_tracker.h"
+#include "corpus.h"
+#include "fingerprint.h"
+#include "journal.h"
+#include "result_cache.h"
+#include "event_store.h"
+#include "event_stream.h"
+#include "bench.h"
+#include "analyse.h"
 
-class TesseractAPI
+int main(int argc, char* argv[])
 {
-private:
-	tesseract::TessBaseAPI _api;
+	// just in case of non-ansi text in console
+	::SetConsoleOutputCP(CP_UTF8);
 
-public:
-	bool Init(const char* lang)
-	{
-		if (_api.Init(".", lang))
-		{
-			std::cout << "OCRTesseract: Could not initialize tesseract." << std::endl;
-			return false;
-		}
+	// for shorter thread time slices
+	::timeBeginPeriod(1);
 
-		// use single line mode
-		_api.SetPageSegMode(tesseract::PageSegMode::PSM_SINGLE_LINE);
+	// disable sleep mode
+	::SetThreadExecutionState(ES_CONTINUOUS | ES_SYSTEM_REQUIRED);
+
+	if (argc < 2)
+		return 0;
 
-		// limit to these characters
-		if (std::string_view(lang) == "eng")
+	// benchmark modes, <exe> --bench-kernels [result.json]
+	//                  <exe> --bench-e2e [result.json] [num_threads]
+	//                  <exe> --bench-scaling <video> [start_frame] [num_frames] [result.json]
+	//                  <exe> --bench-replay <corpus.bin> [result.json]
+	//                  <exe> --bench-postprocess [result.json] [hours]
+	//                  <exe> --simulate-schedule <schedule.yaml> [max_workers] [result.json]
+	//                  <exe> --fingerprint-search <video.fp> <reference.png> [max_distance] [margin_frames]
+	// check modes,     <exe> --check-alloc-budget <allocs per frame> [work dir]		(Profile build)
+	//                  <exe> --check-matchers
+	// query mode,      <exe> --query <events.bin | run dir>... [--type <event type>] [--from <frame | hh:mm:ss[.ff]>] [--to <frame | hh:mm:ss[.ff]>] [--count]
+	if (std::string_view(argv[1]) == "--bench-kernels")
+		return bench::RunKernels(argc >= 3 ? argv[2] : "bench_kernels.json") ? 0 : 1;
+	if (std::string_view(argv[1]) == "--bench-e2e")
+		return bench::RunEndToEnd(argc >= 3 ? argv[2] : "bench_e2e.json", argc >= 4 ? uint32_t(std::atoi(argv[3])) : 0) ? 0 : 1;
+	if (std::string_view(argv[1]) == "--bench-scaling")
+	{
+		if (argc < 3)
 		{
-			if (!_api.SetVariable("tessedit_char_whitelist", "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz.'- "))
-				return false;
+			std::cout << "Usage: " << argv[0] << " --bench-scaling <video> [start_frame] [num_frames] [result.json]" << std::endl;
+			return 1;
 		}
-		// ignore extra space at the end of the line without any text, doesn't seem to make much difference though
-		if (!_api.SetVariable("gapmap_use_ends", "true"))
-			return false;
-
-		return true;
+		return bench::RunScaling(argv[2], argc >= 4 ? uint32_t(std::atoi(argv[3])) : 0, argc >= 5 ? uint32_t(std::atoi(argv[4])) : 9000,
+			argc >= 6 ? argv[5] : "bench_scaling.json") ? 0 : 1;
 	}
-
-	TesseractAPI() = default;
-	~TesseractAPI()
+	if (std::string_view(argv[1]) == "--bench-replay")
 	{
-		_api.Clear();
+		if (argc < 3)
+		{
+			std::cout << "Usage: " << argv[0] << " --bench-replay <corpus.bin> [result.json]" << std::endl;
+			return 1;
+		}
+		return bench::RunReplay(argv[2], argc >= 4 ? argv[3] : "bench_replay.json") ? 0 : 1;
 	}
-
-	tesseract::TessBaseAPI& API()
+	if (std::string_view(argv[1]) == "--bench-postprocess")
+		return bench::RunPostProcess(argc >= 3 ? argv[2] : "bench_postprocess.json", argc >= 4 ? uint32_t(std::atoi(argv[3])) : 0) ? 0 : 1;
+	if (std::string_view(argv[1]) == "--simulate-schedule")
 	{
-		return _api;
+		if (argc < 3)
+		{
+			std::cout << "Usage: " << argv[0] << " --simulate-schedule <schedule.yaml> [max_workers] [result.json]" << std::endl;
+			return 1;
+		}
+		return bench::RunScheduleSimulation(argv[2], argc >= 4 ? uint32_t(std::atoi(argv[3])) : 0, argc >= 5 ? argv[4] : "bench_schedule.json") ? 0 : 1;
 	}
-};
-
-void AnalyseVideo(const std::string &video_file, cv::Rect game_rect, double color_scale, double color_shift, std::vector<SingleFrameEvent> &outEvents, uint32_t &num_frame_parsed, VideoParserScheduler &scheduler, const ::GROUP_AFFINITY *thread_affinity)
-{
-	::SetThreadGroupAffinity(::GetCurrentThread(), thread_affinity, nullptr);
-
-	std::string lang = "eng";
-
-	TesseractAPI shared_tess_api;
-	if (!shared_tess_api.Init(lang.c_str()))
-		return;
-
-	LocationDetector location_detector(shared_tess_api.API());
-	if (!location_detector.Init(lang.c_str()))
-		return;
-
-	ItemDetector item_detector(shared_tess_api.API());
-	if (!item_detector.Init(lang.c_str()))
-		return;
-
-	TowerActivationDetector tower_detector(shared_tess_api.API());
-	if (!tower_detector.Init(lang.c_str()))
-		return;
-
-	TravelDetector travel_detector(shared_tess_api.API());
-	if (!travel_detector.Init(lang.c_str()))
-		return;
-
-	BlackWhiteLoadScreenDetector bwl_detector(shared_tess_api.API());
-	if (!bwl_detector.Init(lang.c_str()))
-		return;
-
-	AlbumPageDetector album_detector(shared_tess_api.API());
-	if (!album_detector.Init(lang.c_str()))
-		return;
-
-	SingleLineDialogDetector singleline_detector(shared_tess_api.API());
-	if (!singleline_detector.Init(lang.c_str()))
-		return;
-
-	ThreeLineDialogDetector threeline_detector(shared_tess_api.API());
-	if (!threeline_detector.Init(lang.c_str()))
-		return;
-
-	ZoraMonumentDetector zm_detector(shared_tess_api.API());
-	if (!zm_detector.Init(lang.c_str()))
-		return;
-
-	cv::VideoCapture cap(video_file);
-	if (cap.isOpened())
+	if (std::string_view(argv[1]) == "--check-alloc-budget")
 	{
-		double width = cap.get(cv::CAP_PROP_FRAME_WIDTH);
-		double height = cap.get(cv::CAP_PROP_FRAME_HEIGHT);
-		//std::cout << "File: " << video_file << std::endl;
-		//std::cout << "Frame size: " << width << "x" << height << std::endl;
-		double num_frames = uint32_t(cap.get(cv::CAP_PROP_FRAME_COUNT));
-		//std::cout << "Number of frames: " << (int)num_frames << std::endl;
-
-		// Get the frame rate of the video
-		double fps = cap.get(cv::CAP_PROP_FPS);
-		if (fps != 30)
+		double budget = argc >= 3 ? std::atof(argv[2]) : 0;
+		if (budget <= 0)
 		{
-			std::cout << video_file << ": fps != 30" << std::endl;
-			exit(-1);
+			std::cout << "Usage: " << argv[0] << " --check-alloc-budget <allocs per frame> [work dir]" << std::endl;
+			return 1;
 		}
-		//std::cout << "Frame rate: " << fps << std::endl;
-		double duration_sec = num_frames / fps;
-		//std::cout << "Duration: " << duration_sec << " seconds" << std::endl;
-
-		double format = cap.get(cv::CAP_PROP_FORMAT);
-		//std::cout << "Format: " << format << std::endl;
-
-		int work_item = -1;
-		uint32_t frame_start = 0, frame_end = 0;
-
-		while (true)
+		return bench::CheckAllocBudget(budget, argc >= 4 ? argv[3] : ".") ? 0 : 1;
+	}
+	if (std::string_view(argv[1]) == "--check-matchers")
+		return bench::CheckMatchers() ? 0 : 1;
+	if (std::string_view(argv[1]) == "--fingerprint-search")
+	{
+		if (argc < 4)
 		{
-			uint32_t last_frame_end = frame_end;
-			work_item = scheduler.GetNextWorkItem(work_item, frame_start, frame_end);
-			if (work_item < 0)
-				break;
+			std::cout << "Usage: " << argv[0] << " --fingerprint-search <video.fp> <reference.png> [max_distance] [margin_frames]" << std::endl;
+			return 1;
+		}
+		return fingerprint::Search(argv[2], argv[3], argc >= 5 ? std::atof(argv[4]) : 8.0, argc >= 6 ? uint32_t(std::atoi(argv[5])) : 150) ? 0 : 1;
+	}
 
-			if (frame_start >= num_frames || frame_end >= num_frames || frame_start > frame_end)
+	if (std::string_view(argv[1]) == "--query")
+	{
+		// frame number or hh:mm:ss[.ff] as printed by the run
+		auto parse_frame = [](std::string_view s, uint32_t& out_frame) {
+			uint32_t fields[4] = { 0, 0, 0, 0 };		// h, m, s, frame or just the frame
+			const char* ptr = s.data();
+			const char* end = s.data() + s.size();
+			uint32_t num_fields = 0;
+			while (num_fields < 4)
 			{
-				std::cout << "segment [" << frame_start << ", " << frame_end << "] has range issues" << std::endl;
-				exit(-1);
+				auto [next, ec] = std::from_chars(ptr, end, fields[num_fields]);
+				if (ec != std::errc())
+					return false;
+				num_fields++;
+				ptr = next;
+				if (ptr == end)
+					break;
+				if (*ptr != (num_fields < 3 ? ':' : '.'))
+					return false;
+				ptr++;
 			}
-
-			if (frame_start != uint32_t(cap.get(cv::CAP_PROP_POS_FRAMES)))
-				cap.set(cv::CAP_PROP_POS_FRAMES, frame_start);
-
-			for (uint32_t cur_frame = frame_start; cur_frame <= frame_end; cur_frame++)
+			if (ptr != end || num_fields == 2)
+				return false;
+			out_frame = num_fields == 1 ? fields[0] : ((fields[0] * 60 + fields[1]) * 60 + fields[2]) * 30 + fields[3];
+			return true;
+		};
+		std::vector<std::filesystem::path> paths;
+		EventQuery query;
+		for (int arg = 2; arg < argc; arg++)
+		{
+			std::string_view option = argv[arg];
+			bool valid = true;
+			if (option == "--count")
+				query.count_only = true;
+			else if (option == "--type" && arg + 1 < argc)
+				valid = (query.type = util::GetEventType(argv[++arg])) != EventType::None;
+			else if (option == "--from" && arg + 1 < argc)
+				valid = parse_frame(argv[++arg], query.frame_start);
+			else if (option == "--to" && arg + 1 < argc)
+				valid = parse_frame(argv[++arg], query.frame_end);
+			else if (option.starts_with("--"))
+				valid = false;
+			else
+				paths.emplace_back(argv[arg]);
+			if (!valid)
 			{
-				cv::Mat frame;
-				if (!cap.read(frame))
-					break;
-
-				if (color_scale != 1 || color_shift != 0)
-					cv::convertScaleAbs(frame, frame, color_scale, color_shift);
-
-				{
-					EventType type = item_detector.GetEvent(frame, game_rect);
-					if (type != EventType::None)
-					{
-						outEvents.push_back({
-							.frame_number = cur_frame,
-							.data = {
-								.type = type,
-							},
-						});
-					}
-				}
-
-				if (tower_detector.IsActivatingTower(frame, game_rect))
-				{
-					outEvents.push_back({
-						.frame_number = cur_frame,
-						.data = {
-							.type = EventType::TowerActivation,
-						},
-					});
-				}
-
-				if (travel_detector.IsTravelButtonPresent(frame, game_rect))
-				{
-					outEvents.push_back({
-						.frame_number = cur_frame,
-						.data = {
-							.type = EventType::TravelButton,
-						},
-					});
-				}
-
-				{
-					EventType type = bwl_detector.GetEvent(frame, game_rect);
-					if (type != EventType::None)
-					{
-						outEvents.push_back({
-							.frame_number = cur_frame,
-							.data = {
-								.type = type,
-							},
-						});
-					}
-				}
-
-				{
-					SingleFrameEventData evt = singleline_detector.GetEvent(frame, game_rect);
-					if (evt.type != EventType::None)
-					{
-						outEvents.push_back({
-							.frame_number = cur_frame,
-							.data = evt,
-						});
-					}
-				}
-
-				{
-					SingleFrameEventData evt = threeline_detector.GetEvent(frame, game_rect);
-					if (evt.type != EventType::None)
-					{
-						outEvents.push_back({
-							.frame_number = cur_frame,
-							.data = evt,
-						});
-					}
-				}
-
-				if (album_detector.IsOnAlbumPage(frame, game_rect))
-				{
-					outEvents.push_back({
-						.frame_number = cur_frame,
-						.data = {
-							.type = EventType::AlbumPage,
-						},
-					});
-				}
-
-				{
-					uint8_t id = zm_detector.GetMonumentID(frame, game_rect);
-					if (id >= 1 && id <= 10)
-					{
-						outEvents.push_back({
-							.frame_number = cur_frame,
-							.data = {
-								.type = EventType::ZoraMonument,
-								.monument_data = {
-									.monument_id = id,
-								},
-							},
-						});
-					}
-				}
-
-				num_frame_parsed++;
+				std::cout << "Invalid query argument " << argv[arg] << std::endl;
+				return 1;
 			}
 		}
+		if (paths.empty())
+		{
+			std::cout << "Usage: " << argv[0] << " --query <events.bin | run dir>... [--type <event type>] [--from <frame | hh:mm:ss[.ff]>] [--to <frame | hh:mm:ss[.ff]>] [--count]" << std::endl;
+			return 1;
+		}
+		return QueryEventStores(paths, query) ? 0 : 1;
 	}
-	else
-	{
-		std::cout << "Cannot open video file " << video_file << std::endl;
-		exit(-1);
-	}
-}
-
-int main(int argc, char* argv[])
-{
-	// just in case of non-ansi text in console
-	::SetConsoleOutputCP(CP_UTF8);
-
-	// for shorter thread time slices
-	::timeBeginPeriod(1);
-
-	// disable sleep mode
-	::SetThreadExecutionState(ES_CONTINUOUS | ES_SYSTEM_REQUIRED);
-
-	if (argc < 2)
-		return 0;
 
 	namespace fs = std::filesystem;
 	fs::path yaml_path = argv[1];
@@ -290,22 +181,37 @@ int main(int argc, char* argv[])
 
 	if (yaml_file_path.filename().string().starts_with("deduped"))
 	{
-		std::set<MultiFrameEvent> ordered_deduped_events;
-		YAML::Node run_node = YAML::LoadFile(yaml_file_path.string());
-		YAML::Node events_node = run_node["events"];
-		for (std::size_t idx = 0; idx < events_node.size(); idx++)
+		std::vector<MultiFrameEvent> deduped_events;
+		// deduped_<i>.bin is written along with deduped_<i>.yaml, the YAML is only parsed for runs made before
+		fs::path store_path = yaml_file_path;
+		store_path.replace_extension(".bin");
+		if (fs::exists(store_path))
 		{
-			YAML::Node event_node = events_node[idx];
-			MultiFrameEvent e;
-			e.evt.frame_number = event_node[0][0].as<uint32_t>();
-			e.duration = event_node[0][1].as<uint32_t>() - e.evt.frame_number + 1;
-			e.evt.data.type = util::GetEventType(event_node[1].as<std::string>());
-			ordered_deduped_events.emplace(e);
+			EventStore store;
+			if (!store.Open(store_path))
+				return 0;
+			deduped_events.reserve(store.GetEvents().size());
+			for (const EventStore::Event& e : store.GetEvents())
+				deduped_events.push_back({ .evt = { .frame_number = e.frame_number, .data = e.data }, .duration = e.duration });
+		}
+		else
+		{
+			std::set<MultiFrameEvent> ordered_deduped_events;
+			YAML::Node run_node = YAML::LoadFile(yaml_file_path.string());
+			YAML::Node events_node = run_node["events"];
+			for (std::size_t idx = 0; idx < events_node.size(); idx++)
+			{
+				YAML::Node event_node = events_node[idx];
+				MultiFrameEvent e;
+				e.evt.frame_number = event_node[0][0].as<uint32_t>();
+				e.duration = event_node[0][1].as<uint32_t>() - e.evt.frame_number + 1;
+				e.evt.data.type = util::GetEventType(event_node[1].as<std::string>());
+				ordered_deduped_events.emplace(e);
+			}
+			deduped_events.reserve(ordered_deduped_events.size());
+			for (const MultiFrameEvent& e : ordered_deduped_events)
+				deduped_events.push_back(e);
 		}
-		std::vector<MultiFrameEvent> deduped_events;
-		deduped_events.reserve(ordered_deduped_events.size());
-		for (const MultiFrameEvent& e : ordered_deduped_events)
-			deduped_events.push_back(e);
 
 		std::vector<std::shared_ptr<AssembledEvent>> assembled_events;
 		EventAssembler::Assemble(deduped_events, assembled_events);
@@ -355,22 +261,254 @@ int main(int argc, char* argv[])
 	}
 	std::cout << "Processing with " << num_threads << " work threads" << std::endl;
 
+	if (auto itor = cfg.options.find("scheduling_policy"); itor != cfg.options.end())
+	{
+		// cost_weighted needs estimates of the item costs, they only exist offline (see --simulate-schedule)
+		std::unique_ptr<SchedulingPolicy> policy = itor->second != "cost_weighted" ? MakeSchedulingPolicy(itor->second) : nullptr;
+		if (!policy)
+		{
+			std::cout << "Invalid scheduling_policy value '" << itor->second << "' in " << yaml_path.string() << std::endl;
+			return 0;
+		}
+		scheduler.SetPolicy(std::move(policy));
+		std::cout << "Scheduling policy: " << scheduler.GetPolicyName() << std::endl;
+	}
+	bool stream_events;		// write the deduped events to stream_<i>.ndjson while the video is analysed
+	if (!ParseBoolOption(cfg, "stream_events", false, stream_events))
+		return 0;
+	if (stream_events)
+	{
+		for (const RunConfig::Video& video : cfg.videos)
+		{
+			for (size_t j = 1; j < video.segments.size(); j++)
+			{
+				if (video.segments[j].start_frame <= video.segments[j - 1].end_frame)
+				{
+					std::cout << "stream_events needs the segments of " << video.filename << " in increasing frame order" << std::endl;
+					return 0;
+				}
+			}
+		}
+		// the events above the watermark are held until it gets to them, handing out the items in order keeps that short
+		if (scheduler.GetPolicyName() != "in_order")
+			std::cout << "stream_events holds more events with the " << scheduler.GetPolicyName() << " scheduling policy, consider scheduling_policy: in_order" << std::endl;
+	}
+	bool schedule_trace;		// write the cost of every work item for --simulate-schedule
+	if (!ParseBoolOption(cfg, "schedule_trace", false, schedule_trace))
+		return 0;
+
+	// the context tracker changes what gets detected (ZoraMonument needs a location, fast-forwards skip detectors), it is opt-in
+	AnalyseOptions analyse_options = { .context_aware = false, .hw_counters = false };
+	FrameDetectors::EnableFlags& enabled_detectors = analyse_options.enabled_detectors;
+	if (!FrameDetectors::ParseEnableFlags(cfg, enabled_detectors))
+		return 0;
+	if (!enabled_detectors.all())
+	{
+		std::cout << "Disabled detectors:";
+		for (uint32_t i = 0; i < FrameDetectors::NUM_DETECTORS; i++)
+			if (!enabled_detectors[i])
+				std::cout << ' ' << FrameDetectors::names[i];
+		std::cout << std::endl;
+	}
+	if (!ParseBoolOption(cfg, "context_aware", analyse_options.context_aware, analyse_options.context_aware))
+		return 0;
+	bool use_trace;
+	if (!ParseBoolOption(cfg, "trace", false, use_trace))
+		return 0;
+	if (use_trace && !trace::Enable((yaml_path / "trace.json").string()))
+		return 0;
+	if (!ParseBoolOption(cfg, "hw_counters", analyse_options.hw_counters, analyse_options.hw_counters))
+		return 0;
+	if (analyse_options.hw_counters)
+	{
+		perf::HWCounterGroup probe;
+		if (!probe.Open())
+		{
+			std::cout << "Hardware counters not available, ignoring hw_counters" << std::endl;
+			analyse_options.hw_counters = false;
+		}
+		else
+		{
+			std::cout << "Hardware counters:";
+			for (uint32_t i = 0; i < perf::NUM_HW_COUNTERS; i++)
+				if (probe.GetAvailableMask() & (1u << i))
+					std::cout << ' ' << perf::GetHWCounterName(perf::HWCounter(i));
+			std::cout << std::endl;
+		}
+	}
+	bool use_audit;
+	if (!ParseBoolOption(cfg, "audit", false, use_audit))
+		return 0;
+	if (use_audit && !audit::Enable(yaml_path))
+		return 0;
+	bool use_journal;		// resume the work items a previous run of the video completed
+	if (!ParseBoolOption(cfg, "journal", false, use_journal))
+		return 0;
+	bool use_cache;		// reuse the raw events of earlier runs per detector, see ResultCache
+	if (!ParseBoolOption(cfg, "cache", false, use_cache))
+		return 0;
+	uint32_t corpus_every_nth = 0;		// frames recorded regardless of the gates, 0 for gate passing frames only
+	if (auto itor = cfg.options.find("corpus_every_nth"); itor != cfg.options.end())
+	{
+		try {
+			corpus_every_nth = uint32_t(std::stoul(itor->second));
+		}
+		catch (...)
+		{
+			std::cout << "Invalid corpus_every_nth value '" << itor->second << "' in " << yaml_path.string() << std::endl;
+			return 0;
+		}
+	}
+	bool use_corpus;
+	if (!ParseBoolOption(cfg, "corpus", false, use_corpus))
+		return 0;
+	if (use_corpus)
+		corpus::Enable(yaml_path, corpus_every_nth);
+	bool use_fingerprint;
+	if (!ParseBoolOption(cfg, "fingerprint", false, use_fingerprint))
+		return 0;
+	if (use_fingerprint)
+		fingerprint::Enable();
+	bool alloc_tracking;
+	if (!ParseBoolOption(cfg, "alloc_tracking", false, alloc_tracking))
+		return 0;
+	if (alloc_tracking && !alloc::Enable())
+	{
+		std::cout << "alloc_tracking needs the Profile build (ALLOC_TRACKING)" << std::endl;
+		return 0;
+	}
+	trace::BeginThread(0, "main");
+
+	// map the model file once, all work threads initialize their tesseract instance from this shared mapping
+	if (!TesseractAPI::MapTrainedData("eng"))
+		return 0;
+	TesseractAPI::PrintInstanceFootprint("eng");
+	std::string cache_pipeline_key;
+	if (use_cache)
+		cache_pipeline_key = ResultCache::MakePipelineKey();
+	bool first_frame_reported = false;
+
+	std::vector<std::string_view> perf_detector_names(FrameDetectors::names.begin(), FrameDetectors::names.end());
+	perf_detector_names.push_back("location");
+
 	std::map<EventType, uint32_t> event_counter;
 	std::array<uint32_t, uint32_t(DialogId::Max)> dialog_counter;
 	dialog_counter.fill(0);
 
 	for (uint32_t i = 0; i < uint32_t(cfg.videos.size()); i++)
 	{
-		std::multimap<uint32_t, SingleFrameEvent> merged_events;
+		// raw events as sorted runs (per work item) in the order they came in: resumed ones, then each work thread's, per segment
+		std::vector<std::vector<SingleFrameEvent>> raw_events;
+		perf::Counters video_perf_counters(perf_detector_names);
+		audit::BeginVideo(i);
+		if (!corpus::BeginVideo(i))
+			return 0;
+		if (!fingerprint::BeginVideo(yaml_path / cfg.videos[i].filename,
+			cv::Rect(cfg.videos[i].bbox_left, cfg.videos[i].bbox_top, cfg.videos[i].bbox_right - cfg.videos[i].bbox_left + 1, cfg.videos[i].bbox_bottom - cfg.videos[i].bbox_top + 1)))
+			return 0;
+		alloc::ResetPeak();
+
+		EventJournal journal;
+		std::vector<EventJournal::Item> journaled_items;
+		analyse_options.journal = nullptr;
+		if (use_journal)
+		{
+			// everything the raw events of a work item depend on, besides the code
+			std::ostringstream run_key;
+			run_key << cfg.videos[i].filename << '|' << cfg.videos[i].bbox_left << ',' << cfg.videos[i].bbox_top << ',' << cfg.videos[i].bbox_right << ',' << cfg.videos[i].bbox_bottom
+				<< '|' << cfg.videos[i].color_scale << ',' << cfg.videos[i].color_shift << '|' << enabled_detectors.to_string() << '|' << analyse_options.context_aware;
+			if (!journal.Open(yaml_path / ("journal_" + std::to_string(i) + ".bin"), EventJournal::Hash(run_key.str()), journaled_items))
+				return 0;
+			analyse_options.journal = &journal;
+		}
+		ResultCache cache;
+		analyse_options.cache = nullptr;
+		if (use_cache)
+		{
+			cv::Rect game_rect(cfg.videos[i].bbox_left, cfg.videos[i].bbox_top, cfg.videos[i].bbox_right - cfg.videos[i].bbox_left + 1, cfg.videos[i].bbox_bottom - cfg.videos[i].bbox_top + 1);
+			std::string video_key = ResultCache::MakeVideoKey(yaml_path / cfg.videos[i].filename, game_rect, cfg.videos[i].color_scale, cfg.videos[i].color_shift, analyse_options.context_aware);
+			if (!cache.Open(yaml_path / "cache", video_key, cache_pipeline_key, enabled_detectors))
+				return 0;
+			analyse_options.cache = &cache;
+		}
+		EventStream stream;
+		analyse_options.stream = nullptr;
+		if (stream_events)
+		{
+			if (!stream.Open(yaml_path / ("stream_" + std::to_string(i) + ".ndjson"), cfg.videos[i].patches))
+				return 0;
+			analyse_options.stream = &stream;
+		}
 
 		for (uint32_t j = 0; j < uint32_t(cfg.videos[i].segments.size()); j++)
 		{
+			trace::ScopedSpan trace_segment("segment", "segment", j);
 			DWORD tbegin = ::timeGetTime();
-			scheduler.AllocateWorkBatch(cfg.videos[i].segments[j].start_frame, cfg.videos[i].segments[j].end_frame);
+			uint32_t num_work_items = scheduler.AllocateWorkBatch(cfg.videos[i].segments[j].start_frame, cfg.videos[i].segments[j].end_frame, num_threads);
+			uint32_t num_frame_resumed = 0;
+			uint32_t num_items_resumed = 0;
+			std::vector<SingleFrameEvent> resumed_events;
+			if (stream_events)
+				stream.BeginSegment(cfg.videos[i].segments[j].start_frame);
+			for (const EventJournal::Item& item : journaled_items)
+			{
+				if (!scheduler.SkipWorkItem(item.frame_start, item.frame_end))
+					continue;
+				if (stream_events)
+					stream.OnItemDone(item.frame_start, item.frame_end, item.events);
+				else
+					resumed_events.insert(resumed_events.end(), item.events.begin(), item.events.end());
+				num_frame_resumed += item.frame_end - item.frame_start + 1;
+				num_items_resumed++;
+			}
+			if (num_items_resumed > 0)
+				std::cout << "video[" << i << "].segment[" << j << "]: resumed " << num_items_resumed << " of " << num_work_items << " work items from the journal" << std::endl;
+			if (use_cache)
+			{
+				// items cached for every enabled detector aren't decoded at all, the others only run the detectors missing
+				uint32_t enabled_mask = uint32_t(enabled_detectors.to_ulong());
+				uint32_t num_items_cached = 0, num_items_partial = 0;
+				for (uint32_t item = 0; item < num_work_items; item++)
+				{
+					uint32_t frame_start, frame_end;
+					if (!scheduler.GetPendingWorkItem(item, frame_start, frame_end))
+						continue;
+					uint32_t cached_mask = cache.GetCachedMask(frame_start, frame_end) & enabled_mask;
+					if (cached_mask == 0)
+						continue;
+					size_t first_cached_event = resumed_events.size();
+					cache.GetEvents(cached_mask, frame_start, frame_end, resumed_events);
+					std::span<const SingleFrameEvent> cached_events = std::span<const SingleFrameEvent>(resumed_events).subspan(first_cached_event);
+					if (cached_mask == enabled_mask)
+					{
+						scheduler.SkipWorkItem(frame_start, frame_end);
+						if (stream_events)
+							stream.OnItemDone(frame_start, frame_end, cached_events);
+						num_frame_resumed += frame_end - frame_start + 1;
+						num_items_cached++;
+					}
+					else
+					{
+						// the work thread completes the item
+						if (stream_events)
+							stream.AddEvents(frame_start, frame_end, cached_events);
+						num_items_partial++;
+					}
+					if (stream_events)
+						resumed_events.resize(first_cached_event);
+				}
+				if (num_items_cached + num_items_partial > 0)
+					std::cout << "video[" << i << "].segment[" << j << "]: " << num_items_cached << " of " << num_work_items << " work items cached, "
+						<< num_items_partial << " partially" << std::endl;
+			}
+			if (!resumed_events.empty())
+				raw_events.push_back(std::move(resumed_events));
 			std::vector<std::thread> threads;
 			std::atomic<uint32_t> num_ended_thread = 0;
 			std::vector<std::vector<SingleFrameEvent>> events(num_threads);
 			std::vector<uint32_t> num_frame_parsed(num_threads, 0);
+			std::vector<perf::Counters> perf_counters(num_threads, perf::Counters(perf_detector_names));
+			std::vector<FrameDetectors::OrderReport> order_reports(num_threads, { .order = FrameDetectors::cascade_order, .expected_cost_us = 0, .num_reorders = 0 });
 			for (uint32_t thd_idx = 0; thd_idx < num_threads; thd_idx++)
 			{
 				threads.emplace_back(AnalyseVideo,
@@ -380,15 +518,25 @@ int main(int argc, char* argv[])
 					std::ref(events[thd_idx]),
 					std::ref(num_frame_parsed[thd_idx]),
 					std::ref(scheduler),
-					scheduler.GetThreadAffinity(thd_idx));
+					thd_idx,
+					std::cref(analyse_options),
+					std::ref(order_reports[thd_idx]),
+					std::ref(perf_counters[thd_idx]));
 			}
 			uint32_t num_frame_total = cfg.videos[i].segments[j].end_frame - cfg.videos[i].segments[j].start_frame + 1;
 			DWORD fps_tbegin = ::timeGetTime();
 			uint32_t fps = 0;
-			uint32_t last_frame_parsed = 0;
+			uint32_t last_frame_parsed = num_frame_resumed;
 			while (1)
 			{
-				uint32_t total_frame_parsed = std::accumulate(num_frame_parsed.begin(), num_frame_parsed.end(), 0);
+				uint32_t total_frame_parsed = std::accumulate(num_frame_parsed.begin(), num_frame_parsed.end(), 0) + num_frame_resumed;
+
+				if (!first_frame_reported && total_frame_parsed > 0)
+				{
+					std::string str = "Time to first frame: " + std::to_string(::timeGetTime() - tbegin) + " ms";
+					std::cout << '\r' << str << std::string(100 - str.size(), ' ') << std::endl;
+					first_frame_reported = true;
+				}
 
 				DWORD fps_tend = ::timeGetTime();
 				if (fps_tend - fps_tbegin > 200)
@@ -415,52 +563,78 @@ int main(int argc, char* argv[])
 				threads[thd_idx].join();
 			std::cout << std::endl;
 
-			for (const auto& thd_events : events)
-				for (const auto& event : thd_events)
-					merged_events.emplace(event.frame_number, event);
-		}
+			for (uint32_t thd_idx = 0; thd_idx < num_threads; thd_idx++)
+			{
+				const FrameDetectors::OrderReport& report = order_reports[thd_idx];
+				if (report.expected_cost_us == 0)
+					continue;
+				std::cout << "  thread " << thd_idx << " detector order: " << FrameDetectors::OrderToString(report.order, enabled_detectors)
+					<< " (" << uint32_t(report.expected_cost_us + 0.5) << " us/frame expected, "
+					<< report.num_reorders << " reorders)" << std::endl;
+			}
 
-		// apply patch
-		if (cfg.videos[i].patches.size() > 0)
-		{
-			uint32_t num_added_events = 0;
-			uint32_t num_removed_events = 0;
-			for (const RunConfig::Video::Patch& patch : cfg.videos[i].patches)
+			for (const perf::Counters& thd_perf_counters : perf_counters)
+				video_perf_counters.Merge(thd_perf_counters);
+
+			if (schedule_trace)
 			{
-				if (!patch.remove)
-				{
-					for (uint32_t frame = patch.evt.frame_number; frame <= patch.end_frame; frame++)
-					{
-						SingleFrameEvent evt = patch.evt;
-						evt.frame_number = frame;
-						merged_events.emplace(frame, evt);
-						num_added_events++;
-					}
-				}
+				fs::path schedule_path = yaml_path / ("schedule_" + std::to_string(i) + "_" + std::to_string(j) + ".yaml");
+				std::ofstream ofs(schedule_path.string());
+				if (!ofs.is_open())
+					std::cout << "Cannot write schedule trace " << schedule_path.string() << std::endl;
 				else
 				{
-					auto itor = merged_events.lower_bound(patch.evt.frame_number);
-					while (itor != merged_events.end())
-					{
-						if (itor->first > patch.end_frame)
-							break;
-						if (itor->second.data == patch.evt.data)
-						{
-							auto itor_next = std::next(itor);
-							merged_events.erase(itor);
-							itor = itor_next;
-							num_removed_events++;
-						}
-						else
-							itor++;
-					}
+					ofs << "---" << std::endl;
+					ofs << "policy: " << scheduler.GetPolicyName() << std::endl;
+					ofs << "num_workers: " << num_threads << std::endl;
+					ofs << "frames: [" << cfg.videos[i].segments[j].start_frame << ", " << cfg.videos[i].segments[j].end_frame << "]" << std::endl;
+					ofs << "items:  # [work_ns, seek_ns]" << std::endl;
+					for (const VideoParserScheduler::ItemCost& cost : scheduler.GetItemCosts())
+						ofs << "  - [" << cost.work_ns << ", " << cost.seek_ns << "]" << std::endl;
 				}
 			}
-			std::cout << "Added " << num_added_events << " and removed " << num_removed_events << " events when applying " << cfg.videos[i].patches.size() << " patches." << std::endl;
+
+			for (std::vector<SingleFrameEvent>& thd_events : events)
+				raw_events.push_back(std::move(thd_events));
 		}
 
+		if (corpus::IsEnabled())
+			std::cout << "Corpus: " << corpus::EndVideo() << " frames recorded to corpus_" << i << ".bin" << std::endl;
+		// frames resumed from the journal or the cache aren't decoded, so they aren't fingerprinted either
+		if (fingerprint::IsEnabled())
+			std::cout << "Fingerprints: " << fingerprint::EndVideo() << " frames written to " << cfg.videos[i].filename << ".fp" << std::endl;
+
 		std::vector<MultiFrameEvent> deduped_events;
-		EventDeduper::Dedup(merged_events, deduped_events);
+		uint32_t num_added_events = 0;
+		uint32_t num_removed_events = 0;
+		if (stream_events)
+		{
+			// patched and deduped as the watermark went by, only the file has them
+			uint32_t num_streamed_events = 0;
+			if (!stream.Finish(num_streamed_events, num_added_events, num_removed_events))
+				return 0;
+			std::cout << "Streamed " << num_streamed_events << " events to stream_" << i << ".ndjson" << std::endl;
+			if (!EventStream::Read(yaml_path / ("stream_" + std::to_string(i) + ".ndjson"), deduped_events))
+				return 0;
+		}
+		else
+		{
+			std::vector<SingleFrameEvent> merged_events;
+			{
+				trace::ScopedSpan trace_span("merge_events");
+				EventDeduper::MergeRuns(raw_events, merged_events);
+				std::vector<std::vector<SingleFrameEvent>>().swap(raw_events);
+			}
+
+			// apply patch
+			if (cfg.videos[i].patches.size() > 0)
+				EventDeduper::ApplyPatches(cfg.videos[i].patches, merged_events, num_added_events, num_removed_events);
+
+			trace::ScopedSpan trace_span("dedup");
+			EventDeduper::Dedup(merged_events, deduped_events);
+		}
+		if (cfg.videos[i].patches.size() > 0)
+			std::cout << "Added " << num_added_events << " and removed " << num_removed_events << " events when applying " << cfg.videos[i].patches.size() << " patches." << std::endl;
 
 		{
 			std::string yaml_str = std::move(EventDeduper::DedupedEventsToYAMLString(deduped_events));
@@ -473,13 +647,57 @@ int main(int argc, char* argv[])
 					std::cout << yaml_str;
 				else
 					ofs << yaml_str;
+				// read back instead of the YAML when replaying deduped_<i>.yaml
+				EventStore::Write(yaml_path / ("deduped_" + std::to_string(i) + ".bin"), deduped_events);
+			}
+			else
+				std::cout << yaml_str;
+		}
+
+		if (alloc::IsEnabled())
+		{
+			alloc::FlushThread();
+			std::cout << "Allocations: " << video_perf_counters.GetAllocsPerFrame() << " per frame, peak heap " << alloc::GetPeakBytes() / (1024 * 1024) << " MB" << std::endl;
+		}
+
+		{
+			std::string yaml_str = video_perf_counters.ToYAMLString();
+
+			fs::path perf_path = yaml_path / ("perf_" + std::to_string(i) + ".yaml");
+			if (yaml_file_path.filename() == "run.yaml")
+			{
+				std::ofstream ofs(perf_path.string());
+				if (!ofs.is_open())
+					std::cout << yaml_str;
+				else
+					ofs << yaml_str;
+			}
+			else
+				std::cout << yaml_str;
+		}
+
+		if (audit::IsEnabled())
+		{
+			std::string yaml_str = audit::ToYAMLString();
+
+			fs::path audit_path = yaml_path / ("audit_" + std::to_string(i) + ".yaml");
+			if (yaml_file_path.filename() == "run.yaml")
+			{
+				std::ofstream ofs(audit_path.string());
+				if (!ofs.is_open())
+					std::cout << yaml_str;
+				else
+					ofs << yaml_str;
 			}
 			else
 				std::cout << yaml_str;
 		}
 
 		std::vector<std::shared_ptr<AssembledEvent>> assembled_events;
-		EventAssembler::Assemble(deduped_events, assembled_events);
+		{
+			trace::ScopedSpan trace_span("assemble");
+			EventAssembler::Assemble(deduped_events, assembled_events);
+		}
 		{
 			std::string yaml_str = std::move(EventAssembler::AssembledEventsToYAMLString(assembled_events));
 
@@ -491,6 +709,8 @@ int main(int argc, char* argv[])
 					std::cout << yaml_str;
 				else
 					ofs << yaml_str;
+				// the same events for --query
+				EventStore::Write(yaml_path / ("events_" + std::to_string(i) + ".bin"), assembled_events);
 			}
 			else
 				std::cout << yaml_str;
@@ -511,6 +731,16 @@ int main(int argc, char* argv[])
 		}
 	}
 
+	trace::EndThread();
+	if (trace::IsEnabled())
+	{
+		fs::path trace_path = yaml_path / "trace.json";
+		if (trace::Finish())
+			std::cout << "Trace written to " << trace_path.string() << std::endl;
+		else
+			std::cout << "Cannot write trace file " << trace_path.string() << std::endl;
+	}
+
 	for (auto& itor : event_counter)
 		std::cout << util::GetEventText(itor.first) << ": " << itor.second << std::endl;
 
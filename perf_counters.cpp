@@ -0,0 +1,316 @@
+#include <bit>
+#include <cmath>
+#include <iomanip>
+#include "perf_counters.h"
+
+namespace perf
+{
+	static thread_local Counters* t_counters = nullptr;
+	static thread_local uint32_t t_detector = NO_DETECTOR;
+	static thread_local const HWCounterGroup* t_hw = nullptr;
+	static thread_local uint32_t t_stage = NUM_STAGES;			// NUM_STAGES outside of any stage
+	static thread_local bool t_count_allocs = false;
+
+	std::string_view GetStageName(Stage stage)
+	{
+		constexpr std::string_view names[] = {
+			"decode",
+			"color_correction",
+			"gate",
+			"ocr_preprocess",
+			"ocr",
+			"matching",
+			"emission",
+		};
+		static_assert(std::size(names) == NUM_STAGES);
+		return names[uint32_t(stage)];
+	}
+
+	uint32_t Histogram::BucketIndex(uint64_t ns)
+	{
+		constexpr uint64_t sub_buckets = 1 << SUB_BUCKET_BITS;
+		if (ns < sub_buckets)
+			return uint32_t(ns);
+		uint32_t exponent = uint32_t(std::bit_width(ns)) - 1;
+		uint32_t sub = uint32_t(ns >> (exponent - SUB_BUCKET_BITS)) & (sub_buckets - 1);
+		return std::min(((exponent - SUB_BUCKET_BITS + 1) << SUB_BUCKET_BITS) + sub, NUM_BUCKETS - 1);
+	}
+
+	uint64_t Histogram::BucketMidpoint(uint32_t index)
+	{
+		constexpr uint32_t sub_buckets = 1 << SUB_BUCKET_BITS;
+		if (index < sub_buckets)
+			return index;
+		uint32_t exponent = (index >> SUB_BUCKET_BITS) + SUB_BUCKET_BITS - 1;
+		uint64_t width = uint64_t(1) << (exponent - SUB_BUCKET_BITS);
+		uint64_t lower = uint64_t(sub_buckets + (index & (sub_buckets - 1))) * width;
+		return lower + width / 2;
+	}
+
+	void Histogram::Add(uint64_t ns)
+	{
+		_buckets[BucketIndex(ns)]++;
+		_count++;
+		_total_ns += ns;
+	}
+
+	void Histogram::Merge(const Histogram& other)
+	{
+		for (uint32_t i = 0; i < NUM_BUCKETS; i++)
+			_buckets[i] += other._buckets[i];
+		_count += other._count;
+		_total_ns += other._total_ns;
+	}
+
+	uint64_t Histogram::PercentileNs(double p) const
+	{
+		if (_count == 0)
+			return 0;
+		uint64_t rank = std::max<uint64_t>(uint64_t(std::ceil(p * double(_count))), 1);
+		uint64_t seen = 0;
+		for (uint32_t i = 0; i < NUM_BUCKETS; i++)
+		{
+			seen += _buckets[i];
+			if (seen >= rank)
+				return BucketMidpoint(i);
+		}
+		return BucketMidpoint(NUM_BUCKETS - 1);
+	}
+
+	void DetectorCounters::Merge(const DetectorCounters& other)
+	{
+		calls += other.calls;
+		gate_passes += other.gate_passes;
+		ocr_calls += other.ocr_calls;
+		detections += other.detections;
+		time.Merge(other.time);
+		for (uint32_t i = 0; i < NUM_STAGES; i++)
+			stages[i].Merge(other.stages[i]);
+	}
+
+	Counters::Counters(std::span<const std::string_view> detector_names)
+		: _detector_names(detector_names.begin(), detector_names.end())
+		, _detectors(detector_names.size())
+	{
+	}
+
+	void Counters::Merge(const Counters& other)
+	{
+		for (uint32_t i = 0; i < uint32_t(_detectors.size()) && i < uint32_t(other._detectors.size()); i++)
+			_detectors[i].Merge(other._detectors[i]);
+		for (uint32_t i = 0; i < NUM_STAGES; i++)
+			_stages[i].Merge(other._stages[i]);
+		for (uint32_t i = 0; i < NUM_STAGES; i++)
+		{
+			for (uint32_t j = 0; j < NUM_HW_COUNTERS; j++)
+				_stages_hw[i][j] += other._stages_hw[i][j];
+		}
+		_hw_mask |= other._hw_mask;
+		for (uint32_t i = 0; i <= NUM_STAGES; i++)
+			_stages_alloc[i].Merge(other._stages_alloc[i]);
+		_alloc_frames += other._alloc_frames;
+		_frames += other._frames;
+		_seeks += other._seeks;
+		_work_ns += other._work_ns;
+	}
+
+	void Counters::AddStageHW(perf::Stage stage, const HWSample& begin, const HWSample& end)
+	{
+		for (uint32_t i = 0; i < NUM_HW_COUNTERS; i++)
+			_stages_hw[uint32_t(stage)][i] += end[i] - begin[i];
+	}
+
+	double Counters::GetAllocsPerFrame() const
+	{
+		if (!_alloc_frames)
+			return 0;
+		uint64_t count = 0;
+		for (const AllocCounters& alloc : _stages_alloc)
+			count += alloc.count;
+		return double(count) / _alloc_frames;
+	}
+
+	static void HistogramToYAML(std::ostream& os, const Histogram& h)
+	{
+		os << "{ count: " << h.Count()
+			<< ", total_ms: " << h.TotalNs() / 1e6
+			<< ", p50_us: " << h.PercentileNs(0.5) / 1e3
+			<< ", p99_us: " << h.PercentileNs(0.99) / 1e3 << " }" << std::endl;
+	}
+
+	std::string Counters::ToYAMLString() const
+	{
+		std::ostringstream os;
+		os << std::fixed << std::setprecision(3);
+		os << "---" << std::endl;
+		os << "frames: " << _frames << std::endl;
+		os << "seeks: " << _seeks << std::endl;
+		os << "work_ms: " << _work_ns / 1e6 << std::endl;
+		os << "stages:" << std::endl;
+		for (uint32_t i = 0; i < NUM_STAGES; i++)
+		{
+			os << "  " << GetStageName(perf::Stage(i)) << ": ";
+			HistogramToYAML(os, _stages[i]);
+		}
+		if (_hw_mask)
+		{
+			os << "hw_counters:" << std::endl;
+			for (uint32_t i = 0; i < NUM_STAGES; i++)
+			{
+				const HWSample& hw = _stages_hw[i];
+				os << "  " << GetStageName(perf::Stage(i)) << ": {";
+				const char* separator = " ";
+				for (uint32_t j = 0; j < NUM_HW_COUNTERS; j++)
+				{
+					if (!(_hw_mask & (1u << j)))
+						continue;
+					os << separator << GetHWCounterName(HWCounter(j)) << ": " << hw[j];
+					separator = ", ";
+				}
+				if ((_hw_mask & (1u << uint32_t(HWCounter::Cycles))) && _stages[i].Count())
+					os << ", cycles_per_call: " << hw[uint32_t(HWCounter::Cycles)] / _stages[i].Count();
+				os << " }" << std::endl;
+			}
+		}
+		if (_alloc_frames)
+		{
+			os << "allocations:" << std::endl;
+			os << "  frames: " << _alloc_frames << std::endl;
+			os << "  per_frame: " << GetAllocsPerFrame() << std::endl;
+			for (uint32_t i = 0; i <= NUM_STAGES; i++)
+			{
+				const AllocCounters& alloc = _stages_alloc[i];
+				os << "  " << (i < NUM_STAGES ? GetStageName(perf::Stage(i)) : "other") << ": { count: " << alloc.count
+					<< ", bytes: " << alloc.bytes
+					<< ", count_per_frame: " << double(alloc.count) / _alloc_frames
+					<< ", bytes_per_frame: " << double(alloc.bytes) / _alloc_frames << " }" << std::endl;
+			}
+		}
+		os << "detectors:" << std::endl;
+		for (uint32_t i = 0; i < uint32_t(_detectors.size()); i++)
+		{
+			const DetectorCounters& d = _detectors[i];
+			os << "  " << _detector_names[i] << ":" << std::endl;
+			os << "    calls: " << d.calls << std::endl;
+			os << "    detections: " << d.detections << std::endl;
+			os << "    gate_passes: " << d.gate_passes << std::endl;
+			os << "    gate_pass_rate: " << (d.calls ? double(d.gate_passes) / d.calls : 0.0) << std::endl;
+			os << "    ocr_calls: " << d.ocr_calls << std::endl;
+			os << "    time: ";
+			HistogramToYAML(os, d.time);
+			bool has_stages = std::any_of(d.stages.begin(), d.stages.end(), [](const Histogram& h) { return h.Count() > 0; });
+			os << "    stages:" << (has_stages ? "" : " {}") << std::endl;
+			for (uint32_t j = 0; j < NUM_STAGES; j++)
+			{
+				if (d.stages[j].Count() == 0)
+					continue;
+				os << "      " << GetStageName(perf::Stage(j)) << ": ";
+				HistogramToYAML(os, d.stages[j]);
+			}
+		}
+
+		return os.str();
+	}
+
+	void BindThread(Counters* counters)
+	{
+		t_counters = counters;
+		t_detector = NO_DETECTOR;
+		t_hw = nullptr;
+		t_stage = NUM_STAGES;
+		t_count_allocs = false;
+	}
+
+	const Counters* GetThreadCounters()
+	{
+		return t_counters;
+	}
+
+	void BindHWCounters(const HWCounterGroup* group)
+	{
+		t_hw = group;
+		if (t_counters && group)
+			t_counters->SetHWMask(group->GetAvailableMask());
+	}
+
+	ScopedStage::ScopedStage(perf::Stage stage)
+		: _stage(stage)
+		, _parent_stage(t_stage)
+	{
+		if (!t_counters)
+			return;
+		t_stage = uint32_t(stage);
+		if (t_hw)
+			t_hw->Read(_hw_begin);
+		_tbegin = std::chrono::steady_clock::now();
+	}
+
+	ScopedStage::~ScopedStage()
+	{
+		if (!t_counters)
+			return;
+		uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - _tbegin).count();
+		if (t_hw)
+		{
+			HWSample hw_end;
+			t_hw->Read(hw_end);
+			t_counters->AddStageHW(_stage, _hw_begin, hw_end);
+		}
+		t_counters->GetStage(_stage).Add(ns);
+		if (t_detector != NO_DETECTOR)
+			t_counters->GetDetector(t_detector).stages[uint32_t(_stage)].Add(ns);
+		t_stage = _parent_stage;
+	}
+
+	ScopedDetector::ScopedDetector(uint32_t detector)
+		: _detector(detector)
+		, _parent(t_detector)
+		, _ocr_calls_before(0)
+	{
+		if (!t_counters)
+			return;
+		t_detector = detector;
+		_ocr_calls_before = t_counters->GetDetector(detector).ocr_calls;
+		_tbegin = std::chrono::steady_clock::now();
+	}
+
+	ScopedDetector::~ScopedDetector()
+	{
+		if (!t_counters)
+			return;
+		uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - _tbegin).count();
+		DetectorCounters& d = t_counters->GetDetector(_detector);
+		d.calls++;
+		d.time.Add(ns);
+		if (d.ocr_calls != _ocr_calls_before)
+			d.gate_passes++;
+		if (_detected)
+			d.detections++;
+		t_detector = _parent;
+	}
+
+	void CountOCRCall()
+	{
+		if (t_counters && t_detector != NO_DETECTOR)
+			t_counters->GetDetector(t_detector).ocr_calls++;
+	}
+
+	ScopedFrame::ScopedFrame(bool steady)
+		: _steady(steady && t_counters)
+	{
+		t_count_allocs = _steady;
+	}
+
+	ScopedFrame::~ScopedFrame()
+	{
+		t_count_allocs = false;
+		if (_steady)
+			t_counters->CountAllocFrame();
+	}
+
+	void CountAlloc(uint64_t bytes)
+	{
+		if (t_count_allocs)
+			t_counters->AddAlloc(t_stage, bytes);
+	}
+}
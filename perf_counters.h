@@ -0,0 +1,175 @@
+#pragma once
+#include <chrono>
+#include <string>
+#include <vector>
+#include "common.h"
+#include "hw_counters.h"
+
+
+/**
+ * Per-thread performance counters of the analysis loop. Each work thread binds its own Counters, the instrumented
+ * code below only touches the counters of the calling thread, and main merges them once the threads are joined.
+ * Everything is a no-op on threads without bound counters.
+ */
+namespace perf
+{
+	enum class Stage : uint8_t
+	{
+		Decode,
+		ColorCorrection,
+		Gate,			// pixel tests deciding whether a detector needs to OCR
+		OCRPreprocess,	// scaling, thresholding and conversion of the ROI for tesseract
+		OCR,
+		Matching,		// OCR text against the expected strings
+		Emission,
+		Max,
+	};
+	constexpr uint32_t NUM_STAGES = uint32_t(Stage::Max);
+	constexpr uint32_t NO_DETECTOR = ~uint32_t(0);
+
+	std::string_view GetStageName(Stage stage);
+
+	// Durations in ns, log-linear buckets: 4 per power of two, so percentiles are within ~12%
+	class Histogram
+	{
+	public:
+		static constexpr uint32_t SUB_BUCKET_BITS = 2;
+		static constexpr uint32_t NUM_BUCKETS = 41 << SUB_BUCKET_BITS;		// up to 2^40 ns, about 18 minutes
+
+	private:
+		std::array<uint64_t, NUM_BUCKETS> _buckets{};
+		uint64_t _count = 0;
+		uint64_t _total_ns = 0;
+
+	private:
+		static uint32_t BucketIndex(uint64_t ns);
+		static uint64_t BucketMidpoint(uint32_t index);
+
+	public:
+		void Add(uint64_t ns);
+		void Merge(const Histogram& other);
+
+		uint64_t Count() const { return _count; }
+		uint64_t TotalNs() const { return _total_ns; }
+		// p in [0, 1]
+		uint64_t PercentileNs(double p) const;
+	};
+
+	// Allocations seen by the alloc tracker, bytes as reported by the allocator
+	struct AllocCounters
+	{
+		uint64_t count = 0;
+		uint64_t bytes = 0;
+
+		void Merge(const AllocCounters& other) { count += other.count; bytes += other.bytes; }
+	};
+
+	struct DetectorCounters
+	{
+		uint64_t calls = 0;
+		uint64_t gate_passes = 0;		// calls that got past the pixel tests to OCR
+		uint64_t ocr_calls = 0;
+		uint64_t detections = 0;
+		Histogram time;
+		std::array<Histogram, NUM_STAGES> stages;
+
+		void Merge(const DetectorCounters& other);
+	};
+
+	class Counters
+	{
+	private:
+		std::vector<std::string_view> _detector_names;
+		std::vector<DetectorCounters> _detectors;
+		std::array<Histogram, NUM_STAGES> _stages;
+		std::array<HWSample, NUM_STAGES> _stages_hw{};
+		uint32_t _hw_mask = 0;			// hardware counters that were available
+		std::array<AllocCounters, NUM_STAGES + 1> _stages_alloc;	// the last entry is the frame loop outside of any stage
+		uint64_t _alloc_frames = 0;		// frames the allocations were counted on
+		uint64_t _frames = 0;
+		uint64_t _seeks = 0;
+		uint64_t _work_ns = 0;			// time spent on work items, the rest of the thread's life is init and waiting
+
+	public:
+		Counters(std::span<const std::string_view> detector_names);
+
+		DetectorCounters& GetDetector(uint32_t index) { return _detectors[index]; }
+		const DetectorCounters& GetDetector(uint32_t index) const { return _detectors[index]; }
+		Histogram& GetStage(perf::Stage stage) { return _stages[uint32_t(stage)]; }
+		void CountFrame() { _frames++; }
+		void CountSeek() { _seeks++; }
+		void AddWorkTime(uint64_t ns) { _work_ns += ns; }
+		uint64_t GetFrames() const { return _frames; }
+		uint64_t GetSeeks() const { return _seeks; }
+		uint64_t GetWorkNs() const { return _work_ns; }
+		void SetHWMask(uint32_t mask) { _hw_mask = mask; }
+		void AddStageHW(perf::Stage stage, const HWSample& begin, const HWSample& end);
+		void AddAlloc(uint32_t stage, uint64_t bytes) { _stages_alloc[stage].count++; _stages_alloc[stage].bytes += bytes; }
+		void CountAllocFrame() { _alloc_frames++; }
+		// steady state allocations per frame, 0 if no frame was counted
+		double GetAllocsPerFrame() const;
+
+		void Merge(const Counters& other);
+		std::string ToYAMLString() const;
+	};
+
+	// bind counters to the calling thread, nullptr to unbind
+	void BindThread(Counters* counters);
+	// the counters bound to the calling thread, nullptr if none
+	const Counters* GetThreadCounters();
+	// Also attribute hardware counters to the stages of the calling thread, must be called after BindThread(). nullptr to unbind
+	void BindHWCounters(const HWCounterGroup* group);
+
+	// Time spent in a stage, charged to the thread and to the detector currently running on it
+	class ScopedStage
+	{
+	private:
+		perf::Stage _stage;
+		uint32_t _parent_stage;
+		std::chrono::steady_clock::time_point _tbegin;
+		HWSample _hw_begin;
+
+	public:
+		ScopedStage(perf::Stage stage);
+		~ScopedStage();
+		ScopedStage(const ScopedStage&) = delete;
+		ScopedStage& operator=(const ScopedStage&) = delete;
+	};
+
+	// One call of a detector, stages and OCR calls in its scope are charged to it
+	class ScopedDetector
+	{
+	private:
+		uint32_t _detector;
+		uint32_t _parent;
+		uint64_t _ocr_calls_before;
+		bool _detected = false;
+		std::chrono::steady_clock::time_point _tbegin;
+
+	public:
+		ScopedDetector(uint32_t detector);
+		~ScopedDetector();
+		ScopedDetector(const ScopedDetector&) = delete;
+		ScopedDetector& operator=(const ScopedDetector&) = delete;
+
+		void SetDetected() { _detected = true; }
+	};
+
+	// Frame loop iteration. Allocations are only counted inside steady state frames, so the setup of the threads and
+	// the first frames after a seek don't show up in the per frame numbers
+	class ScopedFrame
+	{
+	private:
+		bool _steady;
+
+	public:
+		ScopedFrame(bool steady);
+		~ScopedFrame();
+		ScopedFrame(const ScopedFrame&) = delete;
+		ScopedFrame& operator=(const ScopedFrame&) = delete;
+	};
+
+	void CountOCRCall();
+	// called by the alloc tracker, must not allocate
+	void CountAlloc(uint64_t bytes);
+}
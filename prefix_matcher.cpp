@@ -0,0 +1,99 @@
+#include "prefix_matcher.h"
+#include "perf_counters.h"
+
+void PrefixMatcher::Init(uint32_t max_edits)
+{
+	_nodes.clear();
+	_nodes.push_back({ .c = 0, .first_child = NO_MATCH, .next_sibling = NO_MATCH, .entry = NO_MATCH });
+	_values.clear();
+	_prefixes.clear();
+	_max_edits = max_edits;
+	_max_length = 0;
+}
+
+bool PrefixMatcher::Insert(const std::string_view& prefix, uint32_t value)
+{
+	if (prefix.size() > MAX_PREFIX_LENGTH)
+	{
+		std::cout << "PrefixMatcher: \"" << prefix << "\" longer than " << MAX_PREFIX_LENGTH << " chars" << std::endl;
+		return false;
+	}
+
+	uint32_t node = 0;
+	for (char c : prefix)
+	{
+		uint32_t child = _nodes[node].first_child;
+		while (child != NO_MATCH && _nodes[child].c != c)
+			child = _nodes[child].next_sibling;
+		if (child == NO_MATCH)
+		{
+			child = uint32_t(_nodes.size());
+			_nodes.push_back({ .c = c, .first_child = NO_MATCH, .next_sibling = _nodes[node].first_child, .entry = NO_MATCH });
+			_nodes[node].first_child = child;
+		}
+		node = child;
+	}
+
+	if (_nodes[node].entry == NO_MATCH)
+		_nodes[node].entry = uint32_t(_values.size());
+	_values.push_back(value);
+	_prefixes.emplace_back(prefix);
+	_max_length = std::max(_max_length, uint32_t(prefix.size()));
+
+	return true;
+}
+
+uint32_t PrefixMatcher::Match(const std::string_view& text) const
+{
+	perf::ScopedStage perf_stage(perf::Stage::Matching);
+
+	// rows[d][j] is the edit distance between the trie path of depth d and text.substr(0, j), clamped to _max_edits + 1.
+	// Children only ever write rows deeper than their parent, so the walk keeps the whole path in this fixed table.
+	uint8_t rows[MAX_PREFIX_LENGTH + 1][MAX_PREFIX_LENGTH + 1];
+	std::string_view clipped = text.substr(0, std::min<size_t>(text.size(), _max_length));
+	for (uint32_t j = 0; j <= uint32_t(clipped.size()); j++)
+		rows[0][j] = uint8_t(std::min(j, _max_edits + 1));
+
+	uint32_t best_entry = NO_MATCH;
+	Visit(0, 0, clipped, rows, best_entry);
+	if (best_entry == NO_MATCH)
+		return NO_MATCH;
+	return _values[best_entry];
+}
+
+uint32_t PrefixMatcher::MatchLinear(const std::string_view& text) const
+{
+	util::EditDistancePattern pattern(text);
+	for (uint32_t i = 0; i < uint32_t(_prefixes.size()); i++)
+		if (text.size() >= _prefixes[i].size() && pattern.PrefixDistance(_prefixes[i], _max_edits) <= _max_edits)
+			return _values[i];
+	return NO_MATCH;
+}
+
+void PrefixMatcher::Visit(uint32_t node, uint32_t depth, const std::string_view& text, uint8_t(*rows)[MAX_PREFIX_LENGTH + 1], uint32_t& best_entry) const
+{
+	uint32_t n = uint32_t(text.size());
+	if (_nodes[node].entry != NO_MATCH && depth <= n && rows[depth][depth] <= _max_edits)
+		best_entry = std::min(best_entry, _nodes[node].entry);
+
+	const uint8_t* prev = rows[depth];
+	uint8_t* cur = rows[depth + 1];
+	const uint32_t out_of_budget = _max_edits + 1;
+	for (uint32_t child = _nodes[node].first_child; child != NO_MATCH; child = _nodes[child].next_sibling)
+	{
+		char c = _nodes[child].c;
+		cur[0] = uint8_t(std::min(depth + 1, out_of_budget));
+		uint32_t row_min = cur[0];
+		for (uint32_t j = 1; j <= n; j++)
+		{
+			uint32_t weight = text[j - 1] == c ? 0 : 1;
+			uint32_t v = std::min(std::min(prev[j] + 1u, cur[j - 1] + 1u), prev[j - 1] + weight);
+			cur[j] = uint8_t(std::min(v, out_of_budget));
+			row_min = std::min(row_min, uint32_t(cur[j]));
+		}
+
+		// every row below this node is at least row_min
+		if (row_min <= _max_edits)
+			Visit(child, depth + 1, text, rows, best_entry);
+	}
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "common.h"
+
+
+/**
+ * Matches an OCR string against a table of text prefixes with a fixed edit budget.
+ * The prefixes are compiled into a trie, which is walked as a Levenshtein automaton: one edit-distance row per trie node,
+ * shared by every prefix below it, and whole subtrees are dropped as soon as their row exceeds the budget.
+ * The cost of a match therefore grows with the number of distinct prefix characters rather than the number of table entries.
+ */
+class PrefixMatcher
+{
+public:
+	static constexpr uint32_t MAX_PREFIX_LENGTH = 64;
+	static constexpr uint32_t NO_MATCH = ~uint32_t(0);
+
+private:
+	struct Node
+	{
+		char c;
+		uint32_t first_child;
+		uint32_t next_sibling;
+		uint32_t entry;			// smallest insertion index among the entries ending at this node, or NO_MATCH
+	};
+
+	std::vector<Node> _nodes;			// _nodes[0] is the root (empty prefix)
+	std::vector<uint32_t> _values;		// value of each entry, in insertion order
+	std::vector<std::string> _prefixes;	// prefix of each entry, only read by MatchLinear()
+	uint32_t _max_edits = 0;
+	uint32_t _max_length = 0;
+
+private:
+	void Visit(uint32_t node, uint32_t depth, const std::string_view& text, uint8_t(*rows)[MAX_PREFIX_LENGTH + 1], uint32_t& best_entry) const;
+
+public:
+	// max_edits must be smaller than 255, the rows are kept in uint8_t
+	void Init(uint32_t max_edits);
+
+	// Entries inserted earlier win when several prefixes match
+	bool Insert(const std::string_view& prefix, uint32_t value);
+
+	/**
+	 * Find the first inserted prefix p with text.size() >= p.size() and
+	 * GetStringEditDistance(text.substr(0, p.size()), p) <= max_edits, and return its value. Returns NO_MATCH if there's none.
+	 */
+	uint32_t Match(const std::string_view& text) const;
+	// Same result by computing the prefix distance to every entry in order, the reference for --check-matchers
+	uint32_t MatchLinear(const std::string_view& text) const;
+
+	const std::vector<std::string>& GetPrefixes() const { return _prefixes; }
+};
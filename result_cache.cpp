@@ -0,0 +1,120 @@
+#include <algorithm>
+#include <iomanip>
+#include "result_cache.h"
+#include "tess_api.h"
+
+std::string ResultCache::MakeVideoKey(const std::filesystem::path& video_file, const cv::Rect& game_rect, double color_scale, double color_shift, bool context_aware)
+{
+	std::error_code ec;
+	uint64_t size = std::filesystem::file_size(video_file, ec);
+	auto mtime = std::filesystem::last_write_time(video_file, ec).time_since_epoch().count();
+
+	std::ostringstream os;
+	os << video_file.filename().string() << '|' << size << '|' << mtime << '|' << game_rect.x << ',' << game_rect.y << ',' << game_rect.width << ',' << game_rect.height
+		<< '|' << color_scale << ',' << color_shift << '|' << context_aware;
+	return os.str();
+}
+
+std::string ResultCache::MakePipelineKey()
+{
+	const TessDataMapping& traineddata = TesseractAPI::TrainedData();
+	std::ostringstream os;
+	os << std::hex << source_hashes::pipeline << '|' << CV_VERSION << '|' << tesseract::TessBaseAPI::Version()
+		<< '|' << EventJournal::Hash(std::string_view(traineddata.Data() ? traineddata.Data() : "", traineddata.Size()));
+	return os.str();
+}
+
+bool ResultCache::Open(const std::filesystem::path& dir, const std::string& video_key, const std::string& pipeline_key, const FrameDetectors::EnableFlags& enabled)
+{
+	std::ostringstream video_dir;
+	video_dir << std::hex << std::setw(16) << std::setfill('0') << EventJournal::Hash(video_key);
+	std::filesystem::path path = dir / video_dir.str();
+	std::error_code ec;
+	std::filesystem::create_directories(path, ec);
+	if (ec)
+	{
+		std::cout << "Cannot create " << path.string() << std::endl;
+		return false;
+	}
+
+	for (uint32_t i = 0; i < NUM_DETECTORS; i++)
+	{
+		DetectorCache& cache = _detectors[i];
+		cache.open = false;
+		cache.covered.clear();
+		cache.events.clear();
+		if (!enabled[i])
+			continue;
+
+		std::ostringstream journal_key;
+		journal_key << video_key << '|' << FrameDetectors::names[i] << '|' << pipeline_key << '|' << std::hex << FrameDetectors::detector_source_hashes[i];
+		std::vector<EventJournal::Item> items;
+		if (!cache.journal.Open(path / (std::string(FrameDetectors::names[i]) + ".bin"), EventJournal::Hash(journal_key.str()), items))
+			return false;
+		cache.open = true;
+
+		std::sort(items.begin(), items.end(), [](const EventJournal::Item& a, const EventJournal::Item& b) { return a.frame_start < b.frame_start; });
+		for (const EventJournal::Item& item : items)
+		{
+			// work items of different runs can overlap when the segments changed, the events of a frame are only kept once
+			uint32_t first_new_frame = item.frame_start;
+			if (!cache.covered.empty() && cache.covered.back().second + 1 >= item.frame_start)
+			{
+				first_new_frame = std::max(item.frame_start, cache.covered.back().second + 1);
+				cache.covered.back().second = std::max(cache.covered.back().second, item.frame_end);
+			}
+			else
+				cache.covered.emplace_back(item.frame_start, item.frame_end);
+			for (const SingleFrameEvent& event : item.events)
+			{
+				if (event.frame_number >= first_new_frame)
+					cache.events.push_back(event);
+			}
+		}
+	}
+	return true;
+}
+
+uint32_t ResultCache::GetCachedMask(uint32_t frame_start, uint32_t frame_end) const
+{
+	uint32_t mask = 0;
+	for (uint32_t i = 0; i < NUM_DETECTORS; i++)
+	{
+		const auto& covered = _detectors[i].covered;
+		// the last range starting at or before frame_start
+		auto itor = std::upper_bound(covered.begin(), covered.end(), frame_start, [](uint32_t frame, const auto& range) { return frame < range.first; });
+		if (itor != covered.begin() && std::prev(itor)->second >= frame_end)
+			mask |= 1u << i;
+	}
+	return mask;
+}
+
+void ResultCache::GetEvents(uint32_t detector_mask, uint32_t frame_start, uint32_t frame_end, std::vector<SingleFrameEvent>& out_events) const
+{
+	for (uint32_t i = 0; i < NUM_DETECTORS; i++)
+	{
+		if (!(detector_mask & (1u << i)))
+			continue;
+		const auto& events = _detectors[i].events;
+		auto first = std::lower_bound(events.begin(), events.end(), frame_start, [](const SingleFrameEvent& e, uint32_t frame) { return e.frame_number < frame; });
+		auto last = std::upper_bound(first, events.end(), frame_end, [](uint32_t frame, const SingleFrameEvent& e) { return frame < e.frame_number; });
+		out_events.insert(out_events.end(), first, last);
+	}
+}
+
+void ResultCache::Append(uint32_t frame_start, uint32_t frame_end, uint32_t detector_mask, std::span<const SingleFrameEvent> events, std::span<const uint8_t> event_detectors)
+{
+	std::vector<SingleFrameEvent> detector_events;
+	for (uint32_t i = 0; i < NUM_DETECTORS; i++)
+	{
+		if (!(detector_mask & (1u << i)) || !_detectors[i].open)
+			continue;
+		detector_events.clear();
+		for (size_t e = 0; e < events.size(); e++)
+		{
+			if (event_detectors[e] == i)
+				detector_events.push_back(events[e]);
+		}
+		_detectors[i].journal.Append(frame_start, frame_end, detector_events);
+	}
+}
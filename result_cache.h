@@ -0,0 +1,55 @@
+#pragma once
+#include <array>
+#include <filesystem>
+#include <string>
+#include "common.h"
+#include "detector_registry.h"
+#include "journal.h"
+
+
+/**
+ * Raw events of earlier runs, per video and per detector, so a re-run after extending a segment, adding a video or
+ * enabling a detector only analyses what isn't known yet. Each enabled detector has its own EventJournal under
+ * <dir>/<video key>/<detector>.bin holding its events by work item frame range. The video key covers the file (name,
+ * size and modification time), the game rect, the color correction and whether the context tracker skips detectors.
+ * The journal key adds the pipeline key and the hash of the detector's sources, so that rebuilding with a changed
+ * detector, shared detection code, OpenCV, Tesseract or traineddata starts its results over.
+ * The detectors' results are assumed to be independent of each other: the exclusions and the context skipping only
+ * skip detectors that can't fire anyway.
+ */
+class ResultCache
+{
+public:
+	static constexpr uint32_t NUM_DETECTORS = FrameDetectors::NUM_DETECTORS;
+
+private:
+	struct DetectorCache
+	{
+		bool open = false;
+		EventJournal journal;
+		std::vector<std::pair<uint32_t, uint32_t>> covered;		// sorted, disjoint and not adjacent frame ranges
+		std::vector<SingleFrameEvent> events;		// by frame
+	};
+
+	std::array<DetectorCache, NUM_DETECTORS> _detectors;
+
+public:
+	// identifies the content of the video file and how its frames are prepared for the detectors
+	static std::string MakeVideoKey(const std::filesystem::path& video_file, const cv::Rect& game_rect, double color_scale, double color_shift, bool context_aware);
+	// identifies the code and the data shared by all the detectors, once the traineddata is mapped (TesseractAPI::MapTrainedData)
+	static std::string MakePipelineKey();
+
+	// Load the cached results of the enabled detectors, returns false if the cache can't be written
+	bool Open(const std::filesystem::path& dir, const std::string& video_key, const std::string& pipeline_key, const FrameDetectors::EnableFlags& enabled);
+
+	// detectors with cached results for every frame of [frame_start, frame_end] (bit i for detector i)
+	uint32_t GetCachedMask(uint32_t frame_start, uint32_t frame_end) const;
+	// append the cached events of the detectors in detector_mask within [frame_start, frame_end], sorted by frame per detector
+	void GetEvents(uint32_t detector_mask, uint32_t frame_start, uint32_t frame_end, std::vector<SingleFrameEvent>& out_events) const;
+
+	/**
+	 * Store the results of a work item for the detectors in detector_mask, event_detectors holds the detector of each event
+	 * (see FrameDetectors::ProcessFrame). Thread safe, but the new results only show up in a later Open()
+	 */
+	void Append(uint32_t frame_start, uint32_t frame_end, uint32_t detector_mask, std::span<const SingleFrameEvent> events, std::span<const uint8_t> event_detectors);
+};
@@ -1,16 +1,28 @@
 #pragma once
 #include <vector>
 #include <map>
+#include <memory>
 #include <mutex>
+#include "scheduling_policy.h"
 #define NOMINMAX
 #include <Windows.h>
 
 class VideoParserScheduler
 {
+public:
+	// measured cost of a work item, the schedule trace of a batch
+	struct ItemCost
+	{
+		uint64_t work_ns;		// decoding and detection
+		uint64_t seek_ns;		// 0 if the worker continued from the previous item
+	};
+
 private:
 	std::vector<::GROUP_AFFINITY> m_thread_group_affinity;
 	uint32_t m_num_work_items;
-	std::vector<std::pair<uint32_t, uint32_t>> m_work_item_segments;
+	WorkItemSegments m_work_item_segments;
+	std::unique_ptr<SchedulingPolicy> m_policy;
+	std::vector<ItemCost> m_item_costs;
 	std::mutex m_item_mutex;
 	uint32_t m_start_frame, m_end_frame;
 
@@ -18,15 +30,26 @@ private:
 	void ItemIndexToStartEndFrame(uint32_t item_index, uint32_t& next_item_frame_start, uint32_t& next_item_frame_end);
 public:
 	VideoParserScheduler();
-	uint32_t AllocateWorkBatch(uint32_t start_frame, uint32_t end_frame);
+	// midpoint_split until set, takes effect with the next batch
+	void SetPolicy(std::unique_ptr<SchedulingPolicy> policy);
+	std::string_view GetPolicyName() const { return m_policy->GetName(); }
+	uint32_t AllocateWorkBatch(uint32_t start_frame, uint32_t end_frame, uint32_t num_workers);
+	// Take the work item covering exactly [frame_start, frame_end] out of the batch, e.g. because it was done by an
+	// earlier run. Returns false if the batch has no such item left
+	bool SkipWorkItem(uint32_t frame_start, uint32_t frame_end);
+	// frame range of a work item of the batch that's still to be done, returns false if it was handed out or skipped
+	bool GetPendingWorkItem(uint32_t item_index, uint32_t& frame_start, uint32_t& frame_end);
 	uint32_t GetNumThreads() const {
 		return uint32_t(m_thread_group_affinity.size());
 	}
 
 	// last_item = -1 to indicate there's no last item
-	int32_t GetNextWorkItem(int32_t last_item, uint32_t& next_item_frame_start, uint32_t& next_item_frame_end);
+	int32_t GetNextWorkItem(uint32_t worker, int32_t last_item, uint32_t& next_item_frame_start, uint32_t& next_item_frame_end);
 	uint32_t GetNumRemainingWorkItems();
 	uint32_t GetNumTotalWorkItems();
+	void RecordItemCost(uint32_t item, const ItemCost& cost);
+	// costs of the current batch by item index, call once its workers are joined
+	const std::vector<ItemCost>& GetItemCosts() const { return m_item_costs; }
 	const ::GROUP_AFFINITY* GetThreadAffinity(uint32_t thread_idx) const {
 		return &m_thread_group_affinity[thread_idx];
 	}
@@ -0,0 +1,200 @@
+#include <algorithm>
+#include "scheduling_policy.h"
+
+void WorkItemSegments::Reset(uint32_t num_items)
+{
+	m_segments.clear();
+	if (num_items > 0)
+		m_segments.emplace_back(0, num_items - 1);
+}
+
+bool WorkItemSegments::Contains(uint32_t item) const
+{
+	return std::any_of(m_segments.begin(), m_segments.end(), [item](const auto& seg) { return seg.first <= item && item <= seg.second; });
+}
+
+uint32_t WorkItemSegments::GetNumItems() const
+{
+	uint32_t ret = 0;
+	for (const auto& seg : m_segments)
+		ret += seg.second - seg.first + 1;
+	return ret;
+}
+
+void WorkItemSegments::Take(uint32_t item, int32_t last_item)
+{
+	for (size_t i = 0; i < m_segments.size(); i++)
+	{
+		auto& seg = m_segments[i];
+		if (item < seg.first || item > seg.second)
+			continue;
+
+		if (seg.first == seg.second)
+			m_segments.erase(m_segments.begin() + i);
+		else if (item == seg.first && (item == 0 || int64_t(item) == int64_t(last_item) + 1))
+			seg.first++;
+		else if (item == seg.second)
+			seg.second--;
+		else if (item == seg.first)
+		{
+			uint32_t last = seg.second;
+			m_segments.erase(m_segments.begin() + i);
+			m_segments.emplace_back(item + 1, last);
+		}
+		else
+		{
+			uint32_t last = seg.second;
+			seg.second = item - 1;
+			m_segments.emplace_back(item + 1, last);
+		}
+		return;
+	}
+}
+
+// the first item of the batch goes to the first worker asking, it's where the video is positioned already
+static bool IsFirstPick(const WorkItemSegments& remaining)
+{
+	return remaining.GetSegments().size() == 1 && remaining.GetSegments()[0].first == 0;
+}
+
+static bool CanContinue(int32_t last_item, const WorkItemSegments& remaining)
+{
+	return last_item >= 0 && remaining.Contains(uint32_t(last_item) + 1);
+}
+
+static uint32_t SplitLongestSegment(const WorkItemSegments& remaining)
+{
+	const auto& segments = remaining.GetSegments();
+	size_t longest = 0;
+	for (size_t i = 1; i < segments.size(); i++)
+	{
+		if (segments[i].second - segments[i].first > segments[longest].second - segments[longest].first)
+			longest = i;
+	}
+	return (segments[longest].first + segments[longest].second) / 2;
+}
+
+class MidpointSplitPolicy : public SchedulingPolicy
+{
+public:
+	std::string_view GetName() const override { return "midpoint_split"; }
+
+	uint32_t PickItem(uint32_t worker, int32_t last_item, const WorkItemSegments& remaining) override
+	{
+		if (IsFirstPick(remaining))
+			return 0;
+		if (CanContinue(last_item, remaining))
+			return uint32_t(last_item) + 1;
+		return SplitLongestSegment(remaining);
+	}
+};
+
+class SequentialAffinityPolicy : public SchedulingPolicy
+{
+private:
+	uint32_t m_num_items = 0;
+	uint32_t m_num_workers = 1;
+
+public:
+	std::string_view GetName() const override { return "sequential_affinity"; }
+
+	void Reset(uint32_t num_items, uint32_t num_workers) override
+	{
+		m_num_items = num_items;
+		m_num_workers = std::max(num_workers, 1u);
+	}
+
+	uint32_t PickItem(uint32_t worker, int32_t last_item, const WorkItemSegments& remaining) override
+	{
+		if (last_item < 0)
+		{
+			uint32_t home = uint32_t(uint64_t(worker % m_num_workers) * m_num_items / m_num_workers);
+			if (remaining.Contains(home))
+				return home;
+		}
+		if (CanContinue(last_item, remaining))
+			return uint32_t(last_item) + 1;
+		return SplitLongestSegment(remaining);
+	}
+};
+
+class CostWeightedPolicy : public SchedulingPolicy
+{
+private:
+	std::vector<double> m_item_costs;
+
+private:
+	double GetCost(uint32_t item) const
+	{
+		return item < m_item_costs.size() ? m_item_costs[item] : 1.0;
+	}
+
+public:
+	CostWeightedPolicy(std::span<const double> item_costs)
+		: m_item_costs(item_costs.begin(), item_costs.end())
+	{
+	}
+
+	std::string_view GetName() const override { return "cost_weighted"; }
+
+	uint32_t PickItem(uint32_t worker, int32_t last_item, const WorkItemSegments& remaining) override
+	{
+		if (IsFirstPick(remaining))
+			return 0;
+		if (CanContinue(last_item, remaining))
+			return uint32_t(last_item) + 1;
+
+		// the segment with the most estimated work left
+		const auto& segments = remaining.GetSegments();
+		size_t heaviest = 0;
+		double heaviest_cost = -1;
+		for (size_t i = 0; i < segments.size(); i++)
+		{
+			double cost = 0;
+			for (uint32_t item = segments[i].first; item <= segments[i].second; item++)
+				cost += GetCost(item);
+			if (cost > heaviest_cost)
+			{
+				heaviest = i;
+				heaviest_cost = cost;
+			}
+		}
+
+		// its first item with at least half of the cost before it, so both halves end up with about the same work
+		double cost = 0;
+		for (uint32_t item = segments[heaviest].first; item < segments[heaviest].second; item++)
+		{
+			cost += GetCost(item);
+			if (cost >= heaviest_cost / 2)
+				return item + 1;
+		}
+		return segments[heaviest].second;
+	}
+};
+
+class InOrderPolicy : public SchedulingPolicy
+{
+public:
+	std::string_view GetName() const override { return "in_order"; }
+
+	uint32_t PickItem(uint32_t worker, int32_t last_item, const WorkItemSegments& remaining) override
+	{
+		uint32_t lowest = remaining.GetSegments()[0].first;
+		for (const auto& seg : remaining.GetSegments())
+			lowest = std::min(lowest, seg.first);
+		return lowest;
+	}
+};
+
+std::unique_ptr<SchedulingPolicy> MakeSchedulingPolicy(std::string_view name, std::span<const double> item_costs)
+{
+	if (name == "midpoint_split")
+		return std::make_unique<MidpointSplitPolicy>();
+	if (name == "sequential_affinity")
+		return std::make_unique<SequentialAffinityPolicy>();
+	if (name == "cost_weighted")
+		return std::make_unique<CostWeightedPolicy>(item_costs);
+	if (name == "in_order")
+		return std::make_unique<InOrderPolicy>();
+	return nullptr;
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include <memory>
+#include <span>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+
+
+// Work items not handed out yet, as disjoint [first, last] ranges of item indices
+class WorkItemSegments
+{
+private:
+	std::vector<std::pair<uint32_t, uint32_t>> m_segments;
+
+public:
+	void Reset(uint32_t num_items);
+	bool Empty() const { return m_segments.empty(); }
+	bool Contains(uint32_t item) const;
+	uint32_t GetNumItems() const;
+	const std::vector<std::pair<uint32_t, uint32_t>>& GetSegments() const { return m_segments; }
+	/**
+	 * Remove the item. Continuing last_item (or taking item 0) shrinks its segment in place, anything else splits it:
+	 * the part before the item stays in place and the part after goes to the end, so that the longest segment picked
+	 * on ties is the same as with the original midpoint split
+	 */
+	void Take(uint32_t item, int32_t last_item = -1);
+};
+
+/**
+ * Decides which work item a worker gets next. Called with the scheduler's lock held, so implementations don't need
+ * their own. The same instances run live in VideoParserScheduler and offline in the schedule simulator.
+ */
+class SchedulingPolicy
+{
+public:
+	virtual ~SchedulingPolicy() = default;
+
+	virtual std::string_view GetName() const = 0;
+	// a new batch of num_items work items processed by num_workers workers
+	virtual void Reset(uint32_t num_items, uint32_t num_workers) {}
+	// last_item is the item the worker just finished, -1 if it's the worker's first. remaining isn't empty
+	virtual uint32_t PickItem(uint32_t worker, int32_t last_item, const WorkItemSegments& remaining) = 0;
+};
+
+/**
+ * midpoint_split:      continue with the next item, otherwise split the longest remaining segment at its midpoint
+ * sequential_affinity: worker w starts at w / N of the batch and continues from there, then splits like midpoint_split
+ * cost_weighted:       continue with the next item, otherwise split the segment with the highest estimated cost at its
+ *                      cost midpoint. Needs per-item cost estimates (e.g. from the trace of an earlier run), without
+ *                      them every item costs the same and it behaves like midpoint_split
+ * in_order:            always the lowest remaining item, so the items complete roughly in frame order
+ */
+constexpr std::string_view scheduling_policy_names[] = { "midpoint_split", "sequential_affinity", "cost_weighted", "in_order" };
+
+// nullptr if name isn't one of scheduling_policy_names. item_costs are only used by cost_weighted
+std::unique_ptr<SchedulingPolicy> MakeSchedulingPolicy(std::string_view name, std::span<const double> item_costs = {});
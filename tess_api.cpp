@@ -0,0 +1,131 @@
+#include <chrono>
+#include "tess_api.h"
+#include <psapi.h>
+
+TessDataMapping TesseractAPI::s_traineddata;
+
+TessDataMapping::~TessDataMapping()
+{
+	Close();
+}
+
+bool TessDataMapping::Open(const std::string& filename)
+{
+	Close();
+
+	_file = ::CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (_file == INVALID_HANDLE_VALUE)
+	{
+		std::cout << "Cannot open file " << filename << std::endl;
+		return false;
+	}
+
+	LARGE_INTEGER size;
+	if (!::GetFileSizeEx(_file, &size) || size.QuadPart == 0 || size.QuadPart > INT32_MAX)		// TessBaseAPI::Init() takes the size as int
+	{
+		std::cout << filename << ": invalid file size" << std::endl;
+		Close();
+		return false;
+	}
+
+	_mapping = ::CreateFileMappingA(_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!_mapping)
+	{
+		std::cout << "Cannot create file mapping for " << filename << std::endl;
+		Close();
+		return false;
+	}
+
+	_data = (const char*)::MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0);
+	if (!_data)
+	{
+		std::cout << "Cannot map view of " << filename << std::endl;
+		Close();
+		return false;
+	}
+	_size = uint32_t(size.QuadPart);
+
+	return true;
+}
+
+void TessDataMapping::Close()
+{
+	if (_data)
+		::UnmapViewOfFile(_data);
+	if (_mapping)
+		::CloseHandle(_mapping);
+	if (_file != INVALID_HANDLE_VALUE)
+		::CloseHandle(_file);
+	_data = nullptr;
+	_mapping = nullptr;
+	_file = INVALID_HANDLE_VALUE;
+	_size = 0;
+}
+
+bool TesseractAPI::MapTrainedData(const char* lang)
+{
+	return s_traineddata.Open(std::string("./") + lang + ".traineddata");
+}
+
+static uint64_t GetProcessPrivateBytes()
+{
+	PROCESS_MEMORY_COUNTERS_EX counters{};
+	if (!::GetProcessMemoryInfo(::GetCurrentProcess(), (PROCESS_MEMORY_COUNTERS*)&counters, sizeof(counters)))
+		return 0;
+	return counters.PrivateUsage;
+}
+
+void TesseractAPI::PrintInstanceFootprint(const char* lang)
+{
+	uint64_t private_bytes_before = GetProcessPrivateBytes();
+	auto tbegin = std::chrono::steady_clock::now();
+	{
+		TesseractAPI probe;
+		if (!probe.Init(lang))
+			return;
+		auto init_ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - tbegin).count();
+		int64_t private_bytes = int64_t(GetProcessPrivateBytes()) - int64_t(private_bytes_before);
+		std::cout << "Tesseract instance: initialized in " << init_ms << " ms, " << private_bytes / (1024 * 1024) << " MB private memory" << std::endl;
+	}
+}
+
+bool TesseractAPI::Init(const char* lang)
+{
+	// The dictionaries are only used to bias recognition towards english words. All matching is done by our own
+	// edit-distance code, so skip loading the DAWGs, which are the bulk of the per-instance memory and init time.
+	static const std::vector<std::string> init_vars = {
+		"load_system_dawg",
+		"load_freq_dawg",
+		"load_unambig_dawg",
+		"load_punc_dawg",
+		"load_number_dawg",
+		"load_bigram_dawg",
+	};
+	static const std::vector<std::string> init_values(init_vars.size(), "0");
+
+	int ret;
+	if (s_traineddata.Data())
+		ret = _api.Init(s_traineddata.Data(), int(s_traineddata.Size()), lang, tesseract::OEM_DEFAULT, nullptr, 0, &init_vars, &init_values, false, nullptr);
+	else
+		ret = _api.Init(".", lang, tesseract::OEM_DEFAULT, nullptr, 0, &init_vars, &init_values, false);
+	if (ret)
+	{
+		std::cout << "OCRTesseract: Could not initialize tesseract." << std::endl;
+		return false;
+	}
+
+	// use single line mode
+	_api.SetPageSegMode(tesseract::PageSegMode::PSM_SINGLE_LINE);
+
+	// limit to these characters
+	if (std::string_view(lang) == "eng")
+	{
+		if (!_api.SetVariable("tessedit_char_whitelist", "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz.'- "))
+			return false;
+	}
+	// ignore extra space at the end of the line without any text, doesn't seem to make much difference though
+	if (!_api.SetVariable("gapmap_use_ends", "true"))
+		return false;
+
+	return true;
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include "common.h"
+
+
+// <lang>.traineddata mapped read-only into the process, shared by all TesseractAPI instances
+class TessDataMapping
+{
+private:
+	HANDLE _file = INVALID_HANDLE_VALUE;
+	HANDLE _mapping = nullptr;
+	const char* _data = nullptr;
+	uint32_t _size = 0;
+
+public:
+	TessDataMapping() = default;
+	~TessDataMapping();
+	TessDataMapping(const TessDataMapping&) = delete;
+	TessDataMapping& operator=(const TessDataMapping&) = delete;
+
+	bool Open(const std::string& filename);
+	void Close();
+
+	const char* Data() const { return _data; }
+	uint32_t Size() const { return _size; }
+};
+
+class TesseractAPI
+{
+private:
+	static TessDataMapping s_traineddata;
+	tesseract::TessBaseAPI _api;
+
+public:
+	/**
+	 * Map <lang>.traineddata once for the whole process. Must be called before any Init(),
+	 * afterwards every instance initializes from the mapped memory instead of reading the file.
+	 */
+	static bool MapTrainedData(const char* lang);
+
+	/**
+	 * Initialize a throw-away instance and print its init time and private memory footprint
+	 */
+	static void PrintInstanceFootprint(const char* lang);
+
+	// the mapping made by MapTrainedData()
+	static const TessDataMapping& TrainedData()
+	{
+		return s_traineddata;
+	}
+
+	bool Init(const char* lang);
+
+	TesseractAPI() = default;
+	~TesseractAPI()
+	{
+		_api.Clear();
+	}
+
+	tesseract::TessBaseAPI& API()
+	{
+		return _api;
+	}
+};
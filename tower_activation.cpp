@@ -4,7 +4,7 @@
 
 bool TowerActivationDetector::IsActivatingTower(const cv::Mat& img, const cv::Rect& game_rect)
 {
-	cv::Rect rect = Detector::BBoxConversion<504, 777, 582, 609>(img.cols, img.rows, game_rect);
+	cv::Rect rect = Detector::BBoxConversion<text_roi>(img.cols, img.rows, game_rect);
 
 	static const std::vector<Detector::GreyScaleTestCriteria> crit = {
 		{.brightness_range_lower = 205, .brightness_range_upper = 255, .pixel_ratio_lower = 0.15, .pixel_ratio_upper = 0.23}
@@ -26,14 +26,19 @@ bool SingleLineDialogDetector::Init(const char* lang)
 	for (uint32_t i = 0; i < uint32_t(_1line_text_to_npc.size()); i++)
 		util::UnifyAmbiguousChars(_1line_text_to_npc[i].first);
 
+	_1line_matcher.Init(4);
+	for (const auto& [text, npc] : _1line_text_to_npc)
+		if (!_1line_matcher.Insert(text, std::to_underlying(npc)))
+			return false;
+
 	return true;
 }
 
 SingleFrameEventData SingleLineDialogDetector::GetEvent(const cv::Mat& img, const cv::Rect& game_rect)
 {
 	{
-		cv::Rect rect_upper = Detector::BBoxConversion<470, 810, 550, 570>(img.cols, img.rows, game_rect);
-		cv::Rect rect_lower = Detector::BBoxConversion<470, 810, 620, 640>(img.cols, img.rows, game_rect);
+		cv::Rect rect_upper = Detector::BBoxConversion<above_roi>(img.cols, img.rows, game_rect);
+		cv::Rect rect_lower = Detector::BBoxConversion<below_roi>(img.cols, img.rows, game_rect);
 		static const std::vector<Detector::GreyScaleTestCriteria> crit = {
 			{.brightness_range_lower = 205, .brightness_range_upper = 255, .pixel_ratio_lower = 0, .pixel_ratio_upper = 0.05}
 		};
@@ -43,7 +48,7 @@ SingleFrameEventData SingleLineDialogDetector::GetEvent(const cv::Mat& img, cons
 			return { .type = EventType::None };
 	}
 
-	cv::Rect rect = Detector::BBoxConversion<470, 810, 582, 609>(img.cols, img.rows, game_rect);
+	cv::Rect rect = Detector::BBoxConversion<text_roi>(img.cols, img.rows, game_rect);
 
 	static const std::vector<Detector::GreyScaleTestCriteria> crit = {
 		{.brightness_range_lower = 205, .brightness_range_upper = 255, .pixel_ratio_lower = 0.1, .pixel_ratio_upper = 0.3}
@@ -58,12 +63,8 @@ SingleFrameEventData SingleLineDialogDetector::GetEvent(const cv::Mat& img, cons
 		return { .type = EventType::GateRegistered };
 	else if (ret == "Sheikah Slate authenticated.")
 		return { .type = EventType::SlateAuthenticated };
-	else
-	{
-		for (uint32_t i = 0; i < uint32_t(_1line_text_to_npc.size()); i++)
-			if (ret.size() >= _1line_text_to_npc[i].first.size() && util::GetStringEditDistance(std::string_view(ret).substr(0, _1line_text_to_npc[i].first.size()), _1line_text_to_npc[i].first, 4) <= 4)
-				return { .type = EventType::Dialog, .dialog_data = {.dialog_id = _1line_text_to_npc[i].second} };
-	}
+	else if (uint32_t npc = _1line_matcher.Match(ret); npc != PrefixMatcher::NO_MATCH)
+		return { .type = EventType::Dialog, .dialog_data = {.dialog_id = DialogId(npc)} };
 	//else if (ret == "Time has taken its toll on this...")
 	//	return { .type = EventType::ZoraMonument, .monument_data = { .monument_id = 8 } };
 
@@ -87,6 +88,11 @@ bool ThreeLineDialogDetector::Init(const char* lang)
 	for (uint32_t i = 0; i < uint32_t(_3line_text_to_npc.size()); i++)
 		util::UnifyAmbiguousChars(_3line_text_to_npc[i].first);
 
+	_3line_matcher.Init(4);
+	for (const auto& [text, npc] : _3line_text_to_npc)
+		if (!_3line_matcher.Insert(text, std::to_underlying(npc)))
+			return false;
+
 	_2line_text_to_npc = {
 		{"When a single arrow", DialogId::Kass2},
 		{"Mount the beast", DialogId::Kass3},
@@ -109,14 +115,19 @@ bool ThreeLineDialogDetector::Init(const char* lang)
 	for (uint32_t i = 0; i < uint32_t(_2line_text_to_npc.size()); i++)
 		util::UnifyAmbiguousChars(_2line_text_to_npc[i].first);
 
+	_2line_matcher.Init(4);
+	for (const auto& [text, npc] : _2line_text_to_npc)
+		if (!_2line_matcher.Insert(text, std::to_underlying(npc)))
+			return false;
+
 	return true;
 }
 
 SingleFrameEventData ThreeLineDialogDetector::Get2LineDialogEvent(const cv::Mat& img, const cv::Rect& game_rect)
 {
 	{
-		cv::Rect rect_upper = Detector::BBoxConversion<470, 810, 535, 567>(img.cols, img.rows, game_rect);
-		cv::Rect rect_lower = Detector::BBoxConversion<470, 810, 621, 655>(img.cols, img.rows, game_rect);
+		cv::Rect rect_upper = Detector::BBoxConversion<line2_above_roi>(img.cols, img.rows, game_rect);
+		cv::Rect rect_lower = Detector::BBoxConversion<line2_below_roi>(img.cols, img.rows, game_rect);
 		static const std::vector<Detector::GreyScaleTestCriteria> crit = {
 			{.brightness_range_lower = 205, .brightness_range_upper = 255, .pixel_ratio_lower = 0, .pixel_ratio_upper = 0.05}
 		};
@@ -126,7 +137,7 @@ SingleFrameEventData ThreeLineDialogDetector::Get2LineDialogEvent(const cv::Mat&
 			return { .type = EventType::None };
 	}
 
-	cv::Rect rect = Detector::BBoxConversion<420, 850, 569, 596>(img.cols, img.rows, game_rect);
+	cv::Rect rect = Detector::BBoxConversion<line2_text_roi>(img.cols, img.rows, game_rect);
 
 	cv::Range clampedXRange = Detector::GreyscaleHorizontalClamp(img(rect), 180, 255);
 	if (clampedXRange.size() < rect.width / 3)		// there's too few text to recognize
@@ -145,9 +156,8 @@ SingleFrameEventData ThreeLineDialogDetector::Get2LineDialogEvent(const cv::Mat&
 	std::string ret = Detector::OCR(img(rect), scale_factor, 180, 255, true, _tess_api, "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz,.'-!\" ");
 	util::UnifyAmbiguousChars(ret);
 
-	for (uint32_t i = 0; i < uint32_t(_2line_text_to_npc.size()); i++)
-		if (ret.size() >= _2line_text_to_npc[i].first.size() && util::GetStringEditDistance(std::string_view(ret).substr(0, _2line_text_to_npc[i].first.size()), _2line_text_to_npc[i].first, 4) <= 4)
-			return { .type = EventType::Dialog, .dialog_data = { .dialog_id = _2line_text_to_npc[i].second} };
+	if (uint32_t npc = _2line_matcher.Match(ret); npc != PrefixMatcher::NO_MATCH)
+		return { .type = EventType::Dialog, .dialog_data = { .dialog_id = DialogId(npc)} };
 
 	return { .type = EventType::None };
 }
@@ -155,8 +165,8 @@ SingleFrameEventData ThreeLineDialogDetector::Get2LineDialogEvent(const cv::Mat&
 SingleFrameEventData ThreeLineDialogDetector::Get3LineDialogEvent(const cv::Mat& img, const cv::Rect& game_rect)
 {
 	{
-		cv::Rect rect_upper = Detector::BBoxConversion<470, 810, 535, 554>(img.cols, img.rows, game_rect);
-		cv::Rect rect_lower = Detector::BBoxConversion<470, 810, 636, 655>(img.cols, img.rows, game_rect);
+		cv::Rect rect_upper = Detector::BBoxConversion<line3_above_roi>(img.cols, img.rows, game_rect);
+		cv::Rect rect_lower = Detector::BBoxConversion<line3_below_roi>(img.cols, img.rows, game_rect);
 		static const std::vector<Detector::GreyScaleTestCriteria> crit = {
 			{.brightness_range_lower = 205, .brightness_range_upper = 255, .pixel_ratio_lower = 0, .pixel_ratio_upper = 0.05}
 		};
@@ -166,7 +176,7 @@ SingleFrameEventData ThreeLineDialogDetector::Get3LineDialogEvent(const cv::Mat&
 			return { .type = EventType::None };
 	}
 
-	cv::Rect rect = Detector::BBoxConversion<420, 850, 555, 582>(img.cols, img.rows, game_rect);
+	cv::Rect rect = Detector::BBoxConversion<line3_text_roi>(img.cols, img.rows, game_rect);
 
 	static const std::vector<Detector::GreyScaleTestCriteria> crit = {
 		{.brightness_range_lower = 205, .brightness_range_upper = 255, .pixel_ratio_lower = 0.1, .pixel_ratio_upper = 0.3}
@@ -178,9 +188,8 @@ SingleFrameEventData ThreeLineDialogDetector::Get3LineDialogEvent(const cv::Mat&
 	std::string ret = Detector::OCR(img(rect), scale_factor, 180, 255, true, _tess_api, "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz,.'-!\" ");
 	util::UnifyAmbiguousChars(ret);
 
-	for (uint32_t i = 0; i < uint32_t(_3line_text_to_npc.size()); i++)
-		if (ret.size() >= _3line_text_to_npc[i].first.size() && util::GetStringEditDistance(std::string_view(ret).substr(0, _3line_text_to_npc[i].first.size()), _3line_text_to_npc[i].first, 4) <= 4)
-			return { .type = EventType::Dialog, .dialog_data = { .dialog_id = _3line_text_to_npc[i].second} };
+	if (uint32_t npc = _3line_matcher.Match(ret); npc != PrefixMatcher::NO_MATCH)
+		return { .type = EventType::Dialog, .dialog_data = { .dialog_id = DialogId(npc)} };
 
 	return { .type = EventType::None };
 }
@@ -211,8 +220,13 @@ bool ZoraMonumentDetector::Init(const char* lang)
 		"Still, it is worth it!",
 	};
 
+	_line1_matcher.Init(2);
 	for (uint32_t i = 0; i < uint32_t(_line1_texts.size()); i++)
+	{
 		util::UnifyAmbiguousChars(_line1_texts[i]);
+		if (!_line1_matcher.Insert(_line1_texts[i], i + 1))
+			return false;
+	}
 
 	return true;
 }
@@ -220,7 +234,7 @@ bool ZoraMonumentDetector::Init(const char* lang)
 uint8_t ZoraMonumentDetector::GetMonumentID(const cv::Mat& img, const cv::Rect& game_rect)
 {
 	{
-		cv::Rect rect_upper = Detector::BBoxConversion<420, 870, 305, 315>(img.cols, img.rows, game_rect);
+		cv::Rect rect_upper = Detector::BBoxConversion<above_roi>(img.cols, img.rows, game_rect);
 		static const std::vector<Detector::GreyScaleTestCriteria> crit = {
 			{.brightness_range_lower = 205, .brightness_range_upper = 255, .pixel_ratio_lower = 0, .pixel_ratio_upper = 0.02}
 		};
@@ -229,7 +243,7 @@ uint8_t ZoraMonumentDetector::GetMonumentID(const cv::Mat& img, const cv::Rect&
 	}
 
 	{
-		cv::Rect rect_line1_middle = Detector::BBoxConversion<460, 810, 320, 348>(img.cols, img.rows, game_rect);
+		cv::Rect rect_line1_middle = Detector::BBoxConversion<line1_middle_roi>(img.cols, img.rows, game_rect);
 		static const std::vector<Detector::GreyScaleTestCriteria> crit = {
 			{.brightness_range_lower = 205, .brightness_range_upper = 255, .pixel_ratio_lower = 0.1, .pixel_ratio_upper = 0.3}
 		};
@@ -237,23 +251,22 @@ uint8_t ZoraMonumentDetector::GetMonumentID(const cv::Mat& img, const cv::Rect&
 			return 0;
 	}
 
-	cv::Rect rect_line1 = Detector::BBoxConversion<420, 870, 320, 348>(img.cols, img.rows, game_rect);
+	cv::Rect rect_line1 = Detector::BBoxConversion<line1_roi>(img.cols, img.rows, game_rect);
 	double scale_factor = 1;
 	std::string ret = Detector::OCR(img(rect_line1), scale_factor, 180, 255, true, _tess_api, "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz,.-! ");
 	util::UnifyAmbiguousChars(ret);
 
-	for (uint32_t i = 0; i < uint32_t(_line1_texts.size()); i++)
-		if (ret.size() >= _line1_texts[i].size() && util::GetStringEditDistance(std::string_view(ret).substr(0, _line1_texts[i].size()), _line1_texts[i], 2) <= 2)
-			return uint8_t(i + 1);
+	if (uint32_t id = _line1_matcher.Match(ret); id != PrefixMatcher::NO_MATCH)
+		return uint8_t(id);
 
 	return 0;
 }
 
 bool TravelDetector::IsTravelButtonPresent(const cv::Mat& img, const cv::Rect& game_rect)
 {
-	cv::Rect rect_left = Detector::BBoxConversion<509, 609, 478, 504>(img.cols, img.rows, game_rect);
-	cv::Rect rect_middle = Detector::BBoxConversion<610, 672, 478, 504>(img.cols, img.rows, game_rect);
-	cv::Rect rect_right = Detector::BBoxConversion<673, 771, 478, 504>(img.cols, img.rows, game_rect);
+	cv::Rect rect_left = Detector::BBoxConversion<left_side_roi>(img.cols, img.rows, game_rect);
+	cv::Rect rect_middle = Detector::BBoxConversion<button_text_roi>(img.cols, img.rows, game_rect);
+	cv::Rect rect_right = Detector::BBoxConversion<right_side_roi>(img.cols, img.rows, game_rect);
 
 	static const std::vector<Detector::GreyScaleTestCriteria> crit_sides = {
 		{.brightness_range_lower = 0, .brightness_range_upper = 100, .pixel_ratio_lower = 0.98, .pixel_ratio_upper = 1.0}
@@ -276,20 +289,18 @@ bool TravelDetector::IsTravelButtonPresent(const cv::Mat& img, const cv::Rect& g
 
 EventType BlackWhiteLoadScreenDetector::GetEvent(const cv::Mat& img, const cv::Rect& game_rect)
 {
-	// these two bounding boxes are very conservative because many run videos have overlays at the corners
-	cv::Rect rect_top = Detector::BBoxConversion<300, 900, 50, 230>(img.cols, img.rows, game_rect);
-	cv::Rect rect_bottom = Detector::BBoxConversion<480, 950, 370, 600>(img.cols, img.rows, game_rect);
-
-	std::array<uint32_t, 256> pixel_count;
-	Detector::GreyscaleAccHistogram(img(rect_top), pixel_count);
-	bool top_all_black = (pixel_count[9] / double(rect_top.area()) > 0.995);
-	bool top_all_white = (pixel_count[246] / double(rect_top.area()) < 0.005);
+	cv::Rect rect_top = Detector::BBoxConversion<top_roi>(img.cols, img.rows, game_rect);
+	cv::Rect rect_bottom = Detector::BBoxConversion<bottom_roi>(img.cols, img.rows, game_rect);
+
+	// black: more than 99.5% of the pixels <= 9, white: less than 0.5% of the pixels <= 246.
+	// On a regular game frame both are ruled out within the first few rows.
+	bool top_all_black, top_all_white;
+	Detector::GreyscaleUniformityTest(img(rect_top), 9, 247, 0.005, top_all_black, top_all_white);
 	if (!top_all_black && !top_all_white)
 		return EventType::None;
 
-	Detector::GreyscaleAccHistogram(img(rect_bottom), pixel_count);
-	bool bottom_all_black = (pixel_count[9] / double(rect_bottom.area()) > 0.995);
-	bool bottom_all_white = (pixel_count[246] / double(rect_bottom.area()) < 0.005);
+	bool bottom_all_black, bottom_all_white;
+	Detector::GreyscaleUniformityTest(img(rect_bottom), 9, 247, 0.005, bottom_all_black, bottom_all_white);
 
 	if (top_all_black)
 	{
@@ -310,8 +321,8 @@ EventType BlackWhiteLoadScreenDetector::GetEvent(const cv::Mat& img, const cv::R
 bool AlbumPageDetector::IsOnAlbumPage(const cv::Mat& img, const cv::Rect& game_rect)
 {
 	{
-		cv::Rect rect_l = Detector::BBoxConversion<482, 497, 32, 46>(img.cols, img.rows, game_rect);			// L button
-		cv::Rect rect_r = Detector::BBoxConversion<780, 795, 32, 46>(img.cols, img.rows, game_rect);			// R button
+		cv::Rect rect_l = Detector::BBoxConversion<l_button_roi>(img.cols, img.rows, game_rect);
+		cv::Rect rect_r = Detector::BBoxConversion<r_button_roi>(img.cols, img.rows, game_rect);
 
 		std::array<std::array<uint32_t, 256>, 3> pixel_count;
 
@@ -332,8 +343,8 @@ bool AlbumPageDetector::IsOnAlbumPage(const cv::Mat& img, const cv::Rect& game_r
 			return false;
 	}
 	{
-		cv::Rect rect_left_side = Detector::BBoxConversion<507, 597, 26, 51>(img.cols, img.rows, game_rect);		// area between L button and "Album"
-		cv::Rect rect_right_side = Detector::BBoxConversion<670, 771, 26, 51>(img.cols, img.rows, game_rect);		// area between R button and "Album"
+		cv::Rect rect_left_side = Detector::BBoxConversion<left_side_roi>(img.cols, img.rows, game_rect);
+		cv::Rect rect_right_side = Detector::BBoxConversion<right_side_roi>(img.cols, img.rows, game_rect);
 		// nothing brighter than 100 in these areas
 		std::array<uint32_t, 256> pixel_count;
 		Detector::GreyscaleAccHistogram(img(rect_left_side), pixel_count);
@@ -345,7 +356,7 @@ bool AlbumPageDetector::IsOnAlbumPage(const cv::Mat& img, const cv::Rect& game_r
 	}
 
 	std::array<std::array<uint32_t, 256>, 3> pixel_count;
-	cv::Rect rect = Detector::BBoxConversion<600, 669, 26, 51>(img.cols, img.rows, game_rect);		// top middle where "Album" is
+	cv::Rect rect = Detector::BBoxConversion<title_roi>(img.cols, img.rows, game_rect);
 
 	Detector::BGRAccHistogram(img(rect), pixel_count);
 
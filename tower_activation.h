@@ -1,5 +1,7 @@
 #pragma once
 #include "common.h"
+#include "detector.h"
+#include "prefix_matcher.h"
 
 
 class TowerActivationDetector
@@ -7,6 +9,9 @@ class TowerActivationDetector
 private:
 	tesseract::TessBaseAPI& _tess_api;
 
+public:
+	static constexpr Detector::Roi text_roi = { 504, 777, 582, 609 };
+
 public:
 	TowerActivationDetector(tesseract::TessBaseAPI& api)
 		: _tess_api(api) {
@@ -26,6 +31,12 @@ class SingleLineDialogDetector
 private:
 	tesseract::TessBaseAPI& _tess_api;
 	std::vector<std::pair<std::string, DialogId>> _1line_text_to_npc;
+	PrefixMatcher _1line_matcher;
+
+public:
+	static constexpr Detector::Roi text_roi = { 470, 810, 582, 609 };
+	static constexpr Detector::Roi above_roi = { 470, 810, 550, 570 };			// empty lines around the text
+	static constexpr Detector::Roi below_roi = { 470, 810, 620, 640 };
 
 public:
 	SingleLineDialogDetector(tesseract::TessBaseAPI& api)
@@ -36,6 +47,9 @@ public:
 	bool Init(const char* lang);
 
 	SingleFrameEventData GetEvent(const cv::Mat& img, const cv::Rect& game_rect);
+
+	// for --check-matchers
+	const PrefixMatcher& GetMatcher() const { return _1line_matcher; }
 };
 
 class ThreeLineDialogDetector
@@ -44,6 +58,16 @@ private:
 	tesseract::TessBaseAPI& _tess_api;
 	std::vector<std::pair<std::string, DialogId>> _3line_text_to_npc;
 	std::vector<std::pair<std::string, DialogId>> _2line_text_to_npc;
+	PrefixMatcher _3line_matcher;
+	PrefixMatcher _2line_matcher;
+
+public:
+	static constexpr Detector::Roi line3_text_roi = { 420, 850, 555, 582 };		// first line of a 3-line dialog
+	static constexpr Detector::Roi line2_text_roi = { 420, 850, 569, 596 };		// first line of a 2-line dialog
+	static constexpr Detector::Roi line3_above_roi = { 470, 810, 535, 554 };		// empty lines around a 3-line dialog
+	static constexpr Detector::Roi line3_below_roi = { 470, 810, 636, 655 };
+	static constexpr Detector::Roi line2_above_roi = { 470, 810, 535, 567 };		// empty lines around a 2-line dialog
+	static constexpr Detector::Roi line2_below_roi = { 470, 810, 621, 655 };
 
 public:
 	ThreeLineDialogDetector(tesseract::TessBaseAPI& api)
@@ -56,6 +80,10 @@ public:
 	SingleFrameEventData Get2LineDialogEvent(const cv::Mat& img, const cv::Rect& game_rect);
 	SingleFrameEventData Get3LineDialogEvent(const cv::Mat& img, const cv::Rect& game_rect);
 	SingleFrameEventData GetEvent(const cv::Mat& img, const cv::Rect& game_rect);
+
+	// for --check-matchers
+	const PrefixMatcher& Get2LineMatcher() const { return _2line_matcher; }
+	const PrefixMatcher& Get3LineMatcher() const { return _3line_matcher; }
 };
 
 class ZoraMonumentDetector
@@ -63,6 +91,12 @@ class ZoraMonumentDetector
 private:
 	tesseract::TessBaseAPI& _tess_api;
 	std::array<std::string, 10> _line1_texts;
+	PrefixMatcher _line1_matcher;
+
+public:
+	static constexpr Detector::Roi line1_roi = { 420, 870, 320, 348 };
+	static constexpr Detector::Roi above_roi = { 420, 870, 305, 315 };			// empty line above the text
+	static constexpr Detector::Roi line1_middle_roi = { 460, 810, 320, 348 };
 
 public:
 	ZoraMonumentDetector(tesseract::TessBaseAPI& api)
@@ -74,6 +108,9 @@ public:
 
 	// returns 0 if not at a monument
 	uint8_t GetMonumentID(const cv::Mat& img, const cv::Rect& game_rect);
+
+	// for --check-matchers
+	const PrefixMatcher& GetLine1Matcher() const { return _line1_matcher; }
 };
 
 class TravelDetector
@@ -81,6 +118,11 @@ class TravelDetector
 private:
 	tesseract::TessBaseAPI& _tess_api;
 
+public:
+	static constexpr Detector::Roi button_text_roi = { 610, 672, 478, 504 };		// "Travel" in the middle of the button
+	static constexpr Detector::Roi left_side_roi = { 509, 609, 478, 504 };			// dark button sides
+	static constexpr Detector::Roi right_side_roi = { 673, 771, 478, 504 };
+
 public:
 	TravelDetector(tesseract::TessBaseAPI& api)
 		: _tess_api(api) {
@@ -99,6 +141,11 @@ class BlackWhiteLoadScreenDetector
 private:
 	tesseract::TessBaseAPI& _tess_api;
 
+public:
+	// very conservative because many run videos have overlays at the corners
+	static constexpr Detector::Roi top_roi = { 300, 900, 50, 230 };
+	static constexpr Detector::Roi bottom_roi = { 480, 950, 370, 600 };
+
 public:
 	BlackWhiteLoadScreenDetector(tesseract::TessBaseAPI& api)
 		: _tess_api(api) {
@@ -117,6 +164,13 @@ class AlbumPageDetector
 private:
 	tesseract::TessBaseAPI& _tess_api;
 
+public:
+	static constexpr Detector::Roi title_roi = { 600, 669, 26, 51 };			// top middle where "Album" is
+	static constexpr Detector::Roi l_button_roi = { 482, 497, 32, 46 };
+	static constexpr Detector::Roi r_button_roi = { 780, 795, 32, 46 };
+	static constexpr Detector::Roi left_side_roi = { 507, 597, 26, 51 };			// area between L button and "Album"
+	static constexpr Detector::Roi right_side_roi = { 670, 771, 26, 51 };			// area between R button and "Album"
+
 public:
 	AlbumPageDetector(tesseract::TessBaseAPI& api)
 		: _tess_api(api) {
@@ -0,0 +1,152 @@
+#include <atomic>
+#include <iomanip>
+#include <map>
+#include <mutex>
+#include "trace.h"
+
+namespace trace
+{
+	struct ThreadBuffer
+	{
+		std::vector<Span> spans;
+	};
+
+	static std::atomic<bool> s_enabled = false;
+	static std::chrono::steady_clock::time_point s_tbegin;
+	static std::mutex s_file_mutex;				// taken when a thread begins and when a buffer is written
+	static std::ofstream s_file;
+	static bool s_first_event = true;
+	static std::map<uint32_t, std::unique_ptr<ThreadBuffer>> s_buffers;		// by thread id
+	static thread_local ThreadBuffer* t_buffer = nullptr;
+	static thread_local uint32_t t_tid = 0;
+
+	static uint64_t SinceBegin(std::chrono::steady_clock::time_point t)
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(t - s_tbegin).count();
+	}
+
+	static void WriteJSONString(std::ostream& os, std::string_view str)
+	{
+		os << '"';
+		for (char c : str)
+		{
+			if (c == '"' || c == '\\')
+				os << '\\';
+			os << c;
+		}
+		os << '"';
+	}
+
+	// with s_file_mutex held
+	static std::ostream& NextEvent()
+	{
+		if (!s_first_event)
+			s_file << ',' << std::endl;
+		s_first_event = false;
+		return s_file;
+	}
+
+	// write the spans of the calling thread and empty its buffer, the capacity is kept
+	static void Flush()
+	{
+		std::lock_guard<std::mutex> lock(s_file_mutex);
+		for (const Span& span : t_buffer->spans)
+		{
+			NextEvent() << "{\"ph\":\"X\",\"name\":";
+			WriteJSONString(s_file, span.name);
+			s_file << ",\"pid\":1,\"tid\":" << t_tid << ",\"ts\":" << span.begin_ns / 1000.0 << ",\"dur\":" << (span.end_ns - span.begin_ns) / 1000.0;
+			if (span.arg_name)
+				s_file << ",\"args\":{\"" << span.arg_name << "\":" << span.arg << '}';
+			s_file << '}';
+		}
+		t_buffer->spans.clear();
+	}
+
+	bool Enable(const std::string& filename)
+	{
+		s_file.open(filename, std::ios::trunc);
+		if (!s_file.is_open())
+		{
+			std::cout << "Cannot write trace file " << filename << std::endl;
+			return false;
+		}
+		s_file << std::fixed << std::setprecision(3);
+		s_file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[" << std::endl;
+		s_tbegin = std::chrono::steady_clock::now();
+		s_enabled = true;
+		return true;
+	}
+
+	bool IsEnabled()
+	{
+		return s_enabled;
+	}
+
+	void BeginThread(uint32_t tid, const std::string& name)
+	{
+		if (!s_enabled)
+			return;
+
+		std::lock_guard<std::mutex> lock(s_file_mutex);
+		auto [itor, inserted] = s_buffers.try_emplace(tid);
+		if (inserted)
+		{
+			itor->second = std::make_unique<ThreadBuffer>();
+			itor->second->spans.reserve(FLUSH_SPANS);
+			NextEvent() << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":" << tid << ",\"args\":{\"name\":";
+			WriteJSONString(s_file, name);
+			s_file << "}}";
+		}
+		t_buffer = itor->second.get();
+		t_tid = tid;
+	}
+
+	void EndThread()
+	{
+		if (!t_buffer)
+			return;
+		Flush();
+		t_buffer = nullptr;
+	}
+
+	bool Finish()
+	{
+		if (!s_enabled)
+			return true;
+		s_enabled = false;
+
+		std::lock_guard<std::mutex> lock(s_file_mutex);
+		s_file << std::endl << "]}" << std::endl;
+		s_file.close();
+		s_buffers.clear();
+		return !s_file.fail();
+	}
+
+	ScopedSpan::ScopedSpan(std::string_view name, const char* arg_name, uint32_t arg)
+		: _name(name)
+		, _arg_name(arg_name)
+		, _arg(arg)
+		, _active(t_buffer != nullptr)
+	{
+		if (_active)
+			_tbegin = std::chrono::steady_clock::now();
+	}
+
+	ScopedSpan::~ScopedSpan()
+	{
+		if (!_active || !t_buffer)
+			return;
+		auto tend = std::chrono::steady_clock::now();
+		if (uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(tend - _tbegin).count()) < MIN_SPAN_NS)
+			return;
+		t_buffer->spans.push_back({
+			.name = _name,
+			.arg_name = _arg_name,
+			.arg = _arg,
+			.begin_ns = SinceBegin(_tbegin),
+			.end_ns = SinceBegin(tend),
+		});
+		if (t_buffer->spans.size() >= FLUSH_SPANS)
+			Flush();
+	}
+}
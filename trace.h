@@ -0,0 +1,60 @@
+#pragma once
+#include <chrono>
+#include <string>
+#include <vector>
+#include "common.h"
+
+
+/**
+ * Opt-in timeline of the analysis, written as Chrome trace-event JSON (opens in chrome://tracing and Perfetto).
+ * Every thread id has one buffer, reused by the threads sharing the id, which the threads record into without any
+ * locking. A buffer is appended to the file once it holds FLUSH_SPANS spans and when its thread ends, so the memory
+ * stays bounded and tracing can stay on for a whole run. Spans shorter than MIN_SPAN_NS are dropped when they end,
+ * which keeps the cheap gate rejections out of the trace. Everything is a no-op until Enable() is called.
+ */
+namespace trace
+{
+	constexpr uint64_t MIN_SPAN_NS = 5000;
+	constexpr size_t FLUSH_SPANS = 1 << 14;
+
+	struct Span
+	{
+		std::string_view name;
+		const char* arg_name;		// nullptr if the span has no argument
+		uint32_t arg;
+		uint64_t begin_ns;			// since Enable()
+		uint64_t end_ns;
+	};
+
+	// Start the trace file, returns false if it can't be written
+	bool Enable(const std::string& filename);
+	bool IsEnabled();
+
+	/**
+	 * Start recording the calling thread's spans under the given thread id, several threads can share one id as long as
+	 * they don't overlap in time (e.g. the worker threads of successive segments). Must be paired with EndThread(),
+	 * which writes out the spans left in the buffer.
+	 */
+	void BeginThread(uint32_t tid, const std::string& name);
+	void EndThread();
+
+	// Once every thread has ended: terminate and close the file, returns false if writing it failed
+	bool Finish();
+
+	// name must outlive the trace, i.e. be a string literal or a static table entry
+	class ScopedSpan
+	{
+	private:
+		std::string_view _name;
+		const char* _arg_name;
+		uint32_t _arg;
+		std::chrono::steady_clock::time_point _tbegin;
+		bool _active;
+
+	public:
+		ScopedSpan(std::string_view name, const char* arg_name = nullptr, uint32_t arg = 0);
+		~ScopedSpan();
+		ScopedSpan(const ScopedSpan&) = delete;
+		ScopedSpan& operator=(const ScopedSpan&) = delete;
+	};
+}